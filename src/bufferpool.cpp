@@ -0,0 +1,91 @@
+#include "bufferpool.h"
+
+#include <cstdlib>
+#include <new>
+
+namespace kernint {
+
+/** Size class of a request, classCount if it is too large for the pool */
+static size_t sizeClass(size_t size) {
+	size_t cls = 0;
+	for (size_t classSize = BufferPool::minSize; classSize < size; classSize <<= 1) {
+		cls++;
+	}
+	return cls;
+}
+
+BufferPool::Buffer::~Buffer() {
+	this->release();
+}
+
+BufferPool::Buffer::Buffer(Buffer &&other)
+	:
+	pool{other.pool},
+	memory{other.memory},
+	capacity{other.capacity},
+	length{other.length} {
+
+	other.memory = nullptr;
+}
+
+BufferPool::Buffer &BufferPool::Buffer::operator=(Buffer &&other) {
+	if (this != &other) {
+		this->release();
+		this->pool     = other.pool;
+		this->memory   = other.memory;
+		this->capacity = other.capacity;
+		this->length   = other.length;
+		other.memory   = nullptr;
+	}
+	return *this;
+}
+
+void BufferPool::Buffer::release() {
+	if (this->memory) {
+		this->pool->put(this->memory, this->capacity);
+	}
+	this->memory   = nullptr;
+	this->capacity = 0;
+	this->length   = 0;
+}
+
+BufferPool::BufferPool()
+	:
+	freeBuffers{},
+	allocations{0} {}
+
+BufferPool::~BufferPool() {
+	for (auto &buffers : this->freeBuffers) {
+		for (auto &&memory : buffers) {
+			free(memory);
+		}
+	}
+}
+
+BufferPool::Buffer BufferPool::get(size_t size) {
+	size_t cls = sizeClass(size);
+	if (cls < classCount && !this->freeBuffers[cls].empty()) {
+		uint8_t *memory = this->freeBuffers[cls].back();
+		this->freeBuffers[cls].pop_back();
+		return Buffer{this, memory, minSize << cls, size};
+	}
+
+	size_t capacity = (cls < classCount) ? (minSize << cls) : size;
+	void *memory = nullptr;
+	if (posix_memalign(&memory, minSize, capacity) != 0) {
+		throw std::bad_alloc();
+	}
+	this->allocations++;
+	return Buffer{this, (uint8_t *)memory, capacity, size};
+}
+
+void BufferPool::put(uint8_t *memory, size_t capacity) {
+	size_t cls = sizeClass(capacity);
+	if (cls < classCount && (minSize << cls) == capacity) {
+		this->freeBuffers[cls].push_back(memory);
+	} else {
+		free(memory);
+	}
+}
+
+} // namespace kernint
@@ -0,0 +1,84 @@
+#ifndef KERNINT_BUFFERPOOL_H_
+#define KERNINT_BUFFERPOOL_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace kernint {
+
+/**
+ * Pool of page aligned memory buffers for guest reads.
+ *
+ * Buffers come in power of two size classes from one page (4 KiB) up to
+ * a large page (2 MiB). A returned buffer is kept for the next request
+ * of the same class, so after the first iteration the validation loop
+ * does not allocate guest memory buffers anymore. Larger requests are
+ * served by a dedicated allocation.
+ *
+ * A pool is not thread safe, every worker thread uses its own one.
+ * Buffers must be released before their pool is destroyed.
+ */
+class BufferPool {
+public:
+	static const size_t minSize = 0x1000;
+	static const size_t maxSize = 0x200000;
+
+	/** Owning handle of a pooled buffer, returns it when destroyed */
+	class Buffer {
+	public:
+		Buffer() : pool{nullptr}, memory{nullptr}, capacity{0}, length{0} {}
+		~Buffer();
+
+		Buffer(Buffer &&other);
+		Buffer &operator=(Buffer &&other);
+		Buffer(const Buffer &) = delete;
+		Buffer &operator=(const Buffer &) = delete;
+
+		uint8_t *data() const { return this->memory; }
+		/** The requested size, the buffer may be larger */
+		size_t size() const { return this->length; }
+		void setSize(size_t size) { this->length = size; }
+
+	private:
+		friend class BufferPool;
+
+		Buffer(BufferPool *pool, uint8_t *memory, size_t capacity, size_t length)
+			:
+			pool{pool},
+			memory{memory},
+			capacity{capacity},
+			length{length} {}
+
+		void release();
+
+		BufferPool *pool;
+		uint8_t *memory;
+		size_t capacity;
+		size_t length;
+	};
+
+	BufferPool();
+	~BufferPool();
+
+	BufferPool(const BufferPool &) = delete;
+	BufferPool &operator=(const BufferPool &) = delete;
+
+	/** Borrow a buffer of at least size bytes, the content is undefined */
+	Buffer get(size_t size);
+
+	/** Number of buffers allocated by this pool so far */
+	size_t getAllocationCount() const { return this->allocations; }
+
+private:
+	static const size_t classCount = 10; // 4 KiB .. 2 MiB
+
+	void put(uint8_t *memory, size_t capacity);
+
+	std::vector<uint8_t *> freeBuffers[classCount];
+	size_t allocations;
+};
+
+} // namespace kernint
+
+#endif
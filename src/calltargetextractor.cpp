@@ -0,0 +1,156 @@
+#include "calltargetextractor.h"
+
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <thread>
+#include <unordered_set>
+
+#include "calltargets.h"
+#include "elfkernelloader.h"
+#include "elfkernelspaceloader.h"
+#include "helpers.h"
+
+namespace kernint {
+
+CallTargetExtractor::CallTargetExtractor(ElfKernelLoader *kernelLoader)
+	:
+	kernelLoader{kernelLoader},
+	calls{},
+	tailCalls{} {}
+
+void CallTargetExtractor::addChunks(ElfKernelspaceLoader *loader,
+                                    std::vector<Chunk> &chunks) {
+	// Big images are split so that the kernel itself does not end up
+	// on a single thread. The disassembly must start at an instruction,
+	// so every chunk begins at the function containing its nominal start.
+	const uint64_t chunkSize = 0x100000;
+
+	uint64_t base = loader->textSegment.memindex;
+	uint64_t end  = base + loader->getTextSegment().size();
+	if (base == end) {
+		return;
+	}
+
+	uint64_t start = base;
+	for (uint64_t next = base + chunkSize; next < end; next += chunkSize) {
+		uint64_t func = this->kernelLoader->symbols.getContainingSymbol(next);
+		if (func > start && func <= next) {
+			next = func;
+		}
+		chunks.push_back({loader, start, next});
+		start = next;
+	}
+	chunks.push_back({loader, start, end});
+}
+
+void CallTargetExtractor::processChunk(const Chunk &chunk, ChunkResult &result) {
+	SymbolManager &symbols = this->kernelLoader->symbols;
+	const uint8_t *text = chunk.loader->getTextSegment().data();
+
+	findBranches(
+		text + (chunk.start - chunk.loader->textSegment.memindex),
+		chunk.end - chunk.start,
+		chunk.start,
+		[&](uint64_t address, uint8_t, uint64_t destination, bool call) {
+			if (destination == 0) {
+				// Indirect, the destination is unknown
+				return;
+			}
+			if (call) {
+				result.calls.emplace_back(address, destination);
+				return;
+			}
+			// Only jumps to the start of another function are tail calls
+			if (!symbols.isFunction(destination)) {
+				return;
+			}
+			uint64_t func = symbols.getContainingSymbol(address);
+			if (func != 0 && func != destination) {
+				result.tailCalls.emplace_back(func, destination);
+			}
+		});
+}
+
+void CallTargetExtractor::extract(uint32_t threads) {
+	std::vector<Chunk> chunks;
+	this->addChunks(this->kernelLoader, chunks);
+	for (auto &&module : this->kernelLoader->getLoadedModules()) {
+		this->addChunks(module, chunks);
+	}
+
+	std::vector<ChunkResult> results(chunks.size());
+	std::atomic<size_t> nextChunk{0};
+
+	auto worker = [&]() {
+		size_t chunk;
+		while ((chunk = nextChunk++) < chunks.size()) {
+			this->processChunk(chunks[chunk], results[chunk]);
+		}
+	};
+
+	if (threads == 0) {
+		threads = std::thread::hardware_concurrency();
+	}
+	uint32_t threadCount = std::max<size_t>(
+		std::min<size_t>(threads, chunks.size()), 1);
+	std::vector<std::thread> workers;
+	for (uint32_t i = 1; i < threadCount; i++) {
+		workers.emplace_back(worker);
+	}
+	// The calling thread is a worker as well
+	worker();
+
+	for (auto &&thread : workers) {
+		thread.join();
+	}
+
+	for (auto &result : results) {
+		this->calls.insert(this->calls.end(),
+		                   result.calls.begin(), result.calls.end());
+		for (auto &&tailCall : result.tailCalls) {
+			this->tailCalls[tailCall.first].push_back(tailCall.second);
+		}
+	}
+
+	std::cout << "Found " << this->calls.size() << " direct calls and "
+	          << this->tailCalls.size() << " functions with tail calls in "
+	          << chunks.size() << " chunks" << std::endl;
+}
+
+bool CallTargetExtractor::write(const std::string &fileName) {
+	// Functions reachable from a call destination, including itself
+	std::unordered_map<uint64_t, std::vector<uint64_t>> reachable;
+
+	std::vector<std::pair<uint64_t, uint64_t>> pairs;
+	pairs.reserve(this->calls.size());
+
+	for (auto &&call : this->calls) {
+		auto known = reachable.find(call.second);
+		if (known == reachable.end()) {
+			std::vector<uint64_t> funcs{call.second};
+			std::unordered_set<uint64_t> seen{call.second};
+			for (size_t i = 0; i < funcs.size(); i++) {
+				auto jumps = this->tailCalls.find(funcs[i]);
+				if (jumps == this->tailCalls.end()) {
+					continue;
+				}
+				for (auto &&dest : jumps->second) {
+					if (seen.insert(dest).second) {
+						funcs.push_back(dest);
+					}
+				}
+			}
+			known = reachable.emplace(call.second, std::move(funcs)).first;
+		}
+
+		for (auto &&func : known->second) {
+			pairs.emplace_back(call.first, func);
+		}
+	}
+
+	return CallTargets::write(fileName, pairs,
+	                          this->kernelLoader->elffile->getBuildID());
+}
+
+} // namespace kernint
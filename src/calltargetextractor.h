@@ -0,0 +1,66 @@
+#ifndef KERNINT_CALLTARGETEXTRACTOR_H_
+#define KERNINT_CALLTARGETEXTRACTOR_H_
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace kernint {
+
+class ElfKernelLoader;
+class ElfKernelspaceLoader;
+
+/**
+ * Builds the call targets file used for stack validation from the
+ * reference images of the kernel and its loaded modules.
+ *
+ * The text of all images is disassembled and every direct call is
+ * resolved. As a function may leave through a direct tail jump to
+ * another function, the functions reachable that way are added as
+ * targets of the call as well. Indirect calls are not resolved.
+ */
+class CallTargetExtractor {
+public:
+	CallTargetExtractor(ElfKernelLoader *kernelLoader);
+
+	/**
+	 * Disassemble the kernel and all modules loaded so far
+	 * with the given number of threads, 0 uses all CPUs.
+	 */
+	void extract(uint32_t threads=0);
+
+	/** Write the indexed targets file, see CallTargets */
+	bool write(const std::string &fileName);
+
+	size_t getCallCount() const { return this->calls.size(); }
+
+private:
+	/** A part of a text image that is disassembled as a whole */
+	struct Chunk {
+		ElfKernelspaceLoader *loader;
+		uint64_t start;
+		uint64_t end;
+	};
+
+	/** Results of one chunk */
+	struct ChunkResult {
+		std::vector<std::pair<uint64_t, uint64_t>> calls;
+		std::vector<std::pair<uint64_t, uint64_t>> tailCalls;
+	};
+
+	ElfKernelLoader *kernelLoader;
+
+	/** (call site, destination) of all direct calls */
+	std::vector<std::pair<uint64_t, uint64_t>> calls;
+	/** Functions each function may tail jump to */
+	std::unordered_map<uint64_t, std::vector<uint64_t>> tailCalls;
+
+	void addChunks(ElfKernelspaceLoader *loader, std::vector<Chunk> &chunks);
+	void processChunk(const Chunk &chunk, ChunkResult &result);
+};
+
+} // namespace kernint
+
+#endif
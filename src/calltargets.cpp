@@ -0,0 +1,326 @@
+#include "calltargets.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "helpers.h"
+
+namespace kernint {
+
+static const char targetsMagic[8] = {'K', 'I', 'T', 'A', 'R', 'G', 'E', 'T'};
+
+/** Offsets of the arrays following the header */
+static size_t indexOffset(uint64_t siteCount) {
+	return sizeof(CallTargets::Header) + siteCount * sizeof(uint64_t);
+}
+
+static size_t targetsOffset(uint64_t siteCount) {
+	size_t offset = indexOffset(siteCount) + (siteCount + 1) * sizeof(uint32_t);
+	return (offset + 7) & ~(size_t)7;
+}
+
+CallTargets::CallTargets()
+	:
+	mapping{nullptr},
+	mappingSize{0},
+	sites{nullptr},
+	index{nullptr},
+	targets{nullptr},
+	siteCount{0},
+	targetCount{0} {}
+
+CallTargets::~CallTargets() {
+	this->unmap();
+}
+
+bool CallTargets::load(const std::string &fileName, const std::string &buildID) {
+	char magic[sizeof(targetsMagic)] = {0};
+	std::ifstream infile(fileName, std::ios::in | std::ios::binary);
+	if (!infile.is_open()) {
+		std::cout << COLOR_RED << "Could not open targets file: "
+		          << fileName << COLOR_NORM << std::endl;
+		return false;
+	}
+	infile.read(magic, sizeof(magic));
+	infile.close();
+
+	if (memcmp(magic, targetsMagic, sizeof(magic)) == 0) {
+		return this->map(fileName, buildID);
+	}
+
+	// Raw format, use (or create) the converted file
+	std::string indexFile = fileName + ".idx";
+	struct stat rawStat, indexStat;
+	bool upToDate = stat(fileName.c_str(), &rawStat) == 0 &&
+	                stat(indexFile.c_str(), &indexStat) == 0 &&
+	                indexStat.st_mtime >= rawStat.st_mtime;
+
+	if (upToDate && this->map(indexFile, buildID)) {
+		return true;
+	}
+
+	std::cout << "Converting targets file " << fileName << " to "
+	          << indexFile << std::endl;
+	std::vector<std::pair<uint64_t, uint64_t>> pairs;
+	std::vector<uint64_t> image;
+	if (!readRaw(fileName, &pairs) || !build(pairs, buildID, &image)) {
+		std::cout << COLOR_RED << "Could not convert targets file: "
+		          << fileName << COLOR_NORM << std::endl;
+		return false;
+	}
+	if (writeImage(indexFile, image) && this->map(indexFile, buildID)) {
+		return true;
+	}
+
+	// The directory may be read only, keep the index in memory then
+	std::cout << "Using the targets index of " << fileName
+	          << " from memory" << std::endl;
+	this->unmap();
+	this->image = std::move(image);
+	if (!this->attach(this->image.data(),
+	                  this->image.size() * sizeof(uint64_t),
+	                  fileName, buildID)) {
+		this->unmap();
+		return false;
+	}
+	return true;
+}
+
+bool CallTargets::convert(const std::string &rawFile,
+                          const std::string &indexFile,
+                          const std::string &buildID) {
+	std::vector<std::pair<uint64_t, uint64_t>> pairs;
+	if (!readRaw(rawFile, &pairs)) {
+		return false;
+	}
+	return write(indexFile, pairs, buildID);
+}
+
+bool CallTargets::readRaw(const std::string &rawFile,
+                          std::vector<std::pair<uint64_t, uint64_t>> *pairs) {
+	std::ifstream infile(rawFile, std::ios::in | std::ios::binary);
+	if (!infile.is_open()) {
+		return false;
+	}
+
+	infile.seekg(0, std::ios::end);
+	size_t size = infile.tellg();
+	infile.seekg(0, std::ios::beg);
+
+	pairs->resize(size / 16);
+	std::vector<uint64_t> raw(pairs->size() * 2);
+	infile.read((char *)raw.data(), raw.size() * sizeof(uint64_t));
+	if (!infile) {
+		return false;
+	}
+	infile.close();
+
+	for (size_t i = 0; i < pairs->size(); i++) {
+		(*pairs)[i] = std::make_pair(raw[2 * i], raw[2 * i + 1]);
+	}
+	return true;
+}
+
+bool CallTargets::write(const std::string &indexFile,
+                        std::vector<std::pair<uint64_t, uint64_t>> &pairs,
+                        const std::string &buildID) {
+	std::vector<uint64_t> image;
+	return build(pairs, buildID, &image) && writeImage(indexFile, image);
+}
+
+bool CallTargets::build(std::vector<std::pair<uint64_t, uint64_t>> &pairs,
+                        const std::string &buildID,
+                        std::vector<uint64_t> *image) {
+	std::sort(pairs.begin(), pairs.end());
+	pairs.erase(std::unique(pairs.begin(), pairs.end()), pairs.end());
+
+	std::vector<uint64_t> sites;
+	std::vector<uint32_t> index;
+	std::vector<uint64_t> targets;
+	targets.reserve(pairs.size());
+
+	for (auto &&pair : pairs) {
+		if (sites.empty() || sites.back() != pair.first) {
+			sites.push_back(pair.first);
+			index.push_back(targets.size());
+		}
+		targets.push_back(pair.second);
+	}
+	index.push_back(targets.size());
+
+	if (targets.size() > UINT32_MAX) {
+		return false;
+	}
+
+	Header header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, targetsMagic, sizeof(header.magic));
+	header.version       = version;
+	header.buildIDLength = std::min(buildID.size(), sizeof(header.buildID));
+	memcpy(header.buildID, buildID.data(), header.buildIDLength);
+	header.siteCount     = sites.size();
+	header.targetCount   = targets.size();
+
+	// The arrays are 8 byte aligned, the image is zero padded
+	size_t targetsStart = targetsOffset(sites.size());
+	image->assign(targetsStart / sizeof(uint64_t) + targets.size(), 0);
+	uint8_t *base = (uint8_t *)image->data();
+	memcpy(base, &header, sizeof(header));
+	memcpy(base + sizeof(header), sites.data(),
+	       sites.size() * sizeof(uint64_t));
+	memcpy(base + indexOffset(sites.size()), index.data(),
+	       index.size() * sizeof(uint32_t));
+	memcpy(base + targetsStart, targets.data(),
+	       targets.size() * sizeof(uint64_t));
+	return true;
+}
+
+bool CallTargets::writeImage(const std::string &indexFile,
+                             const std::vector<uint64_t> &image) {
+	// Write to a temporary file first, so that concurrent readers never
+	// see a partially written index.
+	std::string tmpFile = indexFile + ".tmp";
+	std::ofstream outfile(tmpFile, std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!outfile.is_open()) {
+		std::cout << COLOR_RED << "Could not write targets index: "
+		          << indexFile << COLOR_NORM << std::endl;
+		return false;
+	}
+
+	outfile.write((const char *)image.data(), image.size() * sizeof(uint64_t));
+	outfile.close();
+
+	if (!outfile || rename(tmpFile.c_str(), indexFile.c_str()) != 0) {
+		unlink(tmpFile.c_str());
+		return false;
+	}
+	return true;
+}
+
+bool CallTargets::map(const std::string &fileName, const std::string &buildID) {
+	this->unmap();
+
+	int fd = open(fileName.c_str(), O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+
+	struct stat fileStat;
+	if (fstat(fd, &fileStat) != 0 ||
+	    (size_t)fileStat.st_size < sizeof(Header)) {
+		close(fd);
+		return false;
+	}
+
+	void *data = mmap(nullptr, fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED) {
+		return false;
+	}
+	this->mapping     = data;
+	this->mappingSize = fileStat.st_size;
+
+	if (!this->attach(data, this->mappingSize, fileName, buildID)) {
+		this->unmap();
+		return false;
+	}
+	return true;
+}
+
+bool CallTargets::attach(const void *data, size_t size,
+                         const std::string &fileName,
+                         const std::string &buildID) {
+	// The counts are bounded by the size first, so that computing the
+	// array offsets can not overflow
+	const Header *header = (const Header *)data;
+	if (size < sizeof(Header) ||
+	    memcmp(header->magic, targetsMagic, sizeof(header->magic)) != 0 ||
+	    header->version != version ||
+	    header->buildIDLength > sizeof(header->buildID) ||
+	    header->siteCount > size / sizeof(uint64_t) ||
+	    header->targetCount > size / sizeof(uint64_t) ||
+	    targetsOffset(header->siteCount) > size ||
+	    header->targetCount >
+	    (size - targetsOffset(header->siteCount)) / sizeof(uint64_t)) {
+		std::cout << COLOR_RED << "Invalid targets file: " << fileName
+		          << COLOR_NORM << std::endl;
+		return false;
+	}
+
+	// hasTarget() relies on sorted sites and target ranges inside of
+	// the targets array, check them once instead of on every lookup
+	const uint8_t *base = (const uint8_t *)data;
+	const uint64_t *sites = (const uint64_t *)(base + sizeof(Header));
+	const uint32_t *index =
+		(const uint32_t *)(base + indexOffset(header->siteCount));
+	bool valid = index[0] == 0 && index[header->siteCount] <= header->targetCount;
+	for (uint64_t i = 0; valid && i < header->siteCount; i++) {
+		valid = index[i] <= index[i + 1] &&
+		        (i == 0 || sites[i - 1] < sites[i]);
+	}
+	if (!valid) {
+		std::cout << COLOR_RED << "Corrupt index in targets file: "
+		          << fileName << COLOR_NORM << std::endl;
+		return false;
+	}
+
+	std::string fileBuildID(header->buildID, header->buildIDLength);
+	if (!buildID.empty() && !fileBuildID.empty() && buildID != fileBuildID) {
+		std::cout << COLOR_RED << "Targets file " << fileName
+		          << " belongs to a different kernel (build-id "
+		          << fileBuildID << ")" << COLOR_NORM << std::endl;
+		return false;
+	}
+
+	this->siteCount   = header->siteCount;
+	this->targetCount = header->targetCount;
+	this->sites   = sites;
+	this->index   = index;
+	this->targets = (const uint64_t *)(base + targetsOffset(this->siteCount));
+	return true;
+}
+
+void CallTargets::unmap() {
+	if (this->mapping) {
+		munmap(this->mapping, this->mappingSize);
+	}
+	this->mapping     = nullptr;
+	this->mappingSize = 0;
+	this->image.clear();
+	this->sites       = nullptr;
+	this->index       = nullptr;
+	this->targets     = nullptr;
+	this->siteCount   = 0;
+	this->targetCount = 0;
+}
+
+bool CallTargets::hasTarget(uint64_t address, uint64_t target) const {
+	if (this->siteCount == 0) {
+		return false;
+	}
+
+	// Find the last site <= address, the loop body compiles to a cmov
+	const uint64_t *base = this->sites;
+	size_t count = this->siteCount;
+	while (count > 1) {
+		size_t half = count / 2;
+		base = (base[half] <= address) ? base + half : base;
+		count -= half;
+	}
+	if (*base > address) {
+		return false;
+	}
+
+	size_t site = base - this->sites;
+	return std::binary_search(this->targets + this->index[site],
+	                          this->targets + this->index[site + 1],
+	                          target);
+}
+
+} // namespace kernint
@@ -0,0 +1,106 @@
+#ifndef KERNINT_CALLTARGETS_H_
+#define KERNINT_CALLTARGETS_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace kernint {
+
+/**
+ * Read-only call graph of the kernel: for every call site the set of
+ * functions it may call.
+ *
+ * The data is kept in an indexed binary file that is mapped into memory:
+ *
+ *   Header
+ *   uint64_t sites[siteCount]        sorted call site addresses
+ *   uint32_t index[siteCount + 1]    targets of site i are
+ *                                    targets[index[i]..index[i + 1]]
+ *   (padding to 8 bytes)
+ *   uint64_t targets[targetCount]    sorted per call site
+ *
+ * The old raw format, a plain list of (site, target) uint64_t pairs, is
+ * converted once into "<file>.idx" next to it. If that can not be
+ * written, the converted index is only kept in memory.
+ */
+class CallTargets {
+public:
+	static const uint32_t version = 1;
+
+	struct Header {
+		char magic[8];
+		uint32_t version;
+		uint32_t buildIDLength;
+		char buildID[64];
+		uint64_t siteCount;
+		uint64_t targetCount;
+	};
+
+	CallTargets();
+	~CallTargets();
+
+	CallTargets(const CallTargets &) = delete;
+	CallTargets &operator=(const CallTargets &) = delete;
+
+	/**
+	 * Load a targets file in either format.
+	 * If buildID is given, the file must belong to that kernel.
+	 */
+	bool load(const std::string &fileName, const std::string &buildID="");
+
+	/**
+	 * Convert a raw targets file into the indexed format.
+	 */
+	static bool convert(const std::string &rawFile,
+	                    const std::string &indexFile,
+	                    const std::string &buildID);
+
+	/**
+	 * Write the indexed format from (site, target) pairs.
+	 */
+	static bool write(const std::string &indexFile,
+	                  std::vector<std::pair<uint64_t, uint64_t>> &pairs,
+	                  const std::string &buildID);
+
+	bool empty() const { return this->siteCount == 0; }
+	size_t size() const { return this->targetCount; }
+
+	/**
+	 * Check if target is a call target of the last call site at or
+	 * before address, i.e. of the call belonging to a return address.
+	 */
+	bool hasTarget(uint64_t address, uint64_t target) const;
+
+private:
+	static bool readRaw(const std::string &rawFile,
+	                    std::vector<std::pair<uint64_t, uint64_t>> *pairs);
+	/** Create the indexed format in memory, sorts pairs */
+	static bool build(std::vector<std::pair<uint64_t, uint64_t>> &pairs,
+	                  const std::string &buildID,
+	                  std::vector<uint64_t> *image);
+	static bool writeImage(const std::string &indexFile,
+	                       const std::vector<uint64_t> &image);
+
+	bool map(const std::string &fileName, const std::string &buildID);
+	/** Check the indexed format at data and point the arrays into it */
+	bool attach(const void *data, size_t size,
+	            const std::string &fileName, const std::string &buildID);
+	void unmap();
+
+	void *mapping;
+	size_t mappingSize;
+	/** The indexed format if it is not mapped from a file */
+	std::vector<uint64_t> image;
+
+	const uint64_t *sites;
+	const uint32_t *index;
+	const uint64_t *targets;
+	uint64_t siteCount;
+	uint64_t targetCount;
+};
+
+} // namespace kernint
+
+#endif
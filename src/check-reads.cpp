@@ -0,0 +1,269 @@
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "bufferpool.h"
+#include "elfkernelloader.h"
+#include "kernelvalidator.h"
+#include "pagebatch.h"
+#include "vmitrace.h"
+
+namespace kernint {
+
+/** Validates the pages of the kernel text through validatePageList() */
+class KernelValidatorCheck {
+public:
+	KernelValidatorCheck(KernelValidator *validator)
+		:
+		validator{validator} {}
+
+	void validatePageList(const std::vector<page_info_t *> &pages) {
+		this->validator->validatePageList(pages);
+	}
+
+	/**
+	 * The reads validatePageList() does for pages, each chunk of the
+	 * pages is batched on its own.
+	 */
+	static std::vector<std::pair<uint64_t, std::string>>
+	chunkReads(const std::vector<page_info_t *> &pages,
+	           const std::vector<uint8_t> &text, uint64_t textStart) {
+		std::vector<std::pair<uint64_t, std::string>> reads;
+		BufferPool pool;
+		PageBatch batch{&pool};
+		for (size_t begin = 0; begin < pages.size(); begin += 64) {
+			batch.clear();
+			for (size_t i = begin; i < std::min(pages.size(), begin + 64); i++) {
+				batch.add(pages[i]->vaddr, pages[i]->size);
+			}
+			batch.read([&](uint64_t address, uint64_t len, uint8_t *buffer) {
+				const char *data = (const char *)text.data() +
+				                   (address - textStart);
+				reads.emplace_back(address, std::string{data, len});
+				memcpy(buffer, data, len);
+				return len;
+			});
+		}
+		batch.clear();
+		return reads;
+	}
+
+private:
+	KernelValidator *validator;
+};
+
+} // namespace kernint
+
+using namespace kernint;
+
+// Every allocation of the program is counted
+static std::atomic<size_t> allocations{0};
+
+void *operator new(size_t size) {
+	allocations++;
+	void *memory = malloc(size ? size : 1);
+	if (!memory) {
+		throw std::bad_alloc();
+	}
+	return memory;
+}
+
+void operator delete(void *memory) noexcept {
+	free(memory);
+}
+
+void operator delete(void *memory, size_t) noexcept {
+	free(memory);
+}
+
+namespace {
+
+const uint64_t textStart = 0xffffffff81000000ULL;
+const uint64_t pageSize  = 0x1000;
+
+template <typename T>
+void appendValue(T value, std::string *out) {
+	out->append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+void appendRecord(uint8_t type, const std::string &payload, std::string *out) {
+	appendValue<uint32_t>(payload.size() + 1, out);
+	appendValue<uint8_t>(type, out);
+	out->append(payload);
+}
+
+uint8_t pageByte(uint64_t address) {
+	return (uint8_t)(address / pageSize * 7 + address % 251);
+}
+
+/**
+ * The reads of one batch: 16 contiguous pages that are merged into a
+ * single read and a separate one behind a gap.
+ */
+std::vector<std::pair<uint64_t, std::string>> batchReads() {
+	std::vector<std::pair<uint64_t, std::string>> reads;
+	for (auto &&range : {std::make_pair(textStart, 16 * pageSize),
+	                     std::make_pair(textStart + 32 * pageSize, pageSize)}) {
+		std::string data;
+		for (uint64_t i = 0; i < range.second; i++) {
+			data.push_back(pageByte(range.first + i));
+		}
+		reads.emplace_back(range.first, data);
+	}
+	return reads;
+}
+
+/** A trace that answers reads, as (address, content) pairs */
+bool writeTrace(const std::string &fileName,
+                const std::vector<std::pair<uint64_t, std::string>> &reads) {
+	std::string trace{"KIVMITRC"};
+	appendValue<uint32_t>(VMITrace::version, &trace);
+	uint32_t blob = 0;
+	for (auto &&read : reads) {
+		std::string payload;
+		appendValue<uint32_t>(blob, &payload);
+		payload.append(read.second);
+		appendRecord(1, payload, &trace);
+
+		payload.clear();
+		appendValue<uint8_t>(0, &payload);  // READ_VA
+		appendValue<uint8_t>(1, &payload);  // ok
+		appendValue<uint32_t>(0, &payload); // pid
+		appendValue<uint64_t>(read.first, &payload);
+		appendValue<uint64_t>(read.second.size(), &payload);
+		appendValue<uint32_t>(blob++, &payload);
+		appendRecord(2, payload, &trace);
+	}
+
+	FILE *out = fopen(fileName.c_str(), "wb");
+	if (!out) {
+		return false;
+	}
+	bool ok = fwrite(trace.data(), 1, trace.size(), out) == trace.size();
+	return fclose(out) == 0 && ok;
+}
+
+/** Read the pages of the trace like the validation loop does */
+bool validatePass(PageBatch &batch, const PageBatch::Reader &reader) {
+	batch.clear();
+	for (uint64_t i = 0; i < 16; i++) {
+		batch.add(textStart + i * pageSize, pageSize);
+	}
+	batch.add(textStart + 32 * pageSize, pageSize);
+	batch.read(reader);
+
+	bool ok = true;
+	for (uint64_t page : {0, 1, 7, 15, 32}) {
+		uint64_t address = textStart + page * pageSize;
+		const uint8_t *memory = batch.get(address, pageSize);
+		for (uint64_t i = 0; ok && i < pageSize; i += 97) {
+			ok = memory && memory[i] == pageByte(address + i);
+		}
+	}
+	return ok;
+}
+
+} // namespace
+
+int main() {
+	std::vector<std::pair<uint64_t, std::string>> reads = batchReads();
+
+	// With a kernel the page validation runs on its text as well
+	const char *kernelDir = getenv("KERNINT_CHECK_KERNEL");
+	ElfKernelLoader *kernel = nullptr;
+	std::vector<page_info_t> textPages;
+	std::vector<page_info_t *> pages;
+	if (kernelDir && *kernelDir) {
+		kernel = KernelValidator::loadKernel(kernelDir);
+		const std::vector<uint8_t> &text = kernel->getTextSegment();
+		uint64_t start = (uint64_t)kernel->textSegment.memindex & 0xffffffffffff;
+		textPages.resize(kernel->textSegment.size / pageSize);
+		for (size_t i = 0; i < textPages.size(); i++) {
+			textPages[i] = page_info_t{};
+			textPages[i].vaddr = start + i * pageSize;
+			textPages[i].size  = pageSize;
+			pages.push_back(&textPages[i]);
+		}
+		auto chunkReads = KernelValidatorCheck::chunkReads(pages, text, start);
+		reads.insert(reads.end(), chunkReads.begin(), chunkReads.end());
+	} else {
+		printf("reads: KERNINT_CHECK_KERNEL not set, "
+		       "validatePageList() is not checked\n");
+	}
+
+	char fileName[] = "/tmp/kernint-check-reads-XXXXXX";
+	int fd = mkstemp(fileName);
+	if (fd < 0) {
+		perror("mkstemp");
+		return EXIT_FAILURE;
+	}
+	close(fd);
+
+	bool traceOk = writeTrace(fileName, reads) &&
+	               VMITrace::get().replay(fileName);
+	unlink(fileName);
+	if (!traceOk) {
+		fprintf(stderr, "Could not replay the trace\n");
+		return EXIT_FAILURE;
+	}
+
+	BufferPool pool;
+	PageBatch batch{&pool};
+	const PageBatch::Reader reader = [](uint64_t address, uint64_t len,
+	                                    uint8_t *buffer) {
+		return VMITrace::get().readVA(nullptr, address, len, buffer);
+	};
+
+	// The first pass fills the pool and sizes the vectors of the batch,
+	// returning its buffers sizes the free lists of the pool
+	if (!validatePass(batch, reader)) {
+		fprintf(stderr, "Wrong page contents\n");
+		return EXIT_FAILURE;
+	}
+	batch.clear();
+
+	size_t before = allocations;
+	for (int pass = 0; pass < 10; pass++) {
+		if (!validatePass(batch, reader)) {
+			fprintf(stderr, "Wrong page contents in pass %d\n", pass);
+			return EXIT_FAILURE;
+		}
+	}
+	size_t count = allocations - before;
+	batch.clear();
+
+	if (count) {
+		fprintf(stderr, "%zu allocations in 10 validation passes\n", count);
+		return EXIT_FAILURE;
+	}
+	printf("reads: no allocations after the first pass\n");
+
+	if (!kernel) {
+		return EXIT_SUCCESS;
+	}
+
+	// Two workers, the first pass starts them and sizes their state
+	KernelValidator validator{kernel};
+	validator.setThreadCount(2);
+	KernelValidatorCheck check{&validator};
+	check.validatePageList(pages);
+
+	before = allocations;
+	for (int pass = 0; pass < 3; pass++) {
+		check.validatePageList(pages);
+	}
+	count = allocations - before;
+	if (count) {
+		fprintf(stderr, "%zu allocations in 3 validatePageList() passes\n",
+		        count);
+		return EXIT_FAILURE;
+	}
+	printf("reads: validatePageList() does not allocate after the "
+	       "first pass\n");
+	return EXIT_SUCCESS;
+}
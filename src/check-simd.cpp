@@ -0,0 +1,169 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "simd.h"
+
+using namespace kernint;
+
+namespace {
+
+typedef size_t (*diff_func_t)(const uint8_t *, const uint8_t *,
+                              size_t, size_t);
+typedef void (*match_func_t)(const uint8_t *, size_t, uint8_t, uint64_t *);
+
+struct Variant {
+	const char *name;
+	diff_func_t diff;
+	match_func_t match;
+};
+
+std::vector<Variant> variants() {
+	std::vector<Variant> result;
+	result.push_back({"dispatch", findFirstDifference, findByteMatches});
+#if defined(__x86_64__)
+	result.push_back({"sse2", simd::findFirstDifferenceSSE2,
+	                  simd::findByteMatchesSSE2});
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		result.push_back({"avx2", simd::findFirstDifferenceAVX2,
+		                  simd::findByteMatchesAVX2});
+	} else {
+		printf("avx2 not supported, skipped\n");
+	}
+#endif
+	return result;
+}
+
+std::mt19937 rng(0x6b65726e);
+uint32_t failures = 0;
+
+void failDiff(const char *variant, size_t offset, size_t start,
+              size_t len, size_t expected, size_t result) {
+	if (failures++ < 20) {
+		fprintf(stderr, "%s: diff offset %zu start %zu len %zu: "
+		        "expected %zu got %zu\n",
+		        variant, offset, start, len, expected, result);
+	}
+}
+
+void checkDiff(const std::vector<Variant> &impls,
+               const uint8_t *a, const uint8_t *b,
+               size_t offset, size_t start, size_t len) {
+	size_t expected = simd::findFirstDifferenceScalar(a, b, start, len);
+	for (auto &&impl : impls) {
+		size_t result = impl.diff(a, b, start, len);
+		if (result != expected) {
+			failDiff(impl.name, offset, start, len, expected, result);
+		}
+	}
+}
+
+void checkMatch(const std::vector<Variant> &impls,
+                const uint8_t *data, size_t offset, size_t len,
+                uint8_t value) {
+	size_t words = (len + 63) / 64;
+	std::vector<uint64_t> expected(words);
+	simd::findByteMatchesScalar(data, len, value, expected.data());
+
+	for (auto &&impl : impls) {
+		// Poison the bitmap, the trailing bits have to be cleared
+		std::vector<uint64_t> bitmap(words, ~0ULL);
+		impl.match(data, len, value, bitmap.data());
+		for (size_t i = 0; i < words; i++) {
+			if (bitmap[i] != expected[i] && failures++ < 20) {
+				fprintf(stderr, "%s: match offset %zu len %zu value %02x: "
+				        "word %zu expected %016llx got %016llx\n",
+				        impl.name, offset, len, value, i,
+				        (unsigned long long)expected[i],
+				        (unsigned long long)bitmap[i]);
+			}
+		}
+	}
+}
+
+void fill(uint8_t *data, size_t len) {
+	for (size_t i = 0; i < len; i++) {
+		data[i] = rng();
+	}
+}
+
+} // namespace
+
+int main() {
+	const std::vector<Variant> impls = variants();
+
+	// Lengths around the 16, 32 and 64 byte steps and a few pages
+	std::vector<size_t> lengths;
+	for (size_t len = 0; len <= 200; len++) {
+		lengths.push_back(len);
+	}
+	for (size_t len : {255, 256, 257, 1000, 4095, 4096, 4097, 8191}) {
+		lengths.push_back(len);
+	}
+
+	const size_t maxOffset = 33;
+	std::vector<uint8_t> bufferA(8192 + maxOffset);
+	std::vector<uint8_t> bufferB(8192 + maxOffset);
+
+	for (size_t len : lengths) {
+		for (size_t offset : {0, 1, 3, 15, 17, 31, 33}) {
+			uint8_t *a = bufferA.data() + offset;
+			uint8_t *b = bufferB.data() + offset;
+
+			// All equal
+			fill(a, len);
+			memcpy(b, a, len);
+			checkDiff(impls, a, b, offset, 0, len);
+			if (len > 0) {
+				checkDiff(impls, a, b, offset, len / 2 + 1, len);
+			}
+
+			if (len > 0) {
+				// Difference in the first and in the last byte
+				b[0] ^= 0x80;
+				checkDiff(impls, a, b, offset, 0, len);
+				b[0] ^= 0x80;
+				b[len - 1] ^= 0x01;
+				checkDiff(impls, a, b, offset, 0, len);
+				for (size_t start : {(size_t)1, len / 2, len - 1, len}) {
+					checkDiff(impls, a, b, offset, start, len);
+				}
+
+				// One difference at a random position, starts before
+				// and after it
+				b[len - 1] ^= 0x01;
+				size_t pos = rng() % len;
+				b[pos] ^= 1 + rng() % 255;
+				for (size_t start : {(size_t)0, pos, pos + 1,
+				                     (size_t)(rng() % len)}) {
+					checkDiff(impls, a, b, offset, start, len);
+				}
+			}
+
+			// Random buffers
+			fill(b, len);
+			checkDiff(impls, a, b, offset, 0, len);
+			checkMatch(impls, a, offset, len, rng());
+
+			// Runs of the searched value and all equal buffers
+			memset(a, 0xe8, len);
+			checkMatch(impls, a, offset, len, 0xe8);
+			checkMatch(impls, a, offset, len, 0x00);
+			for (size_t i = 0; i < len; i++) {
+				a[i] = (rng() % 4 == 0) ? 0xe8 : rng();
+			}
+			checkMatch(impls, a, offset, len, 0xe8);
+		}
+	}
+
+	if (failures) {
+		fprintf(stderr, "%u failures\n", failures);
+		return EXIT_FAILURE;
+	}
+	printf("simd: %zu implementations agree with the scalar code\n",
+	       impls.size());
+	return EXIT_SUCCESS;
+}
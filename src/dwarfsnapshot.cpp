@@ -0,0 +1,821 @@
+#include "dwarfsnapshot.h"
+
+#include <cstring>
+#include <deque>
+#include <elf.h>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+#include "elffile64.h"
+#include "helpers.h"
+
+namespace kernint {
+
+static const char keySectionName[] = ".kernint.key";
+
+/** Everything kernint looks up by name in the kernel debug information */
+static const char *const snapshotTypes[] = {
+	"task_struct", "module", "jump_entry", "static_key", "pid_type",
+	"paravirt_patch_template", "pv_info", "pv_init_ops", "pv_time_ops",
+	"pv_cpu_ops", "pv_irq_ops", "pv_mmu_ops", "pv_lock_ops",
+};
+static const char *const snapshotVariables[] = {
+	"boot_cpu_data", "ideal_nops", "p6_nops", "k8_nops", "init_task",
+	"modules", "vdso_image_64", "pv_ops", "pv_info", "pv_init_ops",
+	"pv_time_ops", "pv_cpu_ops", "pv_irq_ops", "pv_apic_ops",
+	"pv_mmu_ops", "pv_lock_ops",
+};
+static const char *const snapshotFunctions[] = {
+	"_paravirt_nop", "_paravirt_ident_32", "_paravirt_ident_64",
+};
+
+/**
+ * Sections that are copied as they are. The others either are not
+ * needed for the types or have offsets into .debug_info.
+ */
+static const char *const copiedSections[] = {
+	".debug_abbrev", ".debug_str", ".debug_line", ".debug_line_str",
+	".debug_str_offsets", ".debug_addr", ".debug_ranges", ".debug_rnglists",
+	".debug_loc", ".debug_loclists",
+};
+
+namespace {
+
+/** The DWARF constants used here, see DWARF 5, 7.5 */
+enum : uint64_t {
+	DW_TAG_class_type       = 0x02,
+	DW_TAG_enumeration_type = 0x04,
+	DW_TAG_structure_type   = 0x13,
+	DW_TAG_typedef          = 0x16,
+	DW_TAG_union_type       = 0x17,
+	DW_TAG_base_type        = 0x24,
+	DW_TAG_subprogram       = 0x2e,
+	DW_TAG_variable         = 0x34,
+
+	DW_AT_location          = 0x02,
+	DW_AT_name              = 0x03,
+	DW_AT_low_pc            = 0x11,
+	DW_AT_abstract_origin   = 0x31,
+	DW_AT_declaration       = 0x3c,
+	DW_AT_specification     = 0x47,
+	DW_AT_entry_pc          = 0x52,
+	DW_AT_ranges            = 0x55,
+	DW_AT_str_offsets_base  = 0x72,
+
+	DW_FORM_addr            = 0x01,
+	DW_FORM_block2          = 0x03,
+	DW_FORM_block4          = 0x04,
+	DW_FORM_data2           = 0x05,
+	DW_FORM_data4           = 0x06,
+	DW_FORM_data8           = 0x07,
+	DW_FORM_string          = 0x08,
+	DW_FORM_block           = 0x09,
+	DW_FORM_block1          = 0x0a,
+	DW_FORM_data1           = 0x0b,
+	DW_FORM_flag            = 0x0c,
+	DW_FORM_sdata           = 0x0d,
+	DW_FORM_strp            = 0x0e,
+	DW_FORM_udata           = 0x0f,
+	DW_FORM_ref_addr        = 0x10,
+	DW_FORM_ref1            = 0x11,
+	DW_FORM_ref2            = 0x12,
+	DW_FORM_ref4            = 0x13,
+	DW_FORM_ref8            = 0x14,
+	DW_FORM_ref_udata       = 0x15,
+	DW_FORM_indirect        = 0x16,
+	DW_FORM_sec_offset      = 0x17,
+	DW_FORM_exprloc         = 0x18,
+	DW_FORM_flag_present    = 0x19,
+	DW_FORM_strx            = 0x1a,
+	DW_FORM_addrx           = 0x1b,
+	DW_FORM_ref_sup4        = 0x1c,
+	DW_FORM_strp_sup        = 0x1d,
+	DW_FORM_data16          = 0x1e,
+	DW_FORM_line_strp       = 0x1f,
+	DW_FORM_ref_sig8        = 0x20,
+	DW_FORM_implicit_const  = 0x21,
+	DW_FORM_loclistx        = 0x22,
+	DW_FORM_rnglistx        = 0x23,
+	DW_FORM_ref_sup8        = 0x24,
+	DW_FORM_strx1           = 0x25,
+	DW_FORM_strx2           = 0x26,
+	DW_FORM_strx3           = 0x27,
+	DW_FORM_strx4           = 0x28,
+	DW_FORM_addrx1          = 0x29,
+	DW_FORM_addrx2          = 0x2a,
+	DW_FORM_addrx3          = 0x2b,
+	DW_FORM_addrx4          = 0x2c,
+	DW_FORM_GNU_addr_index  = 0x1f01,
+	DW_FORM_GNU_str_index   = 0x1f02,
+	DW_FORM_GNU_ref_alt     = 0x1f20,
+	DW_FORM_GNU_strp_alt    = 0x1f21,
+
+	DW_UT_type              = 0x02,
+	DW_UT_skeleton          = 0x04,
+	DW_UT_split_compile     = 0x05,
+	DW_UT_split_type        = 0x06,
+};
+
+struct Section {
+	const uint8_t *data;
+	uint64_t size;
+	const Elf64_Shdr *header;
+};
+
+/** Bounds checked little endian reader, ok turns false on overrun */
+class Cursor {
+public:
+	Cursor(const uint8_t *data, uint64_t size)
+		:
+		pos{data},
+		end{data + size},
+		ok{true} {}
+
+	uint64_t read(uint8_t bytes) {
+		if ((uint64_t)(this->end - this->pos) < bytes) {
+			this->fail();
+			return 0;
+		}
+		uint64_t value = 0;
+		memcpy(&value, this->pos, bytes);
+		this->pos += bytes;
+		return value;
+	}
+
+	uint64_t uleb() {
+		uint64_t value = 0;
+		for (uint32_t shift = 0; this->pos < this->end; shift += 7) {
+			uint8_t byte = *this->pos++;
+			if (shift < 64) {
+				value |= (uint64_t)(byte & 0x7f) << shift;
+			}
+			if (!(byte & 0x80)) {
+				return value;
+			}
+		}
+		this->fail();
+		return 0;
+	}
+
+	/** Only skipped, the value is never needed */
+	void sleb() { this->uleb(); }
+
+	const char *string() {
+		const uint8_t *nul = (const uint8_t *)memchr(this->pos, 0,
+		                                             this->end - this->pos);
+		if (!nul) {
+			this->fail();
+			return nullptr;
+		}
+		const char *value = (const char *)this->pos;
+		this->pos = nul + 1;
+		return value;
+	}
+
+	void skip(uint64_t bytes) {
+		if ((uint64_t)(this->end - this->pos) < bytes) {
+			this->fail();
+			return;
+		}
+		this->pos += bytes;
+	}
+
+	const uint8_t *pos;
+	const uint8_t *end;
+	bool ok;
+
+private:
+	void fail() {
+		this->pos = this->end;
+		this->ok  = false;
+	}
+};
+
+struct Abbrev {
+	uint64_t tag;
+	bool children;
+	/** Pairs of attribute and form */
+	std::vector<std::pair<uint64_t, uint64_t>> attributes;
+};
+
+using AbbrevTable = std::unordered_map<uint64_t, Abbrev>;
+
+bool parseAbbrevs(const Section &section, uint64_t offset, AbbrevTable *table) {
+	if (offset > section.size) {
+		return false;
+	}
+	Cursor cursor{section.data + offset, section.size - offset};
+	while (true) {
+		uint64_t code = cursor.uleb();
+		if (!cursor.ok || code == 0) {
+			return cursor.ok;
+		}
+		Abbrev &abbrev  = (*table)[code];
+		abbrev.tag      = cursor.uleb();
+		abbrev.children = cursor.read(1);
+		abbrev.attributes.clear();
+		while (cursor.ok) {
+			uint64_t name = cursor.uleb();
+			uint64_t form = cursor.uleb();
+			if (form == DW_FORM_implicit_const) {
+				cursor.sleb();
+			}
+			if (!name && !form) {
+				break;
+			}
+			abbrev.attributes.emplace_back(name, form);
+		}
+	}
+}
+
+/** A compile unit of .debug_info including its header */
+struct Unit {
+	uint64_t offset;
+	uint64_t size;
+	/** Uses references into other units or files */
+	bool crossReferences;
+	/** Types only declared in this unit */
+	std::vector<std::string> declaredTypes;
+};
+
+/** Which unit defines which names */
+class DebugIndex {
+public:
+	DebugIndex(const Section &info, const Section &abbrev, const Section &str,
+	           const Section &lineStr, const Section &strOffsets)
+		:
+		info(info),
+		abbrev(abbrev),
+		str(str),
+		lineStr(lineStr),
+		strOffsets(strOffsets) {}
+
+	bool build();
+
+	std::vector<Unit> units;
+	/** The first unit with a definition of the name */
+	std::unordered_map<std::string, size_t> types;
+	std::unordered_map<std::string, size_t> variables;
+	std::unordered_map<std::string, size_t> functions;
+
+private:
+	struct Value {
+		uint64_t number;
+		const char *string;
+		/** number is a reference relative to the unit */
+		bool unitReference;
+	};
+
+	bool indexUnit(size_t unitIndex, Cursor &cursor, uint16_t version,
+	               uint8_t addressSize, uint8_t offsetSize,
+	               const AbbrevTable &abbrevs);
+	bool readForm(Cursor &cursor, uint64_t form, Unit &unit,
+	              uint16_t version, uint8_t addressSize, uint8_t offsetSize,
+	              Value *value);
+	const char *stringAt(const Section &section, uint64_t offset) const;
+
+	const Section &info;
+	const Section &abbrev;
+	const Section &str;
+	const Section &lineStr;
+	const Section &strOffsets;
+
+	uint64_t strOffsetsBase;
+};
+
+const char *DebugIndex::stringAt(const Section &section, uint64_t offset) const {
+	if (!section.data || offset >= section.size ||
+	    !memchr(section.data + offset, 0, section.size - offset)) {
+		return nullptr;
+	}
+	return (const char *)section.data + offset;
+}
+
+bool DebugIndex::readForm(Cursor &cursor, uint64_t form, Unit &unit,
+                          uint16_t version, uint8_t addressSize,
+                          uint8_t offsetSize, Value *value) {
+	value->number        = 0;
+	value->string        = nullptr;
+	value->unitReference = false;
+
+	uint64_t strIndex = 0;
+	switch (form) {
+	case DW_FORM_addr:        cursor.skip(addressSize); return true;
+	case DW_FORM_block1:      cursor.skip(cursor.read(1)); return true;
+	case DW_FORM_block2:      cursor.skip(cursor.read(2)); return true;
+	case DW_FORM_block4:      cursor.skip(cursor.read(4)); return true;
+	case DW_FORM_block:
+	case DW_FORM_exprloc:     cursor.skip(cursor.uleb()); return true;
+	case DW_FORM_flag:
+	case DW_FORM_data1:       value->number = cursor.read(1); return true;
+	case DW_FORM_data2:       value->number = cursor.read(2); return true;
+	case DW_FORM_data4:       value->number = cursor.read(4); return true;
+	case DW_FORM_data8:       value->number = cursor.read(8); return true;
+	case DW_FORM_data16:      cursor.skip(16); return true;
+	case DW_FORM_sdata:       cursor.sleb(); return true;
+	case DW_FORM_udata:
+	case DW_FORM_addrx:
+	case DW_FORM_loclistx:
+	case DW_FORM_rnglistx:
+	case DW_FORM_GNU_addr_index:
+		value->number = cursor.uleb();
+		return true;
+	case DW_FORM_addrx1:      cursor.skip(1); return true;
+	case DW_FORM_addrx2:      cursor.skip(2); return true;
+	case DW_FORM_addrx3:      cursor.skip(3); return true;
+	case DW_FORM_addrx4:      cursor.skip(4); return true;
+	case DW_FORM_sec_offset:  value->number = cursor.read(offsetSize); return true;
+	case DW_FORM_flag_present:
+	case DW_FORM_implicit_const:
+		value->number = 1;
+		return true;
+	case DW_FORM_string:
+		value->string = cursor.string();
+		return true;
+	case DW_FORM_strp:
+		value->string = this->stringAt(this->str, cursor.read(offsetSize));
+		return true;
+	case DW_FORM_line_strp:
+		value->string = this->stringAt(this->lineStr, cursor.read(offsetSize));
+		return true;
+	case DW_FORM_ref1:
+	case DW_FORM_ref2:
+	case DW_FORM_ref4:
+	case DW_FORM_ref8:
+		value->number = cursor.read(1 << (form - DW_FORM_ref1));
+		value->unitReference = true;
+		return true;
+	case DW_FORM_ref_udata:
+		value->number = cursor.uleb();
+		value->unitReference = true;
+		return true;
+	case DW_FORM_ref_addr:
+		unit.crossReferences = true;
+		cursor.skip(version <= 2 ? addressSize : offsetSize);
+		return true;
+	case DW_FORM_ref_sig8:
+	case DW_FORM_ref_sup8:
+		unit.crossReferences = true;
+		cursor.skip(8);
+		return true;
+	case DW_FORM_ref_sup4:
+		unit.crossReferences = true;
+		cursor.skip(4);
+		return true;
+	case DW_FORM_strp_sup:
+	case DW_FORM_GNU_ref_alt:
+	case DW_FORM_GNU_strp_alt:
+		unit.crossReferences = true;
+		cursor.skip(offsetSize);
+		return true;
+	case DW_FORM_GNU_str_index:
+		// Only in split DWARF, the string is in the .dwo file
+		cursor.uleb();
+		return true;
+	case DW_FORM_indirect:
+		return this->readForm(cursor, cursor.uleb(), unit, version,
+		                      addressSize, offsetSize, value);
+	case DW_FORM_strx:        strIndex = cursor.uleb(); break;
+	case DW_FORM_strx1:       strIndex = cursor.read(1); break;
+	case DW_FORM_strx2:       strIndex = cursor.read(2); break;
+	case DW_FORM_strx3:       strIndex = cursor.read(3); break;
+	case DW_FORM_strx4:       strIndex = cursor.read(4); break;
+	default:
+		return false;
+	}
+
+	// One of the strx forms
+	uint64_t entry = this->strOffsetsBase + strIndex * offsetSize;
+	if (this->strOffsets.data && entry + offsetSize <= this->strOffsets.size) {
+		uint64_t offset = 0;
+		memcpy(&offset, this->strOffsets.data + entry, offsetSize);
+		value->string = this->stringAt(this->str, offset);
+	}
+	return true;
+}
+
+bool DebugIndex::indexUnit(size_t unitIndex, Cursor &cursor, uint16_t version,
+                           uint8_t addressSize, uint8_t offsetSize,
+                           const AbbrevTable &abbrevs) {
+	Unit &unit = this->units[unitIndex];
+
+	// Names of the top level entries, to resolve specifications
+	std::unordered_map<uint64_t, const char *> names;
+	std::vector<std::pair<uint64_t, std::unordered_map<std::string, size_t> *>> specifications;
+
+	// Default for units without DW_AT_str_offsets_base
+	this->strOffsetsBase = 2 * offsetSize;
+
+	uint32_t depth = 0;
+	while (cursor.ok && cursor.pos < cursor.end) {
+		uint64_t entryOffset = cursor.pos - (this->info.data + unit.offset);
+		uint64_t code = cursor.uleb();
+		if (code == 0) {
+			depth -= depth ? 1 : 0;
+			continue;
+		}
+		auto abbrev = abbrevs.find(code);
+		if (abbrev == abbrevs.end()) {
+			return false;
+		}
+
+		const char *name     = nullptr;
+		bool declaration     = false;
+		bool hasAddress      = false;
+		uint64_t origin      = 0;
+		for (auto &&attribute : abbrev->second.attributes) {
+			Value value;
+			if (!this->readForm(cursor, attribute.second, unit, version,
+			                    addressSize, offsetSize, &value)) {
+				return false;
+			}
+			switch (attribute.first) {
+			case DW_AT_name:
+				name = value.string;
+				break;
+			case DW_AT_declaration:
+				declaration = value.number;
+				break;
+			case DW_AT_specification:
+			case DW_AT_abstract_origin:
+				origin = value.unitReference ? value.number : 0;
+				break;
+			case DW_AT_location:
+			case DW_AT_low_pc:
+			case DW_AT_entry_pc:
+			case DW_AT_ranges:
+				hasAddress = true;
+				break;
+			case DW_AT_str_offsets_base:
+				if (depth == 0) {
+					this->strOffsetsBase = value.number;
+				}
+				break;
+			}
+		}
+
+		if (depth == 1) {
+			uint64_t tag = abbrev->second.tag;
+			if (name) {
+				names[entryOffset] = name;
+			}
+
+			std::unordered_map<std::string, size_t> *defined = nullptr;
+			if (tag == DW_TAG_structure_type || tag == DW_TAG_union_type ||
+			    tag == DW_TAG_class_type || tag == DW_TAG_enumeration_type) {
+				if (name && declaration) {
+					unit.declaredTypes.push_back(name);
+				} else {
+					defined = &this->types;
+				}
+			} else if (tag == DW_TAG_typedef || tag == DW_TAG_base_type) {
+				defined = &this->types;
+			} else if (tag == DW_TAG_variable && hasAddress && !declaration) {
+				defined = &this->variables;
+			} else if (tag == DW_TAG_subprogram && hasAddress && !declaration) {
+				defined = &this->functions;
+			}
+
+			if (defined && name) {
+				defined->emplace(name, unitIndex);
+			} else if (defined && origin) {
+				specifications.emplace_back(origin, defined);
+			}
+		}
+
+		if (abbrev->second.children) {
+			depth++;
+		}
+	}
+
+	// The definition refers to the named declaration
+	for (auto &&specification : specifications) {
+		auto name = names.find(specification.first);
+		if (name != names.end()) {
+			specification.second->emplace(name->second, unitIndex);
+		}
+	}
+	return cursor.ok;
+}
+
+bool DebugIndex::build() {
+	std::unordered_map<uint64_t, AbbrevTable> abbrevTables;
+
+	uint64_t offset = 0;
+	while (offset < this->info.size) {
+		Cursor cursor{this->info.data + offset, this->info.size - offset};
+		uint8_t offsetSize = 4;
+		uint64_t length = cursor.read(4);
+		if (length == 0xffffffff) {
+			offsetSize = 8;
+			length = cursor.read(8);
+		}
+		uint64_t headerSize = cursor.pos - (this->info.data + offset);
+		if (!cursor.ok || length > this->info.size - offset - headerSize) {
+			return false;
+		}
+		cursor.end = cursor.pos + length;
+
+		uint16_t version = cursor.read(2);
+		uint64_t abbrevOffset;
+		uint8_t addressSize;
+		if (version >= 5) {
+			uint8_t unitType = cursor.read(1);
+			addressSize  = cursor.read(1);
+			abbrevOffset = cursor.read(offsetSize);
+			if (unitType == DW_UT_type || unitType == DW_UT_split_type) {
+				cursor.skip(8 + offsetSize);
+			} else if (unitType == DW_UT_skeleton ||
+			           unitType == DW_UT_split_compile) {
+				cursor.skip(8);
+			}
+		} else {
+			abbrevOffset = cursor.read(offsetSize);
+			addressSize  = cursor.read(1);
+		}
+		if (!cursor.ok || version < 2 || version > 5) {
+			return false;
+		}
+
+		auto abbrevs = abbrevTables.find(abbrevOffset);
+		if (abbrevs == abbrevTables.end()) {
+			abbrevs = abbrevTables.emplace(abbrevOffset, AbbrevTable{}).first;
+			if (!parseAbbrevs(this->abbrev, abbrevOffset, &abbrevs->second)) {
+				return false;
+			}
+		}
+
+		this->units.push_back({offset, headerSize + length, false, {}});
+		if (!this->indexUnit(this->units.size() - 1, cursor, version,
+		                     addressSize, offsetSize, abbrevs->second)) {
+			return false;
+		}
+		offset += headerSize + length;
+	}
+	return true;
+}
+
+} // namespace
+
+DwarfSnapshot::DwarfSnapshot(const std::string &fileName, ElfFile *elffile)
+	:
+	fileName{fileName},
+	elffile{elffile} {
+
+	std::stringstream key;
+	key << "v" << version << " " << elffile->getBuildID();
+	struct stat fileStat;
+	if (stat(elffile->getFilename().c_str(), &fileStat) == 0) {
+		key << " " << fileStat.st_size << ":" << fileStat.st_mtime;
+	}
+	this->key = key.str();
+}
+
+FILE *DwarfSnapshot::open() const {
+	FILE *file = fopen(this->fileName.c_str(), "rb");
+	if (!file) {
+		return nullptr;
+	}
+
+	auto readAt = [file](uint64_t offset, void *data, size_t size) {
+		return fseek(file, offset, SEEK_SET) == 0 &&
+		       fread(data, 1, size, file) == size;
+	};
+
+	Elf64_Ehdr header;
+	std::vector<Elf64_Shdr> sections;
+	std::vector<char> names;
+	bool valid = readAt(0, &header, sizeof(header)) &&
+	             memcmp(header.e_ident, ELFMAG, SELFMAG) == 0 &&
+	             header.e_ident[EI_CLASS] == ELFCLASS64 &&
+	             header.e_shentsize == sizeof(Elf64_Shdr) &&
+	             header.e_shstrndx < header.e_shnum;
+	if (valid) {
+		sections.resize(header.e_shnum);
+		const Elf64_Shdr &nameSection = sections[header.e_shstrndx];
+		valid = readAt(header.e_shoff, sections.data(),
+		               sections.size() * sizeof(Elf64_Shdr)) &&
+		        nameSection.sh_size > 0 && nameSection.sh_size < (1 << 20);
+		if (valid) {
+			names.resize(nameSection.sh_size);
+			valid = readAt(nameSection.sh_offset, names.data(), names.size());
+			names.back() = 0;
+		}
+	}
+
+	bool matches = false;
+	for (size_t i = 0; valid && i < sections.size(); i++) {
+		if (sections[i].sh_name >= names.size() ||
+		    strcmp(&names[sections[i].sh_name], keySectionName) != 0) {
+			continue;
+		}
+		if (sections[i].sh_size == this->key.size()) {
+			std::string key(this->key.size(), 0);
+			matches = readAt(sections[i].sh_offset, &key[0], key.size()) &&
+			          key == this->key;
+		}
+		break;
+	}
+
+	if (!matches) {
+		fclose(file);
+		return nullptr;
+	}
+	rewind(file);
+	return file;
+}
+
+bool DwarfSnapshot::create() const {
+	ElfFile64 *elf64 = dynamic_cast<ElfFile64 *>(this->elffile);
+	if (!elf64) {
+		return false;
+	}
+
+	std::unordered_map<std::string, Section> sections;
+	for (unsigned int i = 0; i < elf64->getNrOfSections(); i++) {
+		const Elf64_Shdr *header = &elf64->elf64Shdr[i];
+		if (header->sh_type == SHT_NOBITS) {
+			continue;
+		}
+		sections.emplace(elf64->sectionName(i),
+		                 Section{elf64->getFileContent() + header->sh_offset,
+		                         header->sh_size, header});
+	}
+
+	auto section = [&sections](const char *name) {
+		auto it = sections.find(name);
+		return it == sections.end() ? Section{nullptr, 0, nullptr} : it->second;
+	};
+	Section info       = section(".debug_info");
+	Section abbrev     = section(".debug_abbrev");
+	Section str        = section(".debug_str");
+	Section lineStr    = section(".debug_line_str");
+	Section strOffsets = section(".debug_str_offsets");
+	for (auto &&read : {info, abbrev, str, lineStr, strOffsets}) {
+		if (read.header && (read.header->sh_flags & SHF_COMPRESSED)) {
+			std::cout << COLOR_RED << "Compressed debug information is not "
+			          << "supported by the DWARF snapshot" << COLOR_NORM
+			          << std::endl;
+			return false;
+		}
+	}
+	if (!info.data || !abbrev.data) {
+		return false;
+	}
+
+	DebugIndex index{info, abbrev, str, lineStr, strOffsets};
+	if (!index.build()) {
+		std::cout << COLOR_RED << "Could not index the debug information of "
+		          << this->elffile->getFilename() << COLOR_NORM << std::endl;
+		return false;
+	}
+
+	// Select the defining units, then the ones of the types they only
+	// declare until nothing is missing
+	std::vector<bool> selected(index.units.size(), false);
+	std::deque<size_t> pending;
+	auto select = [&](const std::unordered_map<std::string, size_t> &names,
+	                  const std::string &name) {
+		auto unit = names.find(name);
+		if (unit != names.end() && !selected[unit->second]) {
+			selected[unit->second] = true;
+			pending.push_back(unit->second);
+		}
+	};
+	for (auto &&name : snapshotTypes) {
+		select(index.types, name);
+	}
+	for (auto &&name : snapshotVariables) {
+		select(index.variables, name);
+	}
+	for (auto &&name : snapshotFunctions) {
+		// kernint does not work without them, this is no kernel
+		if (!index.functions.count(name)) {
+			std::cout << COLOR_RED << "No definition of " << name << " in "
+			          << this->elffile->getFilename() << COLOR_NORM
+			          << std::endl;
+			return false;
+		}
+		select(index.functions, name);
+	}
+	while (!pending.empty()) {
+		const Unit &unit = index.units[pending.front()];
+		pending.pop_front();
+		for (auto &&name : unit.declaredTypes) {
+			select(index.types, name);
+		}
+	}
+
+	std::string debugInfo;
+	size_t unitCount = 0;
+	for (size_t i = 0; i < index.units.size(); i++) {
+		if (!selected[i]) {
+			continue;
+		}
+		const Unit &unit = index.units[i];
+		if (unit.crossReferences) {
+			// The referenced offsets change when units are left out
+			std::cout << COLOR_RED << "The debug information of "
+			          << this->elffile->getFilename()
+			          << " references across compile units, "
+			          << "no DWARF snapshot possible" << COLOR_NORM << std::endl;
+			return false;
+		}
+		debugInfo.append((const char *)info.data + unit.offset, unit.size);
+		unitCount++;
+	}
+
+	// Header, section contents, section headers
+	struct OutputSection {
+		std::string name;
+		const char *data;
+		uint64_t size;
+		Elf64_Shdr header;
+	};
+	std::vector<OutputSection> output;
+	output.push_back({".debug_info", debugInfo.data(), debugInfo.size(),
+	                  *info.header});
+	for (auto &&name : copiedSections) {
+		Section copied = section(name);
+		if (copied.header) {
+			output.push_back({name, (const char *)copied.data, copied.size,
+			                  *copied.header});
+		}
+	}
+	Elf64_Shdr keyHeader;
+	memset(&keyHeader, 0, sizeof(keyHeader));
+	keyHeader.sh_type      = SHT_PROGBITS;
+	keyHeader.sh_addralign = 1;
+	output.push_back({keySectionName, this->key.data(), this->key.size(),
+	                  keyHeader});
+
+	std::string sectionNames(1, '\0');
+	for (auto &&section : output) {
+		section.header.sh_name = sectionNames.size();
+		sectionNames.append(section.name).push_back('\0');
+	}
+	Elf64_Shdr namesHeader = keyHeader;
+	namesHeader.sh_name = sectionNames.size();
+	namesHeader.sh_type = SHT_STRTAB;
+	sectionNames.append(".shstrtab").push_back('\0');
+	output.push_back({".shstrtab", sectionNames.data(), sectionNames.size(),
+	                  namesHeader});
+
+	std::string content;
+	std::vector<Elf64_Shdr> headers(1);
+	memset(&headers[0], 0, sizeof(Elf64_Shdr));
+	for (auto &&section : output) {
+		content.resize((content.size() + 7) & ~(size_t)7);
+		section.header.sh_offset = sizeof(Elf64_Ehdr) + content.size();
+		section.header.sh_size   = section.size;
+		section.header.sh_addr   = 0;
+		section.header.sh_flags &= ~(uint64_t)SHF_ALLOC;
+		section.header.sh_link   = 0;
+		section.header.sh_info   = 0;
+		content.append(section.data, section.size);
+		headers.push_back(section.header);
+	}
+	content.resize((content.size() + 7) & ~(size_t)7);
+
+	Elf64_Ehdr header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.e_ident, elf64->elf64Ehdr->e_ident, EI_NIDENT);
+	header.e_type      = elf64->elf64Ehdr->e_type;
+	header.e_machine   = elf64->elf64Ehdr->e_machine;
+	header.e_version   = EV_CURRENT;
+	header.e_shoff     = sizeof(Elf64_Ehdr) + content.size();
+	header.e_ehsize    = sizeof(Elf64_Ehdr);
+	header.e_shentsize = sizeof(Elf64_Shdr);
+	header.e_shnum     = headers.size();
+	header.e_shstrndx  = headers.size() - 1;
+
+	// Write to a temporary file first, so that concurrent readers never
+	// see a partially written snapshot.
+	std::string tmpFile = this->fileName + ".tmp";
+	std::ofstream outfile(tmpFile, std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!outfile.is_open()) {
+		return false;
+	}
+	outfile.write((const char *)&header, sizeof(header));
+	outfile.write(content.data(), content.size());
+	outfile.write((const char *)headers.data(),
+	              headers.size() * sizeof(Elf64_Shdr));
+	outfile.close();
+
+	if (!outfile || rename(tmpFile.c_str(), this->fileName.c_str()) != 0) {
+		unlink(tmpFile.c_str());
+		return false;
+	}
+
+	std::cout << "Created DWARF snapshot " << this->fileName << " with "
+	          << unitCount << " of " << index.units.size()
+	          << " compile units" << std::endl;
+	return true;
+}
+
+} // namespace kernint
@@ -0,0 +1,54 @@
+#ifndef KERNINT_DWARFSNAPSHOT_H_
+#define KERNINT_DWARFSNAPSHOT_H_
+
+#include <cstdio>
+#include <string>
+
+namespace kernint {
+
+class ElfFile;
+
+/**
+ * Reduced copy of the kernel debug information, so later runs do not
+ * parse the DWARF of the whole kernel.
+ *
+ * The snapshot is an ELF file with the compile units of .debug_info
+ * that define the types, variables and functions kernint looks up by
+ * name. Types that are only declared in a kept unit are followed, so
+ * every structure reachable from those has its full definition.
+ * The abbrev, string, range and location sections are copied as they
+ * are, the offsets into them stay valid.
+ *
+ * The section .kernint.key holds the build id and file identity of the
+ * kernel, a snapshot of another kernel is ignored and replaced.
+ */
+class DwarfSnapshot {
+public:
+	static const uint32_t version = 1;
+
+	DwarfSnapshot(const std::string &fileName, ElfFile *elffile);
+
+	/**
+	 * Open the snapshot for parsing, nullptr if it is missing or
+	 * belongs to another kernel.
+	 */
+	FILE *open() const;
+
+	/**
+	 * Extract the snapshot from the debug information of the kernel.
+	 * Returns false if it has none or uses references across compile
+	 * units, the full DWARF has to be parsed then.
+	 */
+	bool create() const;
+
+	const std::string &getFileName() const { return this->fileName; }
+
+private:
+	std::string fileName;
+	ElfFile *elffile;
+	std::string key;
+};
+
+} // namespace kernint
+
+#endif
@@ -1,5 +1,6 @@
 #include "elffile.h"
 
+#include "dwarfsnapshot.h"
 #include "exceptions.h"
 #include "elfloader.h"
 
@@ -136,13 +137,31 @@ ElfFile::~ElfFile(){
 	fclose(this->fd);
 }
 
-void ElfFile::parseDwarf() {
+void ElfFile::parseDwarf(const std::string &snapshotFile) {
+	FILE *snapshot = nullptr;
+	if (!snapshotFile.empty()) {
+		DwarfSnapshot dwarfSnapshot{snapshotFile, this};
+		snapshot = dwarfSnapshot.open();
+		if (!snapshot && dwarfSnapshot.create()) {
+			snapshot = dwarfSnapshot.open();
+		}
+		if (!snapshot) {
+			std::cout << "Parsing the full debug information of "
+			          << this->filename << std::endl;
+		}
+	}
+
 	try {
-		DwarfParser::parseDwarfFromFD(this->getFD(), this->symbols);
+		DwarfParser::parseDwarfFromFD(snapshot ? fileno(snapshot) : this->getFD(),
+		                              this->symbols);
 	} catch(DwarfException &e) {
 		//std::cout << e.what() << std::endl;
 		e.what();
 	}
+
+	if (snapshot) {
+		fclose(snapshot);
+	}
 }
 
 ElfFile *ElfFile::loadElfFile(const std::string &filename) {
@@ -235,12 +254,20 @@ ElfFile* ElfFile::loadElfFileFromBuffer(const std::string &filename,
 	return elfFile;
 }
 
+std::string ElfFile::getBuildID() const {
+	auto it = this->section_names.find(".note.gnu.build-id");
+	if (it == this->section_names.end() || it->second->size <= 16) {
+		return "";
+	}
+	// Skip the note header and the "GNU" name
+	auto buildIdSection = *(it->second);
+	return hexStr(buildIdSection.index+16, buildIdSection.size-16);
+}
+
 ElfFile* ElfFile::loadDebugVersion() const {
 	ElfFile* dbg = nullptr;
-	auto it = this->section_names.find(".note.gnu.build-id");
-	if (it != this->section_names.end()) {
-		auto buildIdSection = *(it->second);
-		std::string buildID = hexStr(buildIdSection.index+16, buildIdSection.size-16);
+	std::string buildID = this->getBuildID();
+	if (!buildID.empty()) {
 		std::stringstream s;
 		s << "/home/kittel/guest" << "/usr/lib/debug/.build-id/"
 		  << buildID.substr(0,2) << "/" << buildID.substr(2) << ".debug";
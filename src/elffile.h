@@ -153,6 +153,12 @@ public:
 	std::string getFilename();
 	void printSymbols(uint32_t symindex);
 
+	/**
+	 * Hex encoded content of the .note.gnu.build-id section,
+	 * empty if the file has none.
+	 */
+	std::string getBuildID() const;
+
 	uint8_t *getFileContent();
 	size_t getFileSize();
 
@@ -170,9 +176,11 @@ public:
 	static ElfFile *loadElfFile(const std::string &filename);
 
 	/**
-	 * Parse this elf file as a kernel blob.
+	 * Parse this elf file as a kernel blob. If dwarfSnapshot is given,
+	 * the types are parsed from that DwarfSnapshot, which is created
+	 * first if it is missing or outdated.
 	 */
-	virtual ElfKernelLoader *parseKernel() = 0;
+	virtual ElfKernelLoader *parseKernel(const std::string &dwarfSnapshot="") = 0;
 
 	/**
 	 * Parse this elf file as a kernel module associated with a given kernel.
@@ -216,9 +224,10 @@ protected:
 	        ElfProgramType programType);
 
 	/**
-	 * Parse the dwarf information from the binary.
+	 * Parse the dwarf information from the binary,
+	 * or from the DwarfSnapshot snapshotFile if given.
 	 */
-	void parseDwarf();
+	void parseDwarf(const std::string &snapshotFile="");
 
 	FILE *fd;
 	size_t fileSize;
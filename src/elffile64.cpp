@@ -12,6 +12,7 @@
 #include "kernel.h"
 #include "libdwarfparser/libdwarfparser.h"
 #include "libvmiwrapper/libvmiwrapper.h"
+#include "metrics.h"
 #include "process.h"
 
 
@@ -133,10 +134,10 @@ void ElfFile64::addSymbolsToStore(SymbolManager *store, uint64_t memindex) const
 	}
 }
 
-ElfKernelLoader *ElfFile64::parseKernel() {
+ElfKernelLoader *ElfFile64::parseKernel(const std::string &dwarfSnapshot) {
 	auto kernel = new ElfKernelLoader64(this);
 	this->symbols = &(kernel->symbols);
-	this->parseDwarf();
+	this->parseDwarf(dwarfSnapshot);
 	kernel->getParavirtState()->updateState();
 	return kernel;
 }
@@ -307,6 +308,7 @@ bool ElfFile64::isDynamicLibrary() const {
 void ElfFile64::applyRelocations(ElfLoader *loader,
                                  Kernel *kernel,
                                  Process *process) {
+	ScopedTimer timer{Metrics::RELOCATION};
 
 	//std::cout << COLOR_GREEN << " == Relocating: "
 	//          << this->filename << COLOR_NORM
@@ -372,6 +374,7 @@ void ElfFile64::applyRelaOnSection(uint32_t relSectionID,
 	SectionInfo relSectionInfo = this->findSectionByID(relSectionID);
 
 	Elf64_Rela *rel = reinterpret_cast<Elf64_Rela *>(relSectionInfo.index);
+	Metrics::count(Metrics::RELOCATIONS, relSectionInfo.size / sizeof(*rel));
 	Elf64_Sym *symBase = reinterpret_cast<Elf64_Sym *>(this->sectionAddress(symindex));
 
 	// TODO move this to a dedicated function if used with kernel modules
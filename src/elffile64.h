@@ -49,7 +49,7 @@ public:
 
 	uint64_t entryPoint() const override;
 
-	ElfKernelLoader *parseKernel() override;
+	ElfKernelLoader *parseKernel(const std::string &dwarfSnapshot="") override;
 	ElfModuleLoader *parseKernelModule(const std::string &name,
 	                                   Kernel *kernel) override;
 	ElfUserspaceLoader *parseUserspace(const std::string &name,
@@ -1,10 +1,14 @@
 #include "elfkernelloader.h"
 
+#include <algorithm>
 #include <cassert>
+#include <sstream>
+#include <sys/stat.h>
 
 #include "elfmoduleloader.h"
 #include "exceptions.h"
 #include "helpers.h"
+#include "imagecache.h"
 
 namespace kernint {
 
@@ -13,23 +17,73 @@ ElfKernelLoader::ElfKernelLoader(ElfFile *elffile)
 	ElfKernelspaceLoader{elffile, this->getParavirtState()},
 	name{"kernel"},
 	fentryAddress{0},
-	genericUnrolledAddress{0} {}
+	genericUnrolledAddress{0},
+	indexedModules{0} {}
 
 ElfKernelLoader::~ElfKernelLoader() {}
 
-void ElfKernelLoader::initText() {
-	using namespace std::string_literals;
+void ElfKernelLoader::initImage() {
+	if (this->getCacheDir().empty()) {
+		ElfLoader::initImage();
+		return;
+	}
 
-	ElfFile64 *elffile = dynamic_cast<ElfFile64*>(this->elffile);
+	ImageCache cache{ImageCache::path(this->getCacheDir(), "vmlinux",
+	                                  this->elffile->getBuildID()),
+	                 this->imageCacheKey()};
+
+	if (!cache.load(this)) {
+		ElfLoader::initImage();
+		if (!cache.store(this)) {
+			std::cout << "Could not write image cache "
+			          << cache.getFileName() << std::endl;
+		}
+		return;
+	}
+
+	std::cout << "Using cached kernel image " << cache.getFileName()
+	          << std::endl;
+	this->initTextSections();
+	this->elffile->addSymbolsToStore(&this->symbols,
+	                                 (uint64_t)this->textSegment.memindex);
+	this->initDataSections();
+	this->roDataSection.size = this->roData.size();
+}
+
+std::string ElfKernelLoader::imageCacheKey() {
+	std::stringstream key;
+	key << this->elffile->getBuildID();
+
+	// The static keys and the ideal nops are read from vmlinux,
+	// the file has to be the same, not just the build
+	for (auto &&file : {"/vmlinux", "/System.map", "/kallsyms"}) {
+		struct stat fileStat;
+		if (stat((this->getKernelDir() + file).c_str(), &fileStat) == 0) {
+			key << " " << fileStat.st_size << ":" << fileStat.st_mtime;
+		}
+	}
+
+	key << " " << this->patchStateKey();
+	return key.str();
+}
+
+void ElfKernelLoader::initTextSections() {
+	using namespace std::string_literals;
 
 	// we assume, the .text section is the beginning of the code segment
 	// yes, the name must be changed to this->textSection.
-	this->textSegment = elffile->findSectionWithName(".text"s);
+	this->textSegment = this->elffile->findSectionWithName(".text"s);
 	this->updateSectionInfoMemAddress(this->textSegment);
 
 	this->fentryAddress = this->symbols.getSystemMapAddress("__fentry__", true);
 	this->genericUnrolledAddress = this->symbols.getSystemMapAddress("copy_user_generic_unrolled", true);
 	assert(this->genericUnrolledAddress);
+}
+
+void ElfKernelLoader::initText() {
+	ElfFile64 *elffile = dynamic_cast<ElfFile64*>(this->elffile);
+
+	this->initTextSections();
 
 	// patch kernel stuff.
 	this->applyAltinstr(&this->pvpatcher);
@@ -99,9 +153,11 @@ void ElfKernelLoader::initText() {
 
 	this->elffile->addSymbolsToStore(&this->symbols,
 	                                 (uint64_t)this->textSegment.memindex);
+
+	this->finalizeText();
 }
 
-void ElfKernelLoader::initData(void) {
+void ElfKernelLoader::initDataSections() {
 	this->dataSection       = elffile->findSectionWithName(".data");
 	this->vvarSegment       = elffile->findSectionWithName(".vvar");
 	this->dataNosaveSegment = elffile->findSectionWithName(".data_nosave");
@@ -112,6 +168,10 @@ void ElfKernelLoader::initData(void) {
 	this->nmi_idt_tableAddress = this->symbols.getSymbolAddress("nmi_idt_table");
 	this->sinittextAddress = this->symbols.getSymbolAddress("_sinittext");
 	this->irq_entries_startAddress = this->symbols.getSymbolAddress("irq_entries_start");
+}
+
+void ElfKernelLoader::initData(void) {
+	this->initDataSections();
 
 	// initialize roData Segment
 	SectionInfo info = elffile->findSectionWithName("__modver");
@@ -131,7 +191,109 @@ bool ElfKernelLoader::isDataAddress(uint64_t addr) {
 	return this->elffile->isDataAddress(addr | 0xffff000000000000);
 }
 
+void ElfKernelLoader::updateAddressIndex() {
+	std::vector<AddressRegion> regions;
+
+	// Add a range only where it is not yet covered, so earlier ranges
+	// take precedence just like in the linear lookup.
+	auto paint = [&regions](uint64_t start, uint64_t end,
+	                        ElfKernelspaceLoader *loader, AddressKind kind) {
+		std::vector<AddressRegion> gaps;
+		uint64_t current = start;
+		for (auto &&region : regions) {
+			if (current >= end || region.start >= end) {
+				break;
+			}
+			if (region.end <= current) {
+				continue;
+			}
+			if (region.start > current) {
+				gaps.push_back({current, region.start, loader, kind});
+			}
+			current = std::max(current, region.end);
+		}
+		if (current < end) {
+			gaps.push_back({current, end, loader, kind});
+		}
+		regions.insert(regions.end(), gaps.begin(), gaps.end());
+		std::sort(regions.begin(), regions.end(),
+		          [](const AddressRegion &a, const AddressRegion &b) {
+			          return a.start < b.start;
+		          });
+	};
+
+	// SectionInfo::containsMemAddress includes the end address
+	auto paintSection = [&paint](const SectionInfo &info,
+	                             ElfKernelspaceLoader *loader,
+	                             AddressKind kind) {
+		uint64_t start = info.memindex | 0xffff000000000000;
+		paint(start, start + info.size + 1, loader, kind);
+	};
+
+	paintSection(this->textSegment, this, AddressKind::CODE);
+
+	// ElfFile64::isDataAddress uses the first section containing the
+	// address, executable ones block the range.
+	for (uint32_t i = 0; i < this->elffile->getNrOfSections(); i++) {
+		const SectionInfo &info = this->elffile->findSectionByID(i);
+		if (!CHECKFLAGS(info.flags, SHF_ALLOC) || info.size == 0) {
+			continue;
+		}
+		AddressKind kind = CHECKFLAGS(info.flags, SHF_EXECINSTR) ?
+		                   AddressKind::NONE : AddressKind::DATA;
+		paint(info.memindex, info.memindex + info.size, this, kind);
+	}
+
+	this->moduleMapMutex.lock();
+	for (auto &modulePair : this->moduleMap) {
+		ElfKernelspaceLoader *module = dynamic_cast<ElfKernelspaceLoader*>(modulePair.second);
+		if (!module) {
+			continue;
+		}
+		paintSection(module->textSegment, module, AddressKind::CODE);
+		paintSection(module->dataSection, module, AddressKind::DATA);
+		paintSection(module->bssSection, module, AddressKind::DATA);
+	}
+	this->indexedModules = this->moduleMap.size();
+	this->moduleMapMutex.unlock();
+
+	regions.erase(std::remove_if(regions.begin(), regions.end(),
+	                             [](const AddressRegion &region) {
+		                             return region.kind == AddressKind::NONE;
+	                             }),
+	              regions.end());
+	this->addressIndex = std::move(regions);
+}
+
+const ElfKernelLoader::AddressRegion *
+ElfKernelLoader::findAddressRegion(uint64_t address) const {
+	address = address | 0xffff000000000000;
+
+	auto region = std::upper_bound(this->addressIndex.begin(),
+	                               this->addressIndex.end(), address,
+	                               [](uint64_t value, const AddressRegion &r) {
+		                               return value < r.start;
+	                               });
+	if (region == this->addressIndex.begin()) {
+		return nullptr;
+	}
+	region--;
+	if (address >= region->end) {
+		return nullptr;
+	}
+	return &*region;
+}
+
 ElfKernelspaceLoader* ElfKernelLoader::getModuleForCodeAddress(uint64_t address) {
+	if (!this->addressIndex.empty() &&
+	    this->indexedModules == this->moduleMap.size()) {
+		const AddressRegion *region = this->findAddressRegion(address);
+		if (region && region->kind == AddressKind::CODE) {
+			return region->loader;
+		}
+		return nullptr;
+	}
+
 	// Does the address belong to the kernel?
 	if (this->isCodeAddress(address)) {
 		return this;
@@ -146,9 +308,36 @@ ElfKernelspaceLoader* ElfKernelLoader::getModuleForCodeAddress(uint64_t address)
 	return nullptr;
 }
 
-ElfKernelspaceLoader* ElfKernelLoader::getModuleForAddress(uint64_t address) {
+ElfKernelspaceLoader* ElfKernelLoader::getModuleForAddress(uint64_t address,
+                                                           AddressKind *kind) {
+	// Fall back to the slow path while the index is not up to date
+	if (this->addressIndex.empty() ||
+	    this->indexedModules != this->moduleMap.size()) {
+		return this->getModuleForAddressLinear(address, kind);
+	}
+
+	const AddressRegion *region = this->findAddressRegion(address);
+	if (kind) {
+		*kind = region ? region->kind : AddressKind::NONE;
+	}
+	return region ? region->loader : nullptr;
+}
+
+ElfKernelspaceLoader* ElfKernelLoader::getModuleForAddressLinear(uint64_t address,
+                                                                 AddressKind *kind) {
+	AddressKind dummy;
+	if (!kind) {
+		kind = &dummy;
+	}
+	*kind = AddressKind::NONE;
+
 	// Does the address belong to the kernel?
-	if (this->isCodeAddress(address) || this->isDataAddress(address)) {
+	if (this->isCodeAddress(address)) {
+		*kind = AddressKind::CODE;
+		return this;
+	}
+	if (this->isDataAddress(address)) {
+		*kind = AddressKind::DATA;
 		return this;
 	}
 
@@ -156,7 +345,12 @@ ElfKernelspaceLoader* ElfKernelLoader::getModuleForAddress(uint64_t address) {
 		assert(modulePair.second);
 		ElfKernelspaceLoader *module = dynamic_cast<ElfKernelspaceLoader*>(modulePair.second);
 		assert(module);
-		if (module->isCodeAddress(address) || module->isDataAddress(address)) {
+		if (module->isCodeAddress(address)) {
+			*kind = AddressKind::CODE;
+			return module;
+		}
+		if (module->isDataAddress(address)) {
+			*kind = AddressKind::DATA;
 			return module;
 		}
 	}
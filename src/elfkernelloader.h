@@ -14,13 +14,39 @@ public:
 	ElfKernelLoader(ElfFile *elffile);
 	virtual ~ElfKernelLoader();
 
-	ElfKernelspaceLoader *getModuleForAddress(uint64_t address);
+	enum class AddressKind : uint8_t { NONE, CODE, DATA };
+
+	/**
+	 * An address range of the kernel or a module,
+	 * the end address is exclusive.
+	 */
+	struct AddressRegion {
+		uint64_t start;
+		uint64_t end;
+		ElfKernelspaceLoader *loader;
+		AddressKind kind;
+	};
+
+	/**
+	 * Build the address lookup table from the kernel and all modules
+	 * loaded so far. Call again after loading further modules.
+	 */
+	void updateAddressIndex();
+
+	ElfKernelspaceLoader *getModuleForAddress(uint64_t address,
+	                                          AddressKind *kind=nullptr);
 	ElfKernelspaceLoader *getModuleForCodeAddress(uint64_t address);
 
 	const std::string &getName() const override;
 	Kernel *getKernel() override;
 
 	bool isDataAddress(uint64_t addr) override;
+
+	/**
+	 * Patch the reference image, or load it from the image cache in
+	 * the cache directory if that matches this kernel.
+	 */
+	void initImage() override;
 protected:
 	std::string name;
 
@@ -42,6 +68,23 @@ protected:
 	void initText() override;
 	void initData() override;
 
+	/** The parts of initText()/initData() that are not cached */
+	void initTextSections();
+	void initDataSections();
+
+	/** Build, files and guest CPU state the patched image depends on */
+	std::string imageCacheKey();
+
+private:
+	/** Sorted, non overlapping code and data ranges */
+	std::vector<AddressRegion> addressIndex;
+	/** Number of modules contained in the addressIndex */
+	size_t indexedModules;
+
+	const AddressRegion *findAddressRegion(uint64_t address) const;
+
+	ElfKernelspaceLoader *getModuleForAddressLinear(uint64_t address,
+	                                                AddressKind *kind);
 };
 
 } // namespace kernint
@@ -1,9 +1,11 @@
 #include "elfkernelspaceloader.h"
 
+#include <algorithm>
 #include <cassert>
 #include <cstring>
 #include <fstream>
 #include <iostream>
+#include <sstream>
 #include <typeinfo>
 
 #include "elfkernelloader.h"
@@ -11,6 +13,7 @@
 #include "exceptions.h"
 #include "helpers.h"
 #include "kernel_headers.h"
+#include "metrics.h"
 #include "libdwarfparser/libdwarfparser.h"
 #include "libvmiwrapper/libvmiwrapper.h"
 
@@ -22,24 +25,197 @@ ElfKernelspaceLoader::ElfKernelspaceLoader(ElfFile *elffile, ParavirtState *pvst
 	ElfLoader(elffile),
 	pvpatcher{pvstate} {}
 
+const std::vector<uint64_t> &ElfKernelspaceLoader::getTextDigests() const {
+	return this->textDigests;
+}
+
+std::string ElfKernelspaceLoader::patchStateKey() {
+	Kernel *kernel = this->getKernel();
+	std::stringstream key;
+
+	Variable *bootCpuData = kernel->symbols.findVariableByName("boot_cpu_data");
+	assert(bootCpuData);
+	Instance x86_capability =
+		bootCpuData->getInstance().memberByName("x86_capability");
+	key << std::hex;
+	for (uint8_t i = 0; i < 10; i++) {
+		key << x86_capability.arrayElem(i).getRawValue<uint32_t>(false) << " ";
+	}
+
+	const unsigned char *nops = kernel->getParavirtState()->ideal_nops[8];
+	for (uint8_t i = 0; i < 8; i++) {
+		key << (uint32_t)nops[i];
+	}
+	return key.str();
+}
+
+void ElfKernelspaceLoader::computeTextDigests() {
+	// The text image is padded to a full page, so every entry
+	// covers exactly digestPageSize bytes.
+	size_t pageCount = this->textSegmentContent.size() / digestPageSize;
+
+	this->textDigests.clear();
+	this->textDigests.reserve(pageCount);
+	for (size_t i = 0; i < pageCount; i++) {
+		this->textDigests.push_back(
+			hashPageKeyed(this->textSegmentContent.data() + i * digestPageSize,
+			              digestPageSize));
+	}
+}
+
+void ElfKernelspaceLoader::finalizeText() {
+	this->computeTextDigests();
+
+	// Build the patch site index. Sites outside of the loaded text
+	// image (e.g. in .init.text) are dropped.
+	size_t textSize = this->textSegmentContent.size();
+	this->patchSites.erase(
+		std::remove_if(this->patchSites.begin(), this->patchSites.end(),
+		               [textSize](const PatchSite &s) {
+			               return (uint64_t)s.offset + s.length > textSize;
+		               }),
+		this->patchSites.end());
+	std::sort(this->patchSites.begin(), this->patchSites.end(),
+	          [](const PatchSite &a, const PatchSite &b) {
+		          return a.offset < b.offset;
+	          });
+
+	this->patchSiteMask.assign((textSize + 63) / 64, 0);
+	for (auto &&site : this->patchSites) {
+		for (uint64_t i = site.offset; i < site.offset + site.length; i++) {
+			this->patchSiteMask[i / 64] |= 1ULL << (i % 64);
+		}
+	}
+
+	size_t pageCount = textSize / digestPageSize;
+	this->patchSitePages.assign(pageCount + 1, this->patchSites.size());
+	size_t site = 0;
+	for (size_t page = 0; page < pageCount; page++) {
+		uint64_t pageStart = page * digestPageSize;
+		while (site < this->patchSites.size() &&
+		       this->patchSites[site].offset +
+		       this->patchSites[site].length <= pageStart) {
+			site++;
+		}
+		this->patchSitePages[page] = site;
+	}
+
+	this->buildReturnSites();
+}
+
+void ElfKernelspaceLoader::buildReturnSites() {
+	// The text image does not change after patching, so the result of
+	// isReturnAddress() is computed once for every offset. A linear
+	// sweep would miss calls that only decode from another start, e.g.
+	// after data in the text, and report their returns as malicious.
+	size_t textSize = this->textSegmentContent.size();
+	uint64_t textStart = this->textSegment.memindex;
+
+	this->returnSiteMask.assign((textSize + 63) / 64, 0);
+	this->returnSiteCalls.clear();
+
+	findReturnSites(this->textSegmentContent.data(), textSize, textStart,
+	                [&](uint64_t offset, uint64_t destination) {
+		                // Sites are found in ascending order
+		                this->returnSiteMask[offset / 64] |= 1ULL << (offset % 64);
+		                this->returnSiteCalls.push_back(destination);
+	                });
+
+	this->returnSiteRank.resize(this->returnSiteMask.size());
+	uint32_t rank = 0;
+	for (size_t i = 0; i < this->returnSiteMask.size(); i++) {
+		this->returnSiteRank[i] = rank;
+		rank += __builtin_popcountll(this->returnSiteMask[i]);
+	}
+}
+
+void ElfKernelspaceLoader::addPatchSite(uint64_t offset, uint8_t length,
+                                        PatchSite::Type type,
+                                        int32_t destination) {
+	if (offset > UINT32_MAX) {
+		// Not part of the text image
+		return;
+	}
+	this->patchSites.push_back({(uint32_t)offset, length, type, destination});
+}
+
+const ElfKernelspaceLoader::PatchSite *
+ElfKernelspaceLoader::findPatchSite(uint64_t offset) const {
+	if (offset / 64 >= this->patchSiteMask.size() ||
+	    !(this->patchSiteMask[offset / 64] & (1ULL << (offset % 64)))) {
+		return nullptr;
+	}
+
+	// Only the few sites of the corresponding page have to be searched
+	uint64_t page = offset / digestPageSize;
+	auto first = this->patchSites.begin() + this->patchSitePages[page];
+	auto last  = this->patchSites.begin() + this->patchSitePages[page + 1];
+	if (last != this->patchSites.end()) {
+		// Sites starting in this page but reaching into the next one
+		last++;
+	}
+
+	auto site = std::upper_bound(first, last, offset,
+	                             [](uint64_t value, const PatchSite &s) {
+		                             return value < s.offset;
+	                             });
+	while (site != first) {
+		site--;
+		if (offset >= site->offset && offset < site->offset + site->length) {
+			return &*site;
+		}
+	}
+	return nullptr;
+}
+
+bool ElfKernelspaceLoader::isValidPatchSite(const PatchSite *site,
+                                            const uint8_t *memory) const {
+	const unsigned char *const *nops = this->pvpatcher.pvstate->ideal_nops;
+
+	switch (site->type) {
+	case PatchSite::SMP_LOCK:
+		return memory[0] == (uint8_t)0xf0 || memory[0] == (uint8_t)0x3e;
+
+	case PatchSite::JUMP_LABEL: {
+		// Disabled or enabled with the correct destination
+		if (memcmp(memory, nops[5], 5) == 0 ||
+		    memcmp(memory, nops[9], 5) == 0) {
+			return true;
+		}
+		int32_t destination = 0;
+		memcpy(&destination, memory + 1, 4);
+		return memory[0] == (uint8_t)0xe9 &&
+		       destination == site->destination;
+	}
+
+	case PatchSite::MCOUNT:
+		return memcmp(memory, nops[5], 5) == 0 ||
+		       memcmp(memory, nops[9], 5) == 0 ||
+		       memcmp(memory, "\x66\x66\x66\x66\x90", 5) == 0;
+	}
+	return false;
+}
+
 
 void ElfKernelspaceLoader::applyMcount(const SectionInfo &info,
                                        ParavirtPatcher *patcher) {
+	ScopedTimer timer{Metrics::PATCHING};
+
 	// See ftrace_init_module in kernel/trace/ftrace.c
 
 	uint64_t *mcountStart = reinterpret_cast<uint64_t *>(info.index);
 	uint64_t *mcountStop  = reinterpret_cast<uint64_t *>(info.index + info.size);
 
 	for (uint64_t *i = mcountStart; i < mcountStop; i++) {
+		uint64_t offset = (uint64_t)(*i) - (uint64_t) this->textSegment.memindex;
 		patcher->add_nops(
-			(void *)(this->textSegmentContent.data() +
-			         ((uint64_t)(*i) -
-			          (uint64_t) this->textSegment.memindex)),
-			5);
+			(void *)(this->textSegmentContent.data() + offset), 5);
+		this->addPatchSite(offset, 5, PatchSite::MCOUNT);
 	}
 }
 
 void ElfKernelspaceLoader::applyAltinstr(ParavirtPatcher *patcher) {
+	ScopedTimer timer{Metrics::PATCHING};
 	uint64_t count     = 0;
 	uint64_t count_all = 0;
 	uint8_t *instr;
@@ -114,6 +290,7 @@ void ElfKernelspaceLoader::applyAltinstr(ParavirtPatcher *patcher) {
 
 
 void ElfKernelspaceLoader::applySmpLocks() {
+	ScopedTimer timer{Metrics::PATCHING};
 	SectionInfo info = this->elffile->findSectionWithName(".smp_locks");
 	if (!info.index)
 		return;
@@ -160,6 +337,9 @@ void ElfKernelspaceLoader::applySmpLocks() {
 			if (addSmpEntries) {
 				this->smpOffsets.insert((uint64_t)ptr -
 				                        (uint64_t)this->textSegment.index);
+				this->addPatchSite((uint64_t)ptr -
+				                   (uint64_t)this->textSegment.index,
+				                   1, PatchSite::SMP_LOCK);
 			}
 		}
 	}
@@ -169,6 +349,7 @@ void ElfKernelspaceLoader::applySmpLocks() {
 void ElfKernelspaceLoader::applyJumpEntries(uint64_t jumpStart,
                                             uint32_t numberOfEntries,
                                             ParavirtPatcher *patcher) {
+	ScopedTimer timer{Metrics::PATCHING};
 	uint64_t count = 0;
 	// Apply the jump tables after the segments are adjacent
 	// jump_label_apply_nops() =>
@@ -227,6 +408,8 @@ void ElfKernelspaceLoader::applyJumpEntries(uint64_t jumpStart,
 					this->jumpEntries.insert(
 						std::pair<uint64_t, int32_t>(entry->code, destination));
 					this->jumpDestinations.insert(entry->target);
+					this->addPatchSite(patchOffset, 5,
+					                   PatchSite::JUMP_LABEL, destination);
 				}
 
 				if (enabled) {
@@ -9,11 +9,80 @@ namespace kernint {
 
 class ElfKernelspaceLoader : public ElfLoader {
 	friend class KernelValidator;
+	friend class ImageCache;
 public:
 	ElfKernelspaceLoader(ElfFile *elffile, ParavirtState *pvstate);
 	virtual ~ElfKernelspaceLoader() = default;
 
+	/** Granularity of the text digest table */
+	static constexpr uint32_t digestPageSize = 0x1000;
+
+	/**
+	 * Digests of the fully patched text image, one entry per
+	 * digestPageSize bytes, see hashPageKeyed(). The key changes with
+	 * every run, so they are not part of the image cache.
+	 */
+	const std::vector<uint64_t> &getTextDigests() const;
+
+	/**
+	 * A location in the text image that is legitimately patched at
+	 * runtime and may thus differ from the reference.
+	 */
+	struct PatchSite {
+		enum Type : uint8_t {
+			SMP_LOCK,   // lock prefix, 0xf0 or 0x3e
+			JUMP_LABEL, // nop or jmp to the stored destination
+			MCOUNT,     // ftrace call site, some 5 byte nop
+		};
+
+		uint32_t offset;      // offset in the text image
+		uint8_t length;
+		Type type;
+		int32_t destination;  // relative jump of JUMP_LABEL sites
+	};
+
+	/**
+	 * Return the patch site covering the given text image offset,
+	 * nullptr if the byte must match the reference.
+	 */
+	const PatchSite *findPatchSite(uint64_t offset) const;
+
+	/**
+	 * Check if the memory content at a patch site is one of the
+	 * accepted variants. memory points to the first byte of the site.
+	 */
+	bool isValidPatchSite(const PatchSite *site, const uint8_t *memory) const;
+
+	/**
+	 * Check if the text image offset directly follows a call instruction.
+	 * Returns the destination of a direct call, 1 for an indirect call
+	 * and 0 if the offset is no return site.
+	 */
+	inline uint64_t isReturnAddress(uint64_t offset) const {
+		if (offset / 64 >= this->returnSiteMask.size()) {
+			return 0;
+		}
+		uint64_t word = this->returnSiteMask[offset / 64];
+		uint64_t bit  = 1ULL << (offset % 64);
+		if (!(word & bit)) {
+			return 0;
+		}
+		// Index of the site: sites in previous words plus lower bits
+		uint32_t site = this->returnSiteRank[offset / 64] +
+		                __builtin_popcountll(word & (bit - 1));
+		return this->returnSiteCalls[site];
+	}
+
 protected:
+	/**
+	 * Derive lookup tables from the final text image.
+	 * Must be called once textSegmentContent is fully patched.
+	 */
+	void finalizeText();
+
+	/** Compute textDigests from the final text image */
+	void computeTextDigests();
+
 	void applyMcount(const SectionInfo &info, ParavirtPatcher *patcher);
 	void applyAltinstr(ParavirtPatcher *patcher);
 	void applySmpLocks();
@@ -24,6 +93,32 @@ protected:
 	std::map<uint64_t, int32_t> jumpEntries;
 	std::set<uint64_t> jumpDestinations;
 	std::set<uint64_t> smpOffsets;
+	std::vector<uint64_t> textDigests;
+
+	void addPatchSite(uint64_t offset, uint8_t length,
+	                  PatchSite::Type type, int32_t destination=0);
+
+	/** Patch sites sorted by offset, built during patching */
+	std::vector<PatchSite> patchSites;
+	/** Index of the first site reaching into each digest page */
+	std::vector<uint32_t> patchSitePages;
+	/** One bit per byte of the text image, set if covered by a site */
+	std::vector<uint64_t> patchSiteMask;
+
+	/** One bit per byte of the text image, set if it follows a call */
+	std::vector<uint64_t> returnSiteMask;
+	/** Number of return sites before each word of the returnSiteMask */
+	std::vector<uint32_t> returnSiteRank;
+	/** Result of isReturnAddress() for each return site in order */
+	std::vector<uint64_t> returnSiteCalls;
+
+	void buildReturnSites();
+
+	/**
+	 * Guest CPU state the alternatives and paravirt patching depend
+	 * on, part of the image cache key.
+	 */
+	std::string patchStateKey();
 
 	ParavirtPatcher pvpatcher;
 };
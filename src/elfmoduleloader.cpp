@@ -1,9 +1,12 @@
 #include "elfmoduleloader.h"
 
 #include <cassert>
+#include <sstream>
+#include <sys/stat.h>
 
 #include "exceptions.h"
 #include "helpers.h"
+#include "imagecache.h"
 
 
 namespace kernint {
@@ -63,13 +66,93 @@ void ElfModuleLoader::loadDependencies() {
 	}
 }
 
-void ElfModuleLoader::initText(void) {
-	// std::cout << COLOR_GREEN
-	//             "Loading dependencies for module " << this->modName;
-	// std::cout << COLOR_NORM << std::endl;
-
+void ElfModuleLoader::initImage() {
+	// The external symbols are resolved from the dependencies,
+	// they are needed for the cache key as well
 	this->loadDependencies();
 
+	if (this->kernel->getCacheDir().empty()) {
+		ElfLoader::initImage();
+		return;
+	}
+
+	std::string layout;
+	std::string key = this->imageCacheKey(&layout);
+	ImageCache cache{ImageCache::path(this->kernel->getCacheDir(),
+	                                  this->modName,
+	                                  this->elffile->getBuildID()),
+	                 key, layout};
+
+	if (!cache.load(this)) {
+		ElfLoader::initImage();
+		if (!cache.store(this)) {
+			std::cout << "Could not write image cache "
+			          << cache.getFileName() << std::endl;
+		}
+		return;
+	}
+
+	std::cout << COLOR_GREEN "Loading cached module " << this->modName;
+	std::cout << COLOR_NORM << std::endl;
+
+	this->textSegment = this->elffile->findSectionWithName(".text");
+	this->updateSectionInfoMemAddress(this->textSegment);
+	this->elffile->addSymbolsToStore(&this->kernel->symbols,
+	                                 (uint64_t)this->textSegment.memindex);
+	this->initDataSections();
+	this->roDataSection.size = this->roData.size();
+}
+
+std::string ElfModuleLoader::imageCacheKey(std::string *layout) {
+	std::stringstream layoutStream;
+	layoutStream << std::hex << this->patchStateKey();
+
+	// Where the sections of the module were loaded to,
+	// see findMemAddressOfSegment()
+	Instance module = this->kernel->getKernelModuleInstance(this->modName);
+	layoutStream << " " << module.getAddress() << " " << module.size()
+	             << " " << module.memberByName("percpu").getRawValue<uint64_t>(false)
+	             << " " << module.memberByName("gpl_syms").getRawValue<uint64_t>();
+
+	Instance attrs    = module.memberByName("sect_attrs", true);
+	uint32_t attr_cnt = attrs.memberByName("nsections").getValue<uint64_t>();
+	for (uint32_t i = 0; i < attr_cnt; i++) {
+		Instance attr = attrs.memberByName("attrs").arrayElem(i);
+		layoutStream << " " << attr.memberByName("name", true).getValue<std::string>()
+		             << "=" << attr.memberByName("address").getValue<uint64_t>();
+	}
+
+	// The addresses of the external symbols written by the relocation
+	ElfFile64 *elf64      = dynamic_cast<ElfFile64 *>(this->elffile);
+	Elf64_Shdr *elf64Shdr = elf64->elf64Shdr;
+	for (unsigned int i = 0; i < elf64->elf64Ehdr->e_shnum; i++) {
+		if (elf64Shdr[i].sh_type != SHT_SYMTAB) {
+			continue;
+		}
+		Elf64_Sym *sym    = (Elf64_Sym *)this->elffile->sectionAddress(i);
+		Elf64_Sym *symEnd = sym + elf64Shdr[i].sh_size / sizeof(*sym);
+		for (; sym < symEnd; sym++) {
+			if (sym->st_shndx != SHN_UNDEF || !sym->st_name) {
+				continue;
+			}
+			std::string name = this->elffile->symbolName(sym->st_name,
+			                                             elf64Shdr[i].sh_link);
+			layoutStream << " " << name << "="
+			             << this->kernel->symbols.getSymbolAddress(name);
+		}
+	}
+
+	std::stringstream key;
+	key << this->elffile->getBuildID();
+	struct stat fileStat;
+	if (stat(this->elffile->getFilename().c_str(), &fileStat) == 0) {
+		key << " " << fileStat.st_size << ":" << fileStat.st_mtime;
+	}
+	*layout = layoutStream.str();
+	return key.str();
+}
+
+void ElfModuleLoader::initText(void) {
 	std::cout << COLOR_GREEN "Loading module " << this->modName;
 	std::cout << COLOR_NORM << std::endl;
 
@@ -125,15 +208,21 @@ void ElfModuleLoader::initText(void) {
 	// Initialize the symTable in the context for later reference
 	this->elffile->addSymbolsToStore(&this->kernel->symbols,
 	                                 (uint64_t)this->textSegment.memindex);
+
+	this->finalizeText();
 }
 
-void ElfModuleLoader::initData(void) {
+void ElfModuleLoader::initDataSections() {
 	this->dataSection = this->elffile->findSectionWithName(".data");
 	this->updateSectionInfoMemAddress(this->dataSection);
 	this->bssSection = elffile->findSectionWithName(".bss");
 	this->updateSectionInfoMemAddress(this->bssSection);
 	this->roDataSection = elffile->findSectionWithName(".note.gnu.build-id");
 	this->updateSectionInfoMemAddress(this->roDataSection);
+}
+
+void ElfModuleLoader::initData(void) {
+	this->initDataSections();
 
 	// initialize roData Segment
 	ElfFile64 *elf64      = dynamic_cast<ElfFile64 *>(this->elffile);
@@ -16,6 +16,13 @@ public:
 	const std::string &getName() const override;
 	Kernel *getKernel() override;
 
+	/**
+	 * Relocate and patch the reference image, or load it from the
+	 * image cache in the cache directory if that matches the loaded
+	 * module.
+	 */
+	void initImage() override;
+
 protected:
 	void updateSectionInfoMemAddress(SectionInfo &info) override;
 	uint64_t findMemAddressOfSegment(SectionInfo &info);
@@ -23,6 +30,16 @@ protected:
 	void initText() override;
 	void initData() override;
 
+	/** The part of initData() that is not cached */
+	void initDataSections();
+
+	/**
+	 * Build and file the relocated image depends on. The load
+	 * addresses, resolved external symbols and guest CPU state are
+	 * written to layout.
+	 */
+	std::string imageCacheKey(std::string *layout);
+
 	void loadDependencies();
 
 	bool isDataAddress(uint64_t addr) override;
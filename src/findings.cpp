@@ -0,0 +1,365 @@
+#include "findings.h"
+
+#include <cstdio>
+#include <cstring>
+
+#include "helpers.h"
+#include "reporter.h"
+
+namespace kernint {
+
+const char *Finding::kindName(Kind kind) {
+	switch (kind) {
+	case Kind::NO_MODULE:        return "no_module";
+	case Kind::EXECUTABLE_DATA:  return "executable_data";
+	case Kind::CODE_CHANGE:      return "code_change";
+	case Kind::UNKNOWN_CODE:     return "unknown_code";
+	case Kind::IDT_ENTRY:        return "idt_entry";
+	case Kind::RODATA_CHANGE:    return "rodata_change";
+	case Kind::CODE_POINTER:     return "code_pointer";
+	case Kind::RETURN_ADDRESS:   return "return_address";
+	case Kind::UNDECIDABLE_PAGE: return "undecidable_page";
+	case Kind::UNMAPPED_PAGE:    return "unmapped_page";
+	case Kind::UNKNOWN_LIBRARY:  return "unknown_library";
+	case Kind::UNREADABLE_PAGE:  return "unreadable_page";
+	}
+	return "unknown";
+}
+
+const char *Finding::severityName(Severity severity) {
+	switch (severity) {
+	case Severity::INFO:    return "info";
+	case Severity::WARNING: return "warning";
+	case Severity::ALERT:   return "alert";
+	}
+	return "unknown";
+}
+
+const char *Summary::scopeName(Scope scope) {
+	switch (scope) {
+	case Scope::PROCESS: return "process";
+	case Scope::SEGMENT: return "segment";
+	case Scope::MAPPING: return "mapping";
+	}
+	return "unknown";
+}
+
+static std::unique_ptr<FindingWriter> currentWriter{new TextWriter()};
+
+std::unique_ptr<FindingWriter> FindingWriter::create(const std::string &name) {
+	if (name == "text") {
+		return std::unique_ptr<FindingWriter>{new TextWriter()};
+	} else if (name == "json") {
+		return std::unique_ptr<FindingWriter>{new JsonLinesWriter()};
+	} else if (name == "csv") {
+		return std::unique_ptr<FindingWriter>{new CsvWriter()};
+	} else if (name == "binary") {
+		return std::unique_ptr<FindingWriter>{new BinaryWriter()};
+	}
+	return nullptr;
+}
+
+void FindingWriter::set(std::unique_ptr<FindingWriter> writer) {
+	Reporter &reporter = Reporter::get();
+	reporter.flush();
+	currentWriter = std::move(writer);
+	reporter.setTextOutput(currentWriter->isText());
+
+	std::string header = currentWriter->header();
+	if (!header.empty()) {
+		reporter.write(std::move(header));
+	}
+}
+
+const FindingWriter &FindingWriter::get() {
+	return *currentWriter;
+}
+
+static void appendHex(uint64_t value, std::string *out) {
+	char buffer[24];
+	snprintf(buffer, sizeof(buffer), "0x%lx", value);
+	out->append(buffer);
+}
+
+// TextWriter
+
+void TextWriter::format(const Finding &finding, std::string *out) const {
+	switch (finding.severity) {
+	case Finding::Severity::INFO:
+		out->append(COLOR_BLUE COLOR_BOLD);
+		break;
+	case Finding::Severity::WARNING:
+		out->append(COLOR_MARGENTA COLOR_BOLD);
+		break;
+	case Finding::Severity::ALERT:
+		out->append(COLOR_RED COLOR_BOLD);
+		break;
+	}
+	out->append(finding.message);
+	out->append(COLOR_NORM COLOR_BOLD_OFF "\n");
+	out->append(finding.detail);
+}
+
+void TextWriter::format(const Summary &summary, std::string *out) const {
+	switch (summary.scope) {
+	case Summary::Scope::PROCESS:
+		out->append("Process summary");
+		break;
+	case Summary::Scope::SEGMENT:
+		out->append("Segment summary");
+		break;
+	case Summary::Scope::MAPPING:
+		out->append("Mapping summary");
+		break;
+	}
+	out->append(";" + std::to_string(summary.pid));
+	out->append(";" + summary.name);
+	if (summary.scope != Summary::Scope::PROCESS) {
+		out->append(";" + summary.from);
+	}
+	if (summary.scope == Summary::Scope::MAPPING) {
+		out->append(";" + summary.to);
+	}
+	if (summary.scope != Summary::Scope::PROCESS) {
+		out->append(";" + std::to_string(summary.symbols));
+	}
+
+	for (auto &counter : summary.counters) {
+		out->append(";" + std::to_string(counter.value));
+		if (counter.split) {
+			out->append(" (" + std::to_string(counter.pie) +
+			            " / " + std::to_string(counter.notPie) + ")");
+		}
+	}
+	out->push_back('\n');
+}
+
+// JsonLinesWriter
+
+static void appendJsonString(const std::string &value, std::string *out) {
+	out->push_back('"');
+	for (char c : value) {
+		switch (c) {
+		case '"':  out->append("\\\""); break;
+		case '\\': out->append("\\\\"); break;
+		case '\n': out->append("\\n");  break;
+		case '\t': out->append("\\t");  break;
+		default:
+			if ((unsigned char)c < 0x20) {
+				char buffer[8];
+				snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+				out->append(buffer);
+			} else {
+				out->push_back(c);
+			}
+		}
+	}
+	out->push_back('"');
+}
+
+void JsonLinesWriter::format(const Finding &finding, std::string *out) const {
+	// Addresses do not fit into the doubles of most JSON parsers
+	out->append("{\"record\":\"finding\",\"kind\":\"");
+	out->append(Finding::kindName(finding.kind));
+	out->append("\",\"severity\":\"");
+	out->append(Finding::severityName(finding.severity));
+	out->append("\",\"pid\":" + std::to_string(finding.pid));
+	out->append(",\"address\":\"");
+	appendHex(finding.address, out);
+	out->append("\",\"value\":\"");
+	appendHex(finding.value, out);
+	out->append("\",\"module\":");
+	appendJsonString(finding.module, out);
+	out->append(",\"message\":");
+	appendJsonString(finding.message, out);
+	out->append(",\"detail\":");
+	appendJsonString(finding.detail, out);
+	out->append("}\n");
+}
+
+void JsonLinesWriter::format(const Summary &summary, std::string *out) const {
+	out->append("{\"record\":\"summary\",\"scope\":\"");
+	out->append(Summary::scopeName(summary.scope));
+	out->append("\",\"pid\":" + std::to_string(summary.pid));
+	out->append(",\"name\":");
+	appendJsonString(summary.name, out);
+	out->append(",\"from\":");
+	appendJsonString(summary.from, out);
+	out->append(",\"to\":");
+	appendJsonString(summary.to, out);
+	out->append(",\"symbols\":" + std::to_string(summary.symbols));
+	out->append(",\"counters\":{");
+	bool first = true;
+	for (auto &counter : summary.counters) {
+		if (!first) {
+			out->push_back(',');
+		}
+		first = false;
+		out->append("\"" + std::string(counter.name) + "\":");
+		if (counter.split) {
+			out->append("{\"total\":" + std::to_string(counter.value) +
+			            ",\"pie\":" + std::to_string(counter.pie) +
+			            ",\"not_pie\":" + std::to_string(counter.notPie) + "}");
+		} else {
+			out->append(std::to_string(counter.value));
+		}
+	}
+	out->append("}}\n");
+}
+
+// CsvWriter
+
+static void appendCsvField(const std::string &value, std::string *out) {
+	if (value.find_first_of(",\"\r\n") == std::string::npos) {
+		out->append(value);
+		return;
+	}
+	out->push_back('"');
+	for (char c : value) {
+		if (c == '"') {
+			out->push_back('"');
+		}
+		out->push_back(c);
+	}
+	out->push_back('"');
+}
+
+std::string CsvWriter::header() const {
+	return "record,kind,severity,pid,module,address,value,message,detail\r\n";
+}
+
+void CsvWriter::format(const Finding &finding, std::string *out) const {
+	out->append("finding,");
+	out->append(Finding::kindName(finding.kind));
+	out->push_back(',');
+	out->append(Finding::severityName(finding.severity));
+	out->append("," + std::to_string(finding.pid) + ",");
+	appendCsvField(finding.module, out);
+	out->push_back(',');
+	appendHex(finding.address, out);
+	out->push_back(',');
+	appendHex(finding.value, out);
+	out->push_back(',');
+	appendCsvField(finding.message, out);
+	out->push_back(',');
+	appendCsvField(finding.detail, out);
+	out->append("\r\n");
+}
+
+void CsvWriter::format(const Summary &summary, std::string *out) const {
+	// module holds the mappings, message the process name
+	std::string mappings = summary.from;
+	if (!summary.to.empty()) {
+		mappings += " -> " + summary.to;
+	}
+	std::string counters = "symbols=" + std::to_string(summary.symbols);
+	for (auto &counter : summary.counters) {
+		counters += " " + std::string(counter.name) + "=" +
+		            std::to_string(counter.value);
+		if (counter.split) {
+			counters += " " + std::string(counter.name) + "_pie=" +
+			            std::to_string(counter.pie);
+			counters += " " + std::string(counter.name) + "_not_pie=" +
+			            std::to_string(counter.notPie);
+		}
+	}
+
+	out->append("summary,");
+	out->append(Summary::scopeName(summary.scope));
+	out->append(",," + std::to_string(summary.pid) + ",");
+	appendCsvField(mappings, out);
+	out->append(",,,");
+	appendCsvField(summary.name, out);
+	out->push_back(',');
+	appendCsvField(counters, out);
+	out->append("\r\n");
+}
+
+// BinaryWriter
+
+template <typename T>
+static void appendValue(T value, std::string *out) {
+	out->append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+static void appendString(const std::string &value, std::string *out) {
+	appendValue<uint32_t>(value.size(), out);
+	out->append(value);
+}
+
+/** Reserve the length, returns its position for finishRecord */
+static size_t beginRecord(uint8_t type, std::string *out) {
+	size_t start = out->size();
+	appendValue<uint32_t>(0, out);
+	appendValue<uint8_t>(type, out);
+	return start;
+}
+
+static void finishRecord(size_t start, std::string *out) {
+	uint32_t length = out->size() - start - sizeof(uint32_t);
+	memcpy(&(*out)[start], &length, sizeof(length));
+}
+
+std::string BinaryWriter::header() const {
+	std::string out{"KIFINDNG"};
+	appendValue<uint32_t>(version, &out);
+	return out;
+}
+
+void BinaryWriter::format(const Finding &finding, std::string *out) const {
+	size_t start = beginRecord(1, out);
+	appendValue<uint8_t>((uint8_t)finding.kind, out);
+	appendValue<uint8_t>((uint8_t)finding.severity, out);
+	appendValue<int32_t>(finding.pid, out);
+	appendValue<uint64_t>(finding.address, out);
+	appendValue<uint64_t>(finding.value, out);
+	appendString(finding.module, out);
+	appendString(finding.message, out);
+	appendString(finding.detail, out);
+	finishRecord(start, out);
+}
+
+void BinaryWriter::format(const Summary &summary, std::string *out) const {
+	size_t start = beginRecord(2, out);
+	appendValue<uint8_t>((uint8_t)summary.scope, out);
+	appendValue<int32_t>(summary.pid, out);
+	appendValue<uint64_t>(summary.symbols, out);
+	appendString(summary.name, out);
+	appendString(summary.from, out);
+	appendString(summary.to, out);
+	appendValue<uint32_t>(summary.counters.size(), out);
+	for (auto &counter : summary.counters) {
+		appendString(counter.name, out);
+		appendValue<uint64_t>(counter.value, out);
+		appendValue<uint8_t>(counter.split, out);
+		appendValue<uint64_t>(counter.pie, out);
+		appendValue<uint64_t>(counter.notPie, out);
+	}
+	finishRecord(start, out);
+}
+
+void emit(const Finding &finding) {
+	std::string out;
+	FindingWriter::get().format(finding, &out);
+	Reporter::get().write(std::move(out));
+}
+
+void emit(const Summary &summary) {
+	std::string out;
+	FindingWriter::get().format(summary, &out);
+	Reporter::get().write(std::move(out));
+}
+
+void emit(const std::vector<Finding> &findings) {
+	if (findings.empty()) {
+		return;
+	}
+	std::string out;
+	const FindingWriter &writer = FindingWriter::get();
+	for (auto &finding : findings) {
+		writer.format(finding, &out);
+	}
+	Reporter::get().write(std::move(out));
+}
+
+} // namespace kernint
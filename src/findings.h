@@ -0,0 +1,189 @@
+#ifndef KERNINT_FINDINGS_H_
+#define KERNINT_FINDINGS_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace kernint {
+
+/**
+ * Something a validator noticed, e.g. a modified code page or a pointer
+ * that could not be explained. Validators only fill in the fields, the
+ * FindingWriter decides how it looks.
+ */
+struct Finding {
+	enum class Kind : uint8_t {
+		/** Executable page that belongs to no module */
+		NO_MODULE,
+		/** Data page that is executable */
+		EXECUTABLE_DATA,
+		/** Code differs from the reference image */
+		CODE_CHANGE,
+		/** Code behind the initialized part of a text segment */
+		UNKNOWN_CODE,
+		/** IDT entry that points to an unexpected location */
+		IDT_ENTRY,
+		/** Read only data differs from the reference image */
+		RODATA_CHANGE,
+		/** Pointer into code that could not be explained */
+		CODE_POINTER,
+		/** Pointer to a valid return site */
+		RETURN_ADDRESS,
+		/** Data page with undecidable pointers, value is their count */
+		UNDECIDABLE_PAGE,
+		/** Process page without a VMA */
+		UNMAPPED_PAGE,
+		/** Library mapped into a process that is not a dependency */
+		UNKNOWN_LIBRARY,
+		/** Kernel page that could not be read from the guest */
+		UNREADABLE_PAGE,
+	};
+
+	enum class Severity : uint8_t {
+		INFO,
+		WARNING,
+		ALERT,
+	};
+
+	Kind kind;
+	Severity severity;
+	/** Process the finding belongs to, -1 for the kernel */
+	int32_t pid = -1;
+	/** Guest virtual address where it was found */
+	uint64_t address = 0;
+	/** Pointer value, page index or count, depending on the kind */
+	uint64_t value = 0;
+	/** Module, library or mapping name */
+	std::string module;
+	/** One line description */
+	std::string message;
+	/** Further lines, e.g. a hexdump of the change */
+	std::string detail;
+
+	Finding(Kind kind, Severity severity) : kind{kind}, severity{severity} {}
+
+	static const char *kindName(Kind kind);
+	static const char *severityName(Severity severity);
+};
+
+/**
+ * Pointer statistics of a process, one of its segments or of the
+ * pointers from one mapping to another.
+ */
+struct Summary {
+	enum class Scope : uint8_t {
+		PROCESS,
+		SEGMENT,
+		MAPPING,
+	};
+
+	struct Counter {
+		const char *name;
+		uint64_t value;
+		/** value is also split into pointers to 0x7f.. (PIE) and others */
+		bool split;
+		uint64_t pie;
+		uint64_t notPie;
+	};
+
+	Scope scope;
+	int32_t pid = -1;
+	/** Process name */
+	std::string name;
+	/** Source mapping, empty for PROCESS */
+	std::string from;
+	/** Target mapping, only set for MAPPING */
+	std::string to;
+	/** Symbols of the loader, not used for PROCESS */
+	uint64_t symbols = 0;
+	std::vector<Counter> counters;
+
+	Summary(Scope scope) : scope{scope} {}
+
+	static const char *scopeName(Scope scope);
+};
+
+/**
+ * Serializes findings and summaries. All writers are stateless, so one
+ * writer can be shared by all validation threads.
+ */
+class FindingWriter {
+public:
+	virtual ~FindingWriter() = default;
+
+	/** Written once before the first record */
+	virtual std::string header() const { return ""; }
+	/** Append the serialized record to out */
+	virtual void format(const Finding &finding, std::string *out) const = 0;
+	virtual void format(const Summary &summary, std::string *out) const = 0;
+	/** Free text of report() is only wanted by human readable output */
+	virtual bool isText() const { return false; }
+
+	/** "text", "json", "csv" or "binary", nullptr if unknown */
+	static std::unique_ptr<FindingWriter> create(const std::string &name);
+
+	/** Use writer for all following emit() calls */
+	static void set(std::unique_ptr<FindingWriter> writer);
+	static const FindingWriter &get();
+};
+
+/** The look of the terminal output, with colors */
+class TextWriter : public FindingWriter {
+public:
+	void format(const Finding &finding, std::string *out) const override;
+	void format(const Summary &summary, std::string *out) const override;
+	bool isText() const override { return true; }
+};
+
+/** One JSON object per line */
+class JsonLinesWriter : public FindingWriter {
+public:
+	void format(const Finding &finding, std::string *out) const override;
+	void format(const Summary &summary, std::string *out) const override;
+};
+
+/**
+ * RFC 4180 CSV with a header line. Summaries use the same columns, their
+ * counters are put into the last column as "name=value" pairs.
+ */
+class CsvWriter : public FindingWriter {
+public:
+	std::string header() const override;
+	void format(const Finding &finding, std::string *out) const override;
+	void format(const Summary &summary, std::string *out) const override;
+};
+
+/**
+ * Length prefixed records in host byte order.
+ *
+ * The stream starts with the magic "KIFINDNG" and a uint32_t version.
+ * Every record is a uint32_t length of the rest of the record followed
+ * by a uint8_t type, 1 for a finding and 2 for a summary. Strings are
+ * stored as uint32_t length and the bytes.
+ *
+ *     finding: kind:u8 severity:u8 pid:i32 address:u64 value:u64
+ *              module:str message:str detail:str
+ *     summary: scope:u8 pid:i32 symbols:u64 name:str from:str to:str
+ *              count:u32 count * (name:str value:u64 split:u8
+ *                                 pie:u64 notPie:u64)
+ */
+class BinaryWriter : public FindingWriter {
+public:
+	static const uint32_t version = 1;
+
+	std::string header() const override;
+	void format(const Finding &finding, std::string *out) const override;
+	void format(const Summary &summary, std::string *out) const override;
+};
+
+/** Serialize with the current writer and queue for output */
+void emit(const Finding &finding);
+void emit(const Summary &summary);
+/** Serialize all findings in order into a single message */
+void emit(const std::vector<Finding> &findings);
+
+} // namespace kernint
+
+#endif
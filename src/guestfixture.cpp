@@ -0,0 +1,895 @@
+#include "guestfixture.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <deque>
+#include <elf.h>
+#include <fstream>
+#include <iostream>
+#include <libvmi/libvmi.h>
+#include <random>
+#include <set>
+#include <sstream>
+
+#include "elffile64.h"
+#include "elfkernelloader.h"
+#include "elfmoduleloader.h"
+#include "helpers.h"
+#include "libdwarfparser/libdwarfparser.h"
+
+namespace kernint {
+
+// Page table entry bits
+#define PTE_PRESENT  0x1ULL
+#define PTE_WRITE    0x2ULL
+#define PTE_USER     0x4ULL
+#define PTE_LARGE    0x80ULL
+#define PTE_NX       (1ULL << 63)
+#define PTE_ADDRESS  0x000ffffffffff000ULL
+
+// vm_flags of a VMA
+#define VM_READ      0x1ULL
+#define VM_WRITE     0x2ULL
+#define VM_EXEC      0x4ULL
+#define VM_MAYREAD   0x10ULL
+#define VM_MAYWRITE  0x20ULL
+#define VM_MAYEXEC   0x40ULL
+
+#define THREAD_SIZE  0x4000
+
+/** Where the first library is mapped, the others follow downwards */
+static const uint64_t libraryTop = 0x7ffff7fff000;
+/** Load address of position independent executables */
+static const uint64_t pieBase    = 0x555555554000;
+static const uint64_t stackStart = 0x7ffffffde000;
+static const uint64_t stackEnd   = 0x7ffffffff000;
+
+static const char *librarySearchPath[] = {
+	"/lib/x86_64-linux-gnu",
+	"/usr/lib/x86_64-linux-gnu",
+	"/lib64",
+	"/usr/lib64",
+	"/lib",
+	"/usr/lib",
+};
+
+static inline uint64_t alignUp(uint64_t value, uint64_t align) {
+	return (value + align - 1) & ~(align - 1);
+}
+
+static inline uint64_t alignDown(uint64_t value, uint64_t align) {
+	return value & ~(align - 1);
+}
+
+static std::string baseName(const std::string &path) {
+	size_t slash = path.rfind('/');
+	return (slash == std::string::npos) ? path : path.substr(slash + 1);
+}
+
+GuestFixture::GuestFixture(ElfKernelLoader *kernel,
+                           const std::string &kernelDir)
+	:
+	kernel{kernel},
+	kernelDir{kernelDir} {
+
+	// The kernel image is placed at its physical load address
+	uint64_t end = this->physical(this->symbol("_end"));
+	this->memory.resize(alignUp(end, largePageSize));
+
+	ElfFile64 *elf = dynamic_cast<ElfFile64 *>(this->kernel->elffile);
+	assert(elf);
+	uint8_t *fileContent = elf->getFileContent();
+	for (unsigned int i = 0; i < elf->elf64Ehdr->e_shnum; i++) {
+		Elf64_Shdr &shdr = elf->elf64Shdr[i];
+		if (!(shdr.sh_flags & SHF_ALLOC) || shdr.sh_type == SHT_NOBITS ||
+		    shdr.sh_addr < kernelMapStart) {
+			// .data..percpu is linked at 0
+			continue;
+		}
+		memcpy(&this->memory[shdr.sh_addr - kernelMapStart],
+		       fileContent + shdr.sh_offset, shdr.sh_size);
+	}
+
+	// The guest kernel patched its text while booting
+	const std::vector<uint8_t> &text = this->kernel->getTextSegment();
+	memcpy(&this->memory[this->physical(this->kernel->textSegment.memindex)],
+	       text.data(), text.size());
+
+	this->kernelPgd = this->physical(this->symbol("init_level4_pgt"));
+	memset(&this->memory[this->kernelPgd], 0, pageSize);
+	this->mapKernel();
+
+	// Empty task and module lists
+	this->taskList = this->symbol("init_task") + this->offset("task_struct", "tasks");
+	this->store<uint64_t>(this->taskList, this->taskList);
+	this->store<uint64_t>(this->taskList + 8, this->taskList);
+	this->moduleList = this->symbol("modules");
+	this->store<uint64_t>(this->moduleList, this->moduleList);
+	this->store<uint64_t>(this->moduleList + 8, this->moduleList);
+}
+
+uint64_t GuestFixture::offset(const std::string &type,
+                              const std::string &member) const {
+	const Structured *structured = dynamic_cast<const Structured *>(
+		this->kernel->symbols.findBaseTypeByName(type));
+	assert(structured);
+	return structured->memberOffset(member);
+}
+
+uint64_t GuestFixture::size(const std::string &type) const {
+	BaseType *bt = this->kernel->symbols.findBaseTypeByName(type);
+	assert(bt);
+	return bt->getByteSize();
+}
+
+uint64_t GuestFixture::symbol(const std::string &name) const {
+	uint64_t address = this->kernel->symbols.getSystemMapAddress(name, true);
+	assert(address);
+	return address;
+}
+
+uint64_t GuestFixture::allocate(uint64_t bytes, uint64_t align) {
+	uint64_t paddr = alignUp(this->memory.size(), align);
+	this->memory.resize(paddr + alignUp(bytes, 8));
+	return paddr;
+}
+
+uint64_t GuestFixture::allocateObject(uint64_t bytes) {
+	return directMapStart + this->allocate(bytes, 64);
+}
+
+uint64_t GuestFixture::allocateString(const std::string &value) {
+	uint64_t vaddr = this->allocateObject(value.size() + 1);
+	this->storeBytes(vaddr, value.c_str(), value.size() + 1);
+	return vaddr;
+}
+
+uint64_t GuestFixture::translate(uint64_t pgd, uint64_t vaddr) const {
+	uint64_t table = pgd;
+	for (int shift = 39; shift >= 12; shift -= 9) {
+		uint64_t entry;
+		memcpy(&entry, &this->memory[table + ((vaddr >> shift) & 0x1ff) * 8],
+		       sizeof(entry));
+		assert(entry & PTE_PRESENT);
+		if (shift == 12 || (entry & PTE_LARGE)) {
+			uint64_t mask = (1ULL << shift) - 1;
+			return (entry & PTE_ADDRESS & ~mask) | (vaddr & mask);
+		}
+		table = entry & PTE_ADDRESS;
+	}
+	return 0;
+}
+
+uint64_t GuestFixture::physical(uint64_t vaddr) const {
+	vaddr |= 0xffff000000000000;
+	if (vaddr >= moduleMapStart) {
+		return this->translate(this->kernelPgd, vaddr);
+	} else if (vaddr >= kernelMapStart) {
+		return vaddr - kernelMapStart;
+	}
+	assert(vaddr >= directMapStart);
+	return vaddr - directMapStart;
+}
+
+template <typename T>
+void GuestFixture::store(uint64_t vaddr, T value) {
+	this->storeBytes(vaddr, &value, sizeof(value));
+}
+
+void GuestFixture::storeBytes(uint64_t vaddr, const void *data,
+                              uint64_t length) {
+	uint64_t paddr = this->physical(vaddr);
+	assert(paddr + length <= this->memory.size());
+	memcpy(&this->memory[paddr], data, length);
+}
+
+void GuestFixture::map(uint64_t pgd, uint64_t vaddr, uint64_t paddr,
+                       uint64_t flags, bool large) {
+	uint64_t user = (vaddr < 0x800000000000) ? PTE_USER : 0;
+	uint64_t table = pgd;
+	int last = large ? 21 : 12;
+	for (int shift = 39; shift > last; shift -= 9) {
+		uint64_t slot = table + ((vaddr >> shift) & 0x1ff) * 8;
+		uint64_t entry;
+		memcpy(&entry, &this->memory[slot], sizeof(entry));
+		if (!(entry & PTE_PRESENT)) {
+			// Permissions are only restricted in the last level
+			entry = this->allocate(pageSize) | PTE_PRESENT | PTE_WRITE | user;
+			memcpy(&this->memory[slot], &entry, sizeof(entry));
+		}
+		table = entry & PTE_ADDRESS;
+	}
+
+	uint64_t entry = paddr | flags | PTE_PRESENT | user | (large ? PTE_LARGE : 0);
+	memcpy(&this->memory[table + ((vaddr >> last) & 0x1ff) * 8],
+	       &entry, sizeof(entry));
+}
+
+void GuestFixture::mapKernel() {
+	uint64_t textStart = this->physical(this->symbol("_text"));
+	uint64_t textEnd   = this->physical(this->symbol("_etext"));
+	uint64_t end       = this->memory.size();
+
+	for (uint64_t paddr = 0; paddr < end; paddr += largePageSize) {
+		bool code = (paddr + largePageSize > textStart && paddr < textEnd);
+		this->map(this->kernelPgd, kernelMapStart + paddr, paddr,
+		          PTE_WRITE | (code ? 0 : PTE_NX), true);
+	}
+}
+
+void GuestFixture::mapDirect() {
+	// Mapping allocates page tables, so the end moves
+	uint64_t paddr = 0;
+	while (paddr < this->memory.size()) {
+		this->map(this->kernelPgd, directMapStart + paddr, paddr,
+		          PTE_WRITE | PTE_NX, true);
+		paddr += largePageSize;
+	}
+	this->memory.resize(paddr);
+}
+
+void GuestFixture::listAppend(uint64_t head, uint64_t entry) {
+	uint64_t prev;
+	memcpy(&prev, &this->memory[this->physical(head + 8)], sizeof(prev));
+	this->store<uint64_t>(entry, head);
+	this->store<uint64_t>(entry + 8, prev);
+	this->store<uint64_t>(prev, entry);
+	this->store<uint64_t>(head + 8, entry);
+}
+
+GuestFixture::Binary *GuestFixture::loadBinary(const std::string &userspaceDir,
+                                               const std::string &path) {
+	auto it = this->binaries.find(path);
+	if (it != this->binaries.end()) {
+		return &it->second;
+	}
+
+	std::ifstream file(userspaceDir + path, std::ios::binary);
+	if (!file.is_open()) {
+		return nullptr;
+	}
+	Binary binary;
+	binary.path = path;
+	binary.content.assign(std::istreambuf_iterator<char>(file),
+	                      std::istreambuf_iterator<char>());
+
+	const Elf64_Ehdr *ehdr = (const Elf64_Ehdr *)binary.content.data();
+	if (binary.content.size() < sizeof(Elf64_Ehdr) ||
+	    memcmp(ehdr->e_ident, ELFMAG, SELFMAG) != 0 ||
+	    ehdr->e_ident[EI_CLASS] != ELFCLASS64 ||
+	    ehdr->e_phoff + ehdr->e_phnum * sizeof(Elf64_Phdr) >
+	    binary.content.size()) {
+		std::cout << COLOR_RED << "Not a 64 bit ELF file: " << path
+		          << COLOR_NORM << std::endl;
+		return nullptr;
+	}
+
+	return &(this->binaries[path] = std::move(binary));
+}
+
+std::vector<std::string> GuestFixture::findLibraries(
+	const std::string &userspaceDir, Binary *binary) {
+
+	std::vector<std::string> libraries;
+	const uint8_t *content = binary->content.data();
+	size_t contentSize     = binary->content.size();
+	const Elf64_Ehdr *ehdr = (const Elf64_Ehdr *)content;
+	const Elf64_Phdr *phdr = (const Elf64_Phdr *)(content + ehdr->e_phoff);
+
+	auto fileOffset = [&](uint64_t vaddr) -> uint64_t {
+		for (int i = 0; i < ehdr->e_phnum; i++) {
+			if (phdr[i].p_type == PT_LOAD &&
+			    vaddr >= phdr[i].p_vaddr &&
+			    vaddr < phdr[i].p_vaddr + phdr[i].p_filesz) {
+				return vaddr - phdr[i].p_vaddr + phdr[i].p_offset;
+			}
+		}
+		return contentSize;
+	};
+
+	const Elf64_Dyn *dynamic = nullptr;
+	size_t dynamicCount = 0;
+	for (int i = 0; i < ehdr->e_phnum; i++) {
+		if (phdr[i].p_type == PT_INTERP && phdr[i].p_offset < contentSize) {
+			libraries.emplace_back(
+				(const char *)content + phdr[i].p_offset,
+				strnlen((const char *)content + phdr[i].p_offset,
+				        std::min(phdr[i].p_filesz, contentSize - phdr[i].p_offset)));
+		} else if (phdr[i].p_type == PT_DYNAMIC &&
+		           phdr[i].p_offset + phdr[i].p_filesz <= contentSize) {
+			dynamic      = (const Elf64_Dyn *)(content + phdr[i].p_offset);
+			dynamicCount = phdr[i].p_filesz / sizeof(Elf64_Dyn);
+		}
+	}
+
+	uint64_t strtab = contentSize;
+	for (size_t i = 0; i < dynamicCount && dynamic[i].d_tag != DT_NULL; i++) {
+		if (dynamic[i].d_tag == DT_STRTAB) {
+			strtab = fileOffset(dynamic[i].d_un.d_ptr);
+		}
+	}
+
+	for (size_t i = 0; i < dynamicCount && dynamic[i].d_tag != DT_NULL; i++) {
+		if (dynamic[i].d_tag != DT_NEEDED ||
+		    strtab + dynamic[i].d_un.d_val >= contentSize) {
+			continue;
+		}
+		std::string name{(const char *)content + strtab + dynamic[i].d_un.d_val};
+		bool found = false;
+		for (const char *dir : librarySearchPath) {
+			std::string path = std::string(dir) + "/" + name;
+			if (fexists(userspaceDir + path)) {
+				libraries.push_back(path);
+				found = true;
+				break;
+			}
+		}
+		if (!found) {
+			std::cout << COLOR_MARGENTA << "Library not found: " << name
+			          << COLOR_NORM << std::endl;
+		}
+	}
+	return libraries;
+}
+
+uint64_t GuestFixture::createDentry(const std::string &path) {
+	auto it = this->dentries.find(path);
+	if (it != this->dentries.end()) {
+		return it->second;
+	}
+
+	uint64_t dentry = this->allocateObject(this->size("dentry"));
+	uint64_t parent = dentry;
+	std::string name = "/";
+	if (path != "/") {
+		size_t slash = path.rfind('/');
+		parent = this->createDentry(slash ? path.substr(0, slash) : "/");
+		name   = path.substr(slash + 1);
+	}
+
+	this->store<uint64_t>(dentry + this->offset("dentry", "d_name") +
+	                      this->offset("qstr", "name"),
+	                      this->allocateString(name));
+	this->store<uint64_t>(dentry + this->offset("dentry", "d_parent"), parent);
+	this->dentries[path] = dentry;
+	return dentry;
+}
+
+uint64_t GuestFixture::createFile(Binary *binary) {
+	if (binary->file) {
+		return binary->file;
+	}
+
+	uint64_t inode = this->allocateObject(this->size("inode"));
+	this->store<uint64_t>(inode + this->offset("inode", "i_ino"),
+	                      this->nextInode++);
+
+	uint64_t mapping = this->allocateObject(this->size("address_space"));
+	this->store<uint64_t>(mapping + this->offset("address_space", "host"),
+	                      inode);
+
+	uint64_t file = this->allocateObject(this->size("file"));
+	this->store<uint64_t>(file + this->offset("file", "f_path") +
+	                      this->offset("path", "dentry"),
+	                      this->createDentry(binary->path));
+	this->store<uint64_t>(file + this->offset("file", "f_mapping"), mapping);
+
+	binary->file = file;
+	return file;
+}
+
+uint64_t GuestFixture::createVma(uint64_t mm, uint64_t start, uint64_t end,
+                                 uint64_t flags, uint64_t file,
+                                 uint64_t pgoff) {
+	uint64_t vma = this->allocateObject(this->size("vm_area_struct"));
+	this->store<uint64_t>(vma + this->offset("vm_area_struct", "vm_start"), start);
+	this->store<uint64_t>(vma + this->offset("vm_area_struct", "vm_end"), end);
+	this->store<uint64_t>(vma + this->offset("vm_area_struct", "vm_flags"), flags);
+	this->store<uint64_t>(vma + this->offset("vm_area_struct", "vm_file"), file);
+	this->store<uint64_t>(vma + this->offset("vm_area_struct", "vm_pgoff"), pgoff);
+	this->store<uint64_t>(vma + this->offset("vm_area_struct", "vm_mm"), mm);
+	return vma;
+}
+
+void GuestFixture::mapBinary(uint64_t pgd, uint64_t mm, Binary *binary,
+                             uint64_t base,
+                             std::vector<std::pair<uint64_t, uint64_t>> &vmas) {
+	uint64_t file = this->createFile(binary);
+	const uint8_t *content = binary->content.data();
+	size_t contentSize     = binary->content.size();
+	const Elf64_Ehdr *ehdr = (const Elf64_Ehdr *)content;
+	const Elf64_Phdr *phdr = (const Elf64_Phdr *)(content + ehdr->e_phoff);
+
+	for (int i = 0; i < ehdr->e_phnum; i++) {
+		if (phdr[i].p_type != PT_LOAD) {
+			continue;
+		}
+		uint64_t start   = alignDown(base + phdr[i].p_vaddr, pageSize);
+		uint64_t fileEnd = base + phdr[i].p_vaddr + phdr[i].p_filesz;
+		uint64_t end     = alignUp(base + phdr[i].p_vaddr + phdr[i].p_memsz,
+		                           pageSize);
+		uint64_t pgoff   = alignDown(phdr[i].p_offset, pageSize) / pageSize;
+
+		uint64_t flags = VM_MAYREAD | VM_MAYWRITE | VM_MAYEXEC;
+		flags |= (phdr[i].p_flags & PF_R) ? VM_READ : 0;
+		flags |= (phdr[i].p_flags & PF_W) ? VM_WRITE : 0;
+		flags |= (phdr[i].p_flags & PF_X) ? VM_EXEC : 0;
+		vmas.emplace_back(start,
+		                  this->createVma(mm, start, end, flags, file, pgoff));
+
+		uint64_t pteFlags = ((phdr[i].p_flags & PF_W) ? PTE_WRITE : 0) |
+		                    ((phdr[i].p_flags & PF_X) ? 0 : PTE_NX);
+
+		// The bss is not touched yet, only the file pages are present
+		for (uint64_t vaddr = start; vaddr < fileEnd; vaddr += pageSize) {
+			uint64_t offset = pgoff * pageSize + (vaddr - start);
+			uint64_t bytes  = std::min<uint64_t>(
+				pageSize, contentSize - std::min<uint64_t>(offset, contentSize));
+			bool bss = (vaddr + pageSize > fileEnd &&
+			            phdr[i].p_memsz > phdr[i].p_filesz);
+			if (bss) {
+				// The part behind the file content is cleared
+				bytes = std::min(bytes, fileEnd - vaddr);
+			}
+
+			uint64_t frame;
+			auto cached = binary->frames.find(offset);
+			if (!bss && cached != binary->frames.end()) {
+				frame = cached->second;
+			} else {
+				frame = this->allocate(pageSize);
+				memcpy(&this->memory[frame], content + offset, bytes);
+				if (!bss) {
+					binary->frames[offset] = frame;
+				}
+			}
+			this->map(pgd, vaddr, frame, pteFlags);
+		}
+	}
+}
+
+uint64_t GuestFixture::createTask(pid_t pid, const std::string &comm,
+                                  uint64_t mm) {
+	static uint32_t PIDTYPE_PGID =
+		this->kernel->symbols.findBaseTypeByName<Enum>("pid_type")
+		    ->enumValue("PIDTYPE_PGID");
+
+	uint64_t task = this->allocateObject(this->size("task_struct"));
+	this->store<int32_t>(task + this->offset("task_struct", "pid"), pid);
+	this->store<int32_t>(task + this->offset("task_struct", "tgid"), pid);
+	this->store<uint64_t>(task + this->offset("task_struct", "mm"), mm);
+	this->store<uint64_t>(task + this->offset("task_struct", "active_mm"), mm);
+	this->store<uint64_t>(task + this->offset("task_struct", "group_leader"), task);
+
+	char name[16] = {0};
+	strncpy(name, comm.c_str(), sizeof(name) - 1);
+	this->storeBytes(task + this->offset("task_struct", "comm"),
+	                 name, sizeof(name));
+
+	// The process group id tells user and kernel tasks apart
+	uint64_t pidStruct = this->allocateObject(this->size("pid"));
+	this->store<int32_t>(pidStruct + this->offset("pid", "numbers") +
+	                     this->offset("upid", "nr"), pid);
+	this->store<uint64_t>(task + this->offset("task_struct", "pids") +
+	                      PIDTYPE_PGID * this->size("pid_link") +
+	                      this->offset("pid_link", "pid"),
+	                      pidStruct);
+
+	uint64_t stack = directMapStart + this->allocate(THREAD_SIZE, THREAD_SIZE);
+	uint64_t thread = task + this->offset("task_struct", "thread");
+	this->store<uint64_t>(task + this->offset("task_struct", "stack"), stack);
+	this->store<uint64_t>(thread + this->offset("thread_struct", "sp0"),
+	                      stack + THREAD_SIZE);
+	this->store<uint64_t>(thread + this->offset("thread_struct", "sp"),
+	                      stack + THREAD_SIZE - 0x100);
+
+	this->listAppend(this->taskList, task + this->offset("task_struct", "tasks"));
+	return task;
+}
+
+bool GuestFixture::addProcess(const std::string &userspaceDir,
+                              const std::string &path) {
+	Binary *exe = this->loadBinary(userspaceDir, path);
+	if (!exe) {
+		return false;
+	}
+
+	uint64_t pgd = this->allocate(pageSize);
+	this->userPgds.push_back(pgd);
+	uint64_t mm = this->allocateObject(this->size("mm_struct"));
+
+	std::vector<std::pair<uint64_t, uint64_t>> vmas;
+
+	// Position independent executables are moved like with ASLR disabled
+	const Elf64_Ehdr *ehdr = (const Elf64_Ehdr *)exe->content.data();
+	uint64_t exeBase = (ehdr->e_type == ET_DYN) ? pieBase : 0;
+	this->mapBinary(pgd, mm, exe, exeBase, vmas);
+
+	uint64_t brk = 0;
+	for (auto &vma : vmas) {
+		uint64_t end;
+		memcpy(&end, &this->memory[this->physical(
+			vma.second + this->offset("vm_area_struct", "vm_end"))],
+		       sizeof(end));
+		brk = std::max(brk, end);
+	}
+
+	// All libraries the process depends on, loader first
+	std::set<std::string> seen;
+	std::deque<std::string> pending;
+	for (auto &library : this->findLibraries(userspaceDir, exe)) {
+		pending.push_back(library);
+	}
+	uint64_t libraryBase = libraryTop;
+	while (!pending.empty()) {
+		std::string libraryPath = pending.front();
+		pending.pop_front();
+		if (!seen.insert(libraryPath).second) {
+			continue;
+		}
+		Binary *library = this->loadBinary(userspaceDir, libraryPath);
+		if (!library) {
+			continue;
+		}
+
+		const Elf64_Ehdr *lehdr = (const Elf64_Ehdr *)library->content.data();
+		const Elf64_Phdr *lphdr = (const Elf64_Phdr *)(
+			library->content.data() + lehdr->e_phoff);
+		uint64_t span = 0;
+		for (int i = 0; i < lehdr->e_phnum; i++) {
+			if (lphdr[i].p_type == PT_LOAD) {
+				span = std::max(span, lphdr[i].p_vaddr + lphdr[i].p_memsz);
+			}
+		}
+		libraryBase = alignDown(libraryBase - alignUp(span, pageSize),
+		                        largePageSize);
+		this->mapBinary(pgd, mm, library, libraryBase, vmas);
+
+		for (auto &dependency : this->findLibraries(userspaceDir, library)) {
+			pending.push_back(dependency);
+		}
+	}
+
+	// Only the top of the stack is present
+	uint64_t stackFrame = this->allocate(pageSize);
+	this->map(pgd, stackEnd - pageSize, stackFrame, PTE_WRITE | PTE_NX);
+	vmas.emplace_back(stackStart,
+	                  this->createVma(mm, stackStart, stackEnd,
+	                                  VM_READ | VM_WRITE | VM_MAYREAD |
+	                                  VM_MAYWRITE, 0, 0));
+
+	std::sort(vmas.begin(), vmas.end());
+	for (size_t i = 0; i + 1 < vmas.size(); i++) {
+		this->store<uint64_t>(vmas[i].second +
+		                      this->offset("vm_area_struct", "vm_next"),
+		                      vmas[i + 1].second);
+	}
+
+	uint64_t startStack = stackEnd - 0x100;
+	this->store<uint64_t>(mm + this->offset("mm_struct", "mmap"), vmas[0].second);
+	this->store<int32_t>(mm + this->offset("mm_struct", "map_count"), vmas.size());
+	this->store<uint64_t>(mm + this->offset("mm_struct", "pgd"), directMapStart + pgd);
+	this->store<uint64_t>(mm + this->offset("mm_struct", "exe_file"), exe->file);
+	this->store<uint64_t>(mm + this->offset("mm_struct", "start_brk"), brk);
+	this->store<uint64_t>(mm + this->offset("mm_struct", "brk"), brk);
+	this->store<uint64_t>(mm + this->offset("mm_struct", "start_stack"), startStack);
+	for (const char *member : {"arg_start", "arg_end", "env_start", "env_end"}) {
+		this->store<uint64_t>(mm + this->offset("mm_struct", member), startStack);
+	}
+
+	this->createTask(this->nextPid++, baseName(path), mm);
+	return true;
+}
+
+void GuestFixture::addModules(uint32_t count) {
+	std::vector<std::string> files;
+	fs::recursive_directory_iterator it(this->kernelDir), end;
+	for (; it != end; it++) {
+		std::string path = it->path().string();
+		if (path.find("debian") == std::string::npos &&
+		    it->path().extension() == ".ko") {
+			files.push_back(path);
+		}
+	}
+	std::sort(files.begin(), files.end());
+	if (files.size() > count) {
+		files.resize(count);
+	}
+
+	uint64_t moduleSize = this->size("module");
+	uint64_t attrsSize  = this->size("module_sect_attrs");
+	uint64_t attrSize   = this->size("module_sect_attr");
+
+	for (auto &path : files) {
+		std::ifstream file(path, std::ios::binary);
+		std::vector<uint8_t> content{std::istreambuf_iterator<char>(file),
+		                             std::istreambuf_iterator<char>()};
+		const Elf64_Ehdr *ehdr = (const Elf64_Ehdr *)content.data();
+		if (content.size() < sizeof(Elf64_Ehdr) ||
+		    memcmp(ehdr->e_ident, ELFMAG, SELFMAG) != 0 ||
+		    ehdr->e_shoff + ehdr->e_shnum * sizeof(Elf64_Shdr) > content.size()) {
+			continue;
+		}
+		const Elf64_Shdr *shdr = (const Elf64_Shdr *)(content.data() + ehdr->e_shoff);
+		const char *names = (const char *)content.data() +
+		                    shdr[ehdr->e_shstrndx].sh_offset;
+
+		// Code first, then read only data, data, struct module and bss
+		// like the module loader does. The code starts with .text, the
+		// other code sections follow without padding as in the image
+		// of ElfModuleLoader.
+		std::vector<std::pair<int, int>> order;
+		int thisModule = -1;
+		Module module;
+		for (int i = 0; i < ehdr->e_shnum; i++) {
+			std::string name = names + shdr[i].sh_name;
+			if (name == ".modinfo") {
+				const char *info = (const char *)content.data() + shdr[i].sh_offset;
+				const char *infoEnd = info + shdr[i].sh_size;
+				for (; info < infoEnd; info += strnlen(info, infoEnd - info) + 1) {
+					std::string entry{info, strnlen(info, infoEnd - info)};
+					if (entry.compare(0, 8, "depends=") != 0) {
+						continue;
+					}
+					std::stringstream depends{entry.substr(8)};
+					std::string depend;
+					while (std::getline(depends, depend, ',')) {
+						std::replace(depend.begin(), depend.end(), '-', '_');
+						if (!depend.empty()) {
+							module.depends.push_back(depend);
+						}
+					}
+				}
+			}
+			if (!(shdr[i].sh_flags & SHF_ALLOC) || name.compare(0, 5, ".init") == 0 ||
+			    name == ".data..percpu") {
+				continue;
+			}
+			int rank;
+			if (name == ".gnu.linkonce.this_module") {
+				thisModule = i;
+				rank = 4;
+			} else if (shdr[i].sh_type == SHT_NOBITS) {
+				rank = 5;
+			} else if (shdr[i].sh_flags & SHF_EXECINSTR) {
+				rank = (name == ".text") ? 0 : 1;
+			} else if (!(shdr[i].sh_flags & SHF_WRITE)) {
+				rank = 2;
+			} else {
+				rank = 3;
+			}
+			order.emplace_back(rank, i);
+		}
+		if (thisModule < 0) {
+			continue;
+		}
+		std::stable_sort(order.begin(), order.end(),
+		                 [](const std::pair<int, int> &a, const std::pair<int, int> &b) {
+			                 return a.first < b.first;
+		                 });
+
+		std::vector<uint64_t> address(ehdr->e_shnum, 0);
+		uint64_t offset = 0;
+		uint64_t textEnd = 0;
+		for (auto &entry : order) {
+			const Elf64_Shdr &section = shdr[entry.second];
+			uint64_t align = std::max<uint64_t>(section.sh_addralign, 1);
+			if (entry.first != 1) {
+				offset = alignUp(offset, align);
+			}
+			address[entry.second] = this->nextModuleAddress + offset;
+			// kernint expects the bss right behind struct module
+			offset += (entry.second == thisModule)
+			          ? std::max(section.sh_size, moduleSize) : section.sh_size;
+			if (entry.first <= 1) {
+				textEnd = alignUp(offset, pageSize);
+			}
+		}
+
+		uint64_t areaSize = alignUp(offset, pageSize);
+		uint64_t area = this->allocate(areaSize);
+		for (uint64_t page = 0; page < areaSize; page += pageSize) {
+			this->map(this->kernelPgd, this->nextModuleAddress + page,
+			          area + page, PTE_WRITE | ((page < textEnd) ? 0 : PTE_NX));
+		}
+		for (auto &entry : order) {
+			const Elf64_Shdr &section = shdr[entry.second];
+			if (section.sh_type != SHT_NOBITS) {
+				this->storeBytes(address[entry.second],
+				                 content.data() + section.sh_offset,
+				                 section.sh_size);
+			}
+		}
+
+		uint64_t moduleStruct = address[thisModule];
+		std::string name = baseName(path);
+		name = name.substr(0, name.size() - 3);
+		std::replace(name.begin(), name.end(), '-', '_');
+		char moduleName[56] = {0};
+		strncpy(moduleName, name.c_str(), sizeof(moduleName) - 1);
+		this->storeBytes(moduleStruct + this->offset("module", "name"),
+		                 moduleName, sizeof(moduleName));
+
+		uint64_t attrs = this->allocateObject(attrsSize + order.size() * attrSize);
+		this->store<uint32_t>(attrs + this->offset("module_sect_attrs", "nsections"),
+		                      order.size());
+		uint64_t attr = attrs + this->offset("module_sect_attrs", "attrs");
+		for (auto &entry : order) {
+			std::string sectionName = names + shdr[entry.second].sh_name;
+			this->store<uint64_t>(attr + this->offset("module_sect_attr", "name"),
+			                      this->allocateString(sectionName));
+			this->store<uint64_t>(attr + this->offset("module_sect_attr", "address"),
+			                      address[entry.second]);
+			if (sectionName == "__ksymtab_gpl") {
+				this->store<uint64_t>(moduleStruct + this->offset("module", "gpl_syms"),
+				                      address[entry.second]);
+			}
+			attr += attrSize;
+		}
+		this->store<uint64_t>(moduleStruct + this->offset("module", "sect_attrs"),
+		                      attrs);
+
+		for (int i = 0; i < ehdr->e_shnum; i++) {
+			if (std::string(names + shdr[i].sh_name) == ".data..percpu") {
+				this->store<uint64_t>(moduleStruct + this->offset("module", "percpu"),
+				                      this->allocateObject(shdr[i].sh_size));
+			}
+		}
+
+		this->listAppend(this->moduleList,
+		                 moduleStruct + this->offset("module", "list"));
+		if (textEnd) {
+			module.text    = this->nextModuleAddress;
+			module.textEnd = this->nextModuleAddress + textEnd;
+			this->moduleCode.emplace_back(module.text, module.textEnd);
+		}
+		module.name = name;
+		this->modules.push_back(module);
+		this->nextModuleAddress += areaSize + pageSize;
+		this->moduleCount++;
+	}
+}
+
+void GuestFixture::injectModifications(uint32_t count, uint32_t seed) {
+	uint64_t textStart = this->kernel->textSegment.memindex | 0xffff000000000000;
+	uint64_t pages = this->kernel->textSegment.size / pageSize;
+
+	std::vector<uint64_t> order(pages);
+	for (uint64_t i = 0; i < pages; i++) {
+		order[i] = i;
+	}
+	std::mt19937_64 random{seed};
+	std::shuffle(order.begin(), order.end(), random);
+	order.resize(std::min<uint64_t>(count, pages));
+
+	for (uint64_t page : order) {
+		uint64_t address = textStart + page * pageSize + random() % pageSize;
+		this->memory[this->physical(address)] ^= 0xff;
+		this->modifications.push_back(address);
+	}
+	std::sort(this->modifications.begin(), this->modifications.end());
+}
+
+bool GuestFixture::copyBinaries(const std::string &rootDir) const {
+	boost::system::error_code ec;
+	for (auto &binary : this->binaries) {
+		fs::path target{rootDir + binary.first};
+		fs::create_directories(target.parent_path(), ec);
+		std::ofstream out(target.string(), std::ios::binary | std::ios::trunc);
+		if (!out.is_open()) {
+			return false;
+		}
+		out.write((const char *)binary.second.content.data(),
+		          binary.second.content.size());
+		if (!out) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool GuestFixture::writeConfig(const std::string &imageFile) const {
+	std::ofstream out(imageFile + ".conf");
+	if (!out.is_open()) {
+		return false;
+	}
+	out << std::hex
+	    << baseName(imageFile) << " {\n"
+	    << "    ostype = \"Linux\";\n"
+	    << "    sysmap = \"" << this->kernelDir << "/System.map\";\n"
+	    << "    linux_name = 0x" << this->offset("task_struct", "comm") << ";\n"
+	    << "    linux_tasks = 0x" << this->offset("task_struct", "tasks") << ";\n"
+	    << "    linux_mm = 0x" << this->offset("task_struct", "mm") << ";\n"
+	    << "    linux_pid = 0x" << this->offset("task_struct", "pid") << ";\n"
+	    << "    linux_pgd = 0x" << this->offset("mm_struct", "pgd") << ";\n"
+	    << "}\n";
+	return (bool)out;
+}
+
+bool GuestFixture::write(const std::string &imageFile,
+                         const std::string &rootDir) {
+	this->mapDirect();
+
+	// Every process shares the kernel half of the address space
+	for (uint64_t pgd : this->userPgds) {
+		memcpy(&this->memory[pgd + pageSize / 2],
+		       &this->memory[this->kernelPgd + pageSize / 2], pageSize / 2);
+	}
+
+	return this->writeImage(imageFile) && this->writeConfig(imageFile) &&
+	       this->copyBinaries(rootDir);
+}
+
+bool GuestFixture::writeImage(const std::string &imageFile) const {
+	std::ofstream out(imageFile, std::ios::binary | std::ios::trunc);
+	if (!out.is_open()) {
+		return false;
+	}
+	out.write((const char *)this->memory.data(), this->memory.size());
+	return (bool)out;
+}
+
+bool GuestFixture::hasDependencies(const Module &module) const {
+	std::set<std::string> names;
+	for (auto &other : this->modules) {
+		names.insert(other.name);
+	}
+
+	std::set<std::string> seen{module.name};
+	std::deque<const Module *> todo{&module};
+	while (!todo.empty()) {
+		const Module *current = todo.front();
+		todo.pop_front();
+		for (auto &depend : current->depends) {
+			if (!names.count(depend)) {
+				return false;
+			}
+			if (!seen.insert(depend).second) {
+				continue;
+			}
+			for (auto &other : this->modules) {
+				if (other.name == depend) {
+					todo.push_back(&other);
+				}
+			}
+		}
+	}
+	return true;
+}
+
+bool GuestFixture::relocateModules(const std::string &imageFile) {
+	// Check first, VMIInstance does not fail gracefully
+	vmi_instance_t probe;
+	if (vmi_init(&probe, VMI_FILE | VMI_INIT_COMPLETE,
+	             const_cast<char *>(imageFile.c_str())) != VMI_SUCCESS) {
+		return false;
+	}
+	vmi_destroy(probe);
+
+	// The module loader reads struct module and the section addresses
+	// from the image, the relocated code is written back to it
+	VMIInstance vmi(imageFile, VMI_FILE | VMI_INIT_COMPLETE);
+	this->kernel->setVMIInstance(&vmi);
+	this->moduleCode.clear();
+	for (auto &module : this->modules) {
+		if (!module.textEnd) {
+			continue;
+		}
+		if (!this->hasDependencies(module)) {
+			this->moduleCode.emplace_back(module.text, module.textEnd);
+			continue;
+		}
+		ElfModuleLoader *loader = this->kernel->loadModule(module.name);
+		const std::vector<uint8_t> &text = loader->getTextSegment();
+		assert(loader->textSegment.memindex == module.text);
+		this->storeBytes(module.text, text.data(),
+		                 std::min<uint64_t>(text.size(),
+		                                    module.textEnd - module.text));
+	}
+	this->kernel->setVMIInstance(nullptr);
+
+	return this->writeImage(imageFile);
+}
+
+} // namespace kernint
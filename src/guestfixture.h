@@ -0,0 +1,187 @@
+#ifndef KERNINT_GUESTFIXTURE_H_
+#define KERNINT_GUESTFIXTURE_H_
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <sys/types.h>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace kernint {
+
+class ElfKernelLoader;
+
+/**
+ * Builds a synthetic guest from a reference kernel, its modules and a
+ * userspace tree, so kernint can run without a hypervisor.
+ *
+ * The result is a raw physical memory image for the libvmi file backend
+ * with 4-level page tables, the patched kernel text, a module list and
+ * a task list of processes that map binaries of the userspace tree.
+ * Kernel structures are laid out with the offsets of the kernel's DWARF
+ * information. The used binaries are copied to a root directory that
+ * is passed as --root-path to kernint.
+ *
+ * Modules are placed with the content of their ELF sections. Their code
+ * is relocated and patched by relocateModules() with the module loader
+ * of kernint, which reads the module structures from the written image.
+ */
+class GuestFixture {
+public:
+	/** Pid of the first added process, the others follow in order */
+	static const uint32_t firstPid = 1;
+
+	GuestFixture(ElfKernelLoader *kernel, const std::string &kernelDir);
+
+	/**
+	 * Add a process running the binary at path of the userspace tree
+	 * in userspaceDir. The libraries are searched in the usual places
+	 * of the tree. Returns false if the binary can not be read.
+	 */
+	bool addProcess(const std::string &userspaceDir, const std::string &path);
+
+	/**
+	 * Add up to count modules found in the kernel directory. Their
+	 * code is not relocated until relocateModules() is called.
+	 */
+	void addModules(uint32_t count);
+
+	/**
+	 * Flip one byte in each of count random kernel code pages. The
+	 * addresses are returned by getModifications().
+	 */
+	void injectModifications(uint32_t count, uint32_t seed);
+
+	/**
+	 * Write the memory image to imageFile and the libvmi configuration
+	 * to imageFile.conf. The binaries of all processes are copied to
+	 * rootDir.
+	 */
+	bool write(const std::string &imageFile, const std::string &rootDir);
+
+	/**
+	 * Relocate and patch the code of the modules in the image written
+	 * to imageFile, which is opened with the libvmi file backend. Modules
+	 * that depend on a module missing in the image are left as they are.
+	 * Returns false if imageFile.conf is not in the libvmi configuration
+	 * or the image can not be rewritten.
+	 */
+	bool relocateModules(const std::string &imageFile);
+
+	const std::vector<uint64_t> &getModifications() const {
+		return this->modifications;
+	}
+
+	/** Start and end of the code of each module that is not relocated */
+	const std::vector<std::pair<uint64_t, uint64_t>> &getModuleCode() const {
+		return this->moduleCode;
+	}
+
+	uint32_t getProcessCount() const { return this->nextPid - firstPid; }
+	uint32_t getModuleCount() const { return this->moduleCount; }
+
+private:
+	static const uint64_t pageSize       = 0x1000;
+	static const uint64_t largePageSize  = 0x200000;
+	static const uint64_t kernelMapStart = 0xffffffff80000000;
+	static const uint64_t directMapStart = 0xffff880000000000;
+	static const uint64_t moduleMapStart = 0xffffffffa0000000;
+
+	/** A binary of the userspace tree, loaded once for all processes */
+	struct Binary {
+		std::string path;
+		std::vector<uint8_t> content;
+		/** Physical frames of the file pages, by file offset */
+		std::unordered_map<uint64_t, uint64_t> frames;
+		/** Virtual address of the struct file shared by all mappings */
+		uint64_t file = 0;
+	};
+
+	ElfKernelLoader *kernel;
+	std::string kernelDir;
+
+	/** Physical memory, grows with every allocation */
+	std::vector<uint8_t> memory;
+	uint64_t kernelPgd;
+
+	std::map<std::string, Binary> binaries;
+	/** Cached dentries by path */
+	std::unordered_map<std::string, uint64_t> dentries;
+	uint64_t nextInode = 1000;
+
+	/** list_head of init_task and of the modules */
+	uint64_t taskList;
+	uint64_t moduleList;
+
+	/** Physical addresses of the process page tables */
+	std::vector<uint64_t> userPgds;
+	uint32_t nextPid = firstPid;
+
+	/** A module placed in the image */
+	struct Module {
+		std::string name;
+		/** Names of the modules it depends on, from .modinfo */
+		std::vector<std::string> depends;
+		uint64_t text    = 0;
+		uint64_t textEnd = 0;
+	};
+
+	uint64_t nextModuleAddress = moduleMapStart;
+	uint32_t moduleCount = 0;
+	std::vector<Module> modules;
+	std::vector<std::pair<uint64_t, uint64_t>> moduleCode;
+
+	std::vector<uint64_t> modifications;
+
+	uint64_t offset(const std::string &type, const std::string &member) const;
+	uint64_t size(const std::string &type) const;
+	uint64_t symbol(const std::string &name) const;
+
+	/** Allocate zeroed physical memory, returns the physical address */
+	uint64_t allocate(uint64_t bytes, uint64_t align=pageSize);
+	/** Allocate in the direct map, returns the virtual address */
+	uint64_t allocateObject(uint64_t bytes);
+	uint64_t allocateString(const std::string &value);
+
+	/** Walk the page tables at the physical address pgd */
+	uint64_t translate(uint64_t pgd, uint64_t vaddr) const;
+	/** Physical address of a kernel virtual address */
+	uint64_t physical(uint64_t vaddr) const;
+	template <typename T>
+	void store(uint64_t vaddr, T value);
+	void storeBytes(uint64_t vaddr, const void *data, uint64_t length);
+
+	void map(uint64_t pgd, uint64_t vaddr, uint64_t paddr, uint64_t flags,
+	         bool large=false);
+	void mapKernel();
+	void mapDirect();
+
+	/** Insert the list_head entry at the end of the list head */
+	void listAppend(uint64_t head, uint64_t entry);
+
+	Binary *loadBinary(const std::string &userspaceDir,
+	                   const std::string &path);
+	std::vector<std::string> findLibraries(const std::string &userspaceDir,
+	                                       Binary *binary);
+	uint64_t createFile(Binary *binary);
+	uint64_t createDentry(const std::string &path);
+	/** Map the PT_LOAD segments of binary at base, adds the VMAs */
+	void mapBinary(uint64_t pgd, uint64_t mm, Binary *binary, uint64_t base,
+	               std::vector<std::pair<uint64_t, uint64_t>> &vmas);
+	uint64_t createVma(uint64_t mm, uint64_t start, uint64_t end,
+	                   uint64_t flags, uint64_t file, uint64_t pgoff);
+	uint64_t createTask(pid_t pid, const std::string &comm, uint64_t mm);
+
+	/** Whether all modules module depends on are in the image */
+	bool hasDependencies(const Module &module) const;
+
+	bool writeImage(const std::string &imageFile) const;
+	bool copyBinaries(const std::string &rootDir) const;
+	bool writeConfig(const std::string &imageFile) const;
+};
+
+} // namespace kernint
+
+#endif
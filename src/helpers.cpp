@@ -3,8 +3,11 @@
 #include <cxxabi.h>
 #include <dlfcn.h>
 
+#include <random>
+
 #include <capstone/capstone.h>
 
+#include "metrics.h"
 
 namespace kernint {
 
@@ -68,37 +71,138 @@ void printHexDump(const std::vector<uint8_t> *bytes) {
 void displayChange(const uint8_t *memory,
                    const uint8_t *reference,
                    int32_t offset,
-                   int32_t size) {
-	std::cout << "First change"
-	          << " in byte 0x" << std::hex << offset << " is 0x"
-	          << (uint32_t)reference[offset] << " should be 0x"
-	          << (uint32_t)memory[offset] << std::dec << std::endl;
+                   int32_t size,
+                   std::ostream &out) {
+	out << "First change"
+	    << " in byte 0x" << std::hex << offset << " is 0x"
+	    << (uint32_t)reference[offset] << " should be 0x"
+	    << (uint32_t)memory[offset] << std::dec << std::endl;
 
 	// Print 40 Bytes from should be
 
-	std::cout << "The loaded block is: " << std::hex << std::endl;
+	out << "The loaded block is: " << std::hex << std::endl;
 	for (int32_t k = offset - 15; (k < offset + 15) && (k < size); k++) {
 		if (k < 0 || k >= size)
 			continue;
 		if (k == offset)
-			std::cout << " # ";
-		std::cout << std::setfill('0') << std::setw(2) << (uint32_t)reference[k]
-		          << " ";
+			out << " # ";
+		out << std::setfill('0') << std::setw(2) << (uint32_t)reference[k]
+		    << " ";
 	}
 
-	std::cout << std::endl << "The block in mem is: " << std::hex << std::endl;
+	out << std::endl << "The block in mem is: " << std::hex << std::endl;
 	for (int32_t k = offset - 15; (k < offset + 15) && (k < size); k++) {
 		if (k < 0 || k >= size)
 			continue;
 		if (k == offset)
-			std::cout << " # ";
-		std::cout << std::setfill('0') << std::setw(2) << (uint32_t)memory[k]
-		          << " ";
+			out << " # ";
+		out << std::setfill('0') << std::setw(2) << (uint32_t)memory[k]
+		    << " ";
 	}
 
-	std::cout << std::dec << std::endl << std::endl;
+	out << std::dec << std::endl << std::endl;
+}
+
+static inline uint64_t rotl64(uint64_t value, int shift) {
+	return (value << shift) | (value >> (64 - shift));
 }
 
+uint64_t hashPage(const uint8_t *data, size_t len) {
+	const uint64_t prime1 = 0x9e3779b185ebca87ULL;
+	const uint64_t prime2 = 0xc2b2ae3d27d4eb4fULL;
+
+	// Four independent lanes to keep the multipliers busy
+	uint64_t lanes[4] = {len + prime1, len ^ prime2, len, len - prime1};
+	uint64_t word;
+	size_t i = 0;
+
+	for (; i + 32 <= len; i += 32) {
+		for (int lane = 0; lane < 4; lane++) {
+			memcpy(&word, data + i + lane * 8, 8);
+			lanes[lane] = rotl64(lanes[lane] + word * prime2, 31) * prime1;
+		}
+	}
+
+	uint64_t hash = rotl64(lanes[0], 1) + rotl64(lanes[1], 7) +
+	                rotl64(lanes[2], 12) + rotl64(lanes[3], 18);
+
+	for (; i + 8 <= len; i += 8) {
+		memcpy(&word, data + i, 8);
+		hash = rotl64(hash ^ (word * prime2), 27) * prime1;
+	}
+	for (; i < len; i++) {
+		hash = rotl64(hash ^ (data[i] * prime1), 11) * prime2;
+	}
+
+	// Final avalanche
+	hash ^= hash >> 33;
+	hash *= prime2;
+	hash ^= hash >> 29;
+	hash *= prime1;
+	hash ^= hash >> 32;
+	return hash;
+}
+
+#define SIPROUND                                                        \
+	do {                                                                \
+		v0 += v1; v1 = rotl64(v1, 13); v1 ^= v0; v0 = rotl64(v0, 32);   \
+		v2 += v3; v3 = rotl64(v3, 16); v3 ^= v2;                        \
+		v0 += v3; v3 = rotl64(v3, 21); v3 ^= v0;                        \
+		v2 += v1; v1 = rotl64(v1, 17); v1 ^= v2; v2 = rotl64(v2, 32);   \
+	} while (0)
+
+namespace {
+
+struct HashKey {
+	uint64_t k0;
+	uint64_t k1;
+
+	HashKey() {
+		std::random_device random;
+		this->k0 = ((uint64_t)random() << 32) | random();
+		this->k1 = ((uint64_t)random() << 32) | random();
+	}
+};
+
+} // namespace
+
+uint64_t hashPageKeyed(const uint8_t *data, size_t len) {
+	static const HashKey key;
+
+	uint64_t v0 = key.k0 ^ 0x736f6d6570736575ULL;
+	uint64_t v1 = key.k1 ^ 0x646f72616e646f6dULL;
+	uint64_t v2 = key.k0 ^ 0x6c7967656e657261ULL;
+	uint64_t v3 = key.k1 ^ 0x7465646279746573ULL;
+	uint64_t word;
+	size_t i = 0;
+
+	for (; i + 8 <= len; i += 8) {
+		memcpy(&word, data + i, 8);
+		v3 ^= word;
+		SIPROUND;
+		SIPROUND;
+		v0 ^= word;
+	}
+
+	// The last block holds the remaining bytes and the length
+	uint64_t last = (uint64_t)len << 56;
+	for (size_t j = 0; i + j < len; j++) {
+		last |= (uint64_t)data[i + j] << (8 * j);
+	}
+	v3 ^= last;
+	SIPROUND;
+	SIPROUND;
+	v0 ^= last;
+
+	v2 ^= 0xff;
+	SIPROUND;
+	SIPROUND;
+	SIPROUND;
+	SIPROUND;
+	return v0 ^ v1 ^ v2 ^ v3;
+}
+
+#undef SIPROUND
 
 std::string findFileInDir(std::string dirName,
                           std::string fileName,
@@ -133,18 +237,18 @@ std::string findFileInDir(std::string dirName,
 	return "";
 }
 
+/**
+ * Capstone handles must not be shared between threads,
+ * so every thread gets its own disassembler instance.
+ */
 class Capstone {
 public:
 	static csh getHandle(){
-		if(!instance) {
-			instance = new Capstone();
-		}
-		return instance->handle;
+		static thread_local Capstone instance;
+		return instance.handle;
 	}
 
 private:
-	static Capstone *instance;
-
 	csh handle;
 
 	Capstone(){
@@ -157,7 +261,12 @@ private:
 
 };
 
-Capstone* Capstone::instance = nullptr;
+/** cs_disasm_iter that counts the decoded instructions */
+static inline bool decode(csh handle, const uint8_t **code, size_t *size,
+                          uint64_t *address, cs_insn *insn) {
+	Metrics::count(Metrics::DECODES);
+	return cs_disasm_iter(handle, code, size, address, insn);
+}
 
 std::tuple<size_t, bool, std::string>
 printInstructions(const uint8_t *ptr, uint32_t offset, uint64_t index){
@@ -170,7 +279,7 @@ printInstructions(const uint8_t *ptr, uint32_t offset, uint64_t index){
 	const uint8_t* code = ptr;
 	uint64_t cs_ptr = index;
 	size_t size = offset;
-	while(cs_disasm_iter(handle, &code, &size, &cs_ptr, insn)){
+	while(decode(handle, &code, &size, &cs_ptr, insn)){
 		nr_inst++;
 		ss << insn->mnemonic << "\t" << insn->op_str << std::endl;
 		if(strcmp(insn->mnemonic, "ret") == 0) break;
@@ -187,7 +296,7 @@ bool isIntendedInstruction(const uint8_t *ptr, uint32_t offset, uint64_t index)
 	const uint8_t* code = ptr;
 	uint64_t cs_ptr = index;
 	size_t size = offset + 10;
-	while(cs_disasm_iter(handle, &code, &size, &cs_ptr, insn) and code < ptr + offset);
+	while(decode(handle, &code, &size, &cs_ptr, insn) and code < ptr + offset);
 	cs_free(insn, 1);
 	return (code == ptr + offset);
 }
@@ -201,7 +310,7 @@ bool isValidInstruction(const uint8_t *ptr, uint32_t offset, uint64_t index) {
 	const uint8_t* code = ptr + offset;
 	uint64_t cs_ptr = index + offset;
 	size_t size = 10;
-	if (cs_disasm_iter(handle, &code, &size, &cs_ptr, insn)) {
+	if (decode(handle, &code, &size, &cs_ptr, insn)) {
 		ret = true;
 	}
 	cs_free(insn, 1);
@@ -209,6 +318,109 @@ bool isValidInstruction(const uint8_t *ptr, uint32_t offset, uint64_t index) {
 }
 
 
+void findBranches(const uint8_t *ptr, size_t size, uint64_t index,
+                  const std::function<void(uint64_t, uint8_t, uint64_t, bool)> &callback) {
+	csh handle = Capstone::getHandle();
+	cs_insn *insn = cs_malloc(handle);
+
+	const uint8_t *code = ptr;
+	uint64_t cs_ptr = index;
+	while (size > 0) {
+		if (!decode(handle, &code, &size, &cs_ptr, insn)) {
+			// Padding or data within the text, resync at the next byte
+			code++;
+			cs_ptr++;
+			size--;
+			continue;
+		}
+
+		bool call = strcmp(insn->mnemonic, "call")  == 0 ||
+		            strcmp(insn->mnemonic, "lcall") == 0;
+		if (!call && strcmp(insn->mnemonic, "jmp") != 0) {
+			continue;
+		}
+		// Indirect branches have a register or memory operand
+		uint64_t destination = 0;
+		if (insn->op_str[0] == '0' && insn->op_str[1] == 'x') {
+			destination = strtoull(insn->op_str + 2, NULL, 16);
+		}
+		callback(insn->address, insn->size, destination, call);
+	}
+	cs_free(insn, 1);
+}
+
+static inline bool isPrefix(uint8_t byte) {
+	switch (byte) {
+	case 0x26: case 0x2e: case 0x36: case 0x3e:
+	case 0x64: case 0x65: case 0x66: case 0x67:
+	case 0xf0: case 0xf2: case 0xf3:
+		return true;
+	default:
+		// REX
+		return (byte & 0xf0) == 0x40;
+	}
+}
+
+void findReturnSites(const uint8_t *ptr, size_t size, uint64_t index,
+                     const std::function<void(uint64_t, uint64_t)> &callback) {
+	csh handle = Capstone::getHandle();
+	cs_insn *insn = cs_malloc(handle);
+
+	// isReturnAddress() accepts a call of 2 to 7 bytes ending at the
+	// offset. Such a call starts with at most 6 prefixes followed by
+	// 0xe8, 0xff or 0x9a, only these starts are decoded.
+	std::vector<std::pair<uint64_t, uint64_t>> sites;
+	for (size_t start = 0; start + 2 <= size; start++) {
+		size_t opcode = start;
+		while (opcode < size && opcode - start < 6 && isPrefix(ptr[opcode])) {
+			opcode++;
+		}
+		if (opcode >= size ||
+		    (ptr[opcode] != 0xe8 && ptr[opcode] != 0xff && ptr[opcode] != 0x9a)) {
+			continue;
+		}
+
+		const uint8_t *code = ptr + start;
+		uint64_t cs_ptr = index + start;
+		size_t codeSize = std::min<size_t>(size - start, 20);
+		if (!decode(handle, &code, &codeSize, &cs_ptr, insn) ||
+		    insn->size < 2 || insn->size > 7 ||
+		    (strcmp(insn->mnemonic, "call")  != 0 &&
+		     strcmp(insn->mnemonic, "lcall") != 0)) {
+			continue;
+		}
+		uint64_t destination = 1;
+		if (insn->op_str[0] == '0' && insn->op_str[1] == 'x') {
+			destination = strtoull(insn->op_str + 2, NULL, 16);
+		}
+		sites.emplace_back(start + insn->size, destination);
+	}
+
+	// isReturnAddress() tries the shortest call first, that is the one
+	// with the highest start. The sort is stable, so it is the last
+	// entry of each offset.
+	std::stable_sort(sites.begin(), sites.end(),
+	                 [](const std::pair<uint64_t, uint64_t> &a,
+	                    const std::pair<uint64_t, uint64_t> &b) {
+		                 return a.first < b.first;
+	                 });
+	for (size_t i = 0; i < sites.size(); i++) {
+		uint64_t offset = sites[i].first;
+		if ((i + 1 < sites.size() && sites[i + 1].first == offset) ||
+		    offset >= size) {
+			continue;
+		}
+		// The return address itself has to be an instruction
+		const uint8_t *code = ptr + offset;
+		uint64_t cs_ptr = index + offset;
+		size_t codeSize = std::min<size_t>(size - offset, 10);
+		if (decode(handle, &code, &codeSize, &cs_ptr, insn)) {
+			callback(offset, sites[i].second);
+		}
+	}
+	cs_free(insn, 1);
+}
+
 uint64_t isReturnAddress(const uint8_t *ptr, uint32_t offset, uint64_t index,
                          VMIInstance * /*vmi*/, uint32_t /*pid*/) {
 	// List of return values:
@@ -218,12 +430,12 @@ uint64_t isReturnAddress(const uint8_t *ptr, uint32_t offset, uint64_t index,
 
 	uint64_t address = 0;
 
-	csh handle = Capstone::getHandle();
-	cs_insn *insn = cs_malloc(handle);
-
 	if(!isValidInstruction(ptr, offset, index))
 		return 0;
 
+	csh handle = Capstone::getHandle();
+	cs_insn *insn = cs_malloc(handle);
+
 	// TODO maybe a relative jump is expected
 	int i = 0;
 	for(i = 2; i < 8; i++){
@@ -232,12 +444,12 @@ uint64_t isReturnAddress(const uint8_t *ptr, uint32_t offset, uint64_t index,
 		uint64_t cs_ptr = index + offset - i;
 		size_t size = 20;
 
-		if (cs_disasm_iter(handle, &code, &size, &cs_ptr, insn) and
+		if (decode(handle, &code, &size, &cs_ptr, insn) and
 		    insn->size == i and
 		    (strcmp(insn->mnemonic, "call")  == 0 ||
 		     strcmp(insn->mnemonic, "lcall") == 0)) {
 			if (insn->op_str[0] == '0' and insn->op_str[1] == 'x'){
-				address = (uint64_t)strtol(insn->op_str + 2, NULL, 16);;
+				address = strtoull(insn->op_str + 2, NULL, 16);
 			} else {
 				address = 1;
 			}
@@ -68,7 +68,21 @@ void printHexDump(const std::vector<uint8_t> *bytes);
 void displayChange(const uint8_t *memory,
                    const uint8_t *reference,
                    int32_t offset,
-                   int32_t size);
+                   int32_t size,
+                   std::ostream &out=std::cout);
+
+/**
+ * Fast non-cryptographic 64 bit hash of a memory block.
+ * Used to recognize unchanged guest pages, not to detect manipulations.
+ */
+uint64_t hashPage(const uint8_t *data, size_t len);
+
+/**
+ * SipHash-2-4 of a memory block with a secret key drawn at startup.
+ * The guest cannot predict the key, so unlike hashPage() it cannot
+ * craft modified pages with the value of a known good one.
+ */
+uint64_t hashPageKeyed(const uint8_t *data, size_t len);
 
 std::string findFileInDir(std::string dirName,
                           std::string fileName,
@@ -82,6 +96,23 @@ bool isValidInstruction(const uint8_t *ptr, uint32_t offset, uint64_t index);
 uint64_t isReturnAddress(const uint8_t *ptr, uint32_t offset, uint64_t index,
                          VMIInstance *vmi=nullptr, uint32_t pid=0);
 
+/**
+ * Disassemble size bytes of code linearly, index is the address of ptr.
+ * For every call and jmp the callback gets the address and size of the
+ * instruction, its destination (0 if indirect) and whether it is a call.
+ * Undecodable bytes are skipped.
+ */
+void findBranches(const uint8_t *ptr, size_t size, uint64_t index,
+                  const std::function<void(uint64_t, uint8_t, uint64_t, bool)> &callback);
+
+/**
+ * Report every offset in ptr for which isReturnAddress() is not 0, in
+ * ascending order, together with its result. Each possible call is
+ * decoded once instead of decoding backwards from every offset.
+ */
+void findReturnSites(const uint8_t *ptr, size_t size, uint64_t index,
+                     const std::function<void(uint64_t, uint64_t)> &callback);
+
 inline std::vector<std::string> &split(const std::string &s, char delim, std::vector<std::string> &elems) {
 	std::stringstream ss(s);
 	std::string item;
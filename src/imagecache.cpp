@@ -0,0 +1,287 @@
+#include "imagecache.h"
+
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <type_traits>
+#include <unistd.h>
+#include <vector>
+
+#include "elfkernelspaceloader.h"
+#include "helpers.h"
+
+namespace kernint {
+
+static const char imageMagic[8] = {'K', 'I', 'I', 'M', 'A', 'G', 'E', 'S'};
+
+static_assert(std::is_trivially_copyable<ElfKernelspaceLoader::PatchSite>::value,
+              "patch sites are stored as they are");
+
+ImageCache::ImageCache(const std::string &fileName, const std::string &key,
+                       const std::string &layout)
+	:
+	fileName{fileName},
+	key{key},
+	layout{layout} {}
+
+std::string ImageCache::path(const std::string &cacheDir,
+                             const std::string &name,
+                             const std::string &buildID) {
+	std::string fileName = cacheDir + "/" + name;
+	if (!buildID.empty()) {
+		fileName += "-" + buildID;
+	}
+	return fileName + ".kernint-cache";
+}
+
+namespace {
+
+/** Collects the arrays of the file behind the header */
+class ArrayWriter {
+public:
+	ArrayWriter(ImageCache::Header *header) : header{header} {}
+
+	template <typename T>
+	void add(ImageCache::ArrayType type, const T *data, size_t count) {
+		// All arrays start 8 byte aligned
+		this->content.resize((this->content.size() + 7) & ~(size_t)7);
+		this->header->arrays[type].offset =
+			sizeof(ImageCache::Header) + this->content.size();
+		this->header->arrays[type].size = count * sizeof(T);
+		this->content.append((const char *)data, count * sizeof(T));
+	}
+
+	template <typename T>
+	void add(ImageCache::ArrayType type, const std::vector<T> &data) {
+		this->add(type, data.data(), data.size());
+	}
+
+	std::string content;
+
+private:
+	ImageCache::Header *header;
+};
+
+/** Checked access to the arrays of a mapped file */
+class ArrayReader {
+public:
+	ArrayReader(const uint8_t *base, size_t size)
+		:
+		base{base},
+		size{size},
+		header{(const ImageCache::Header *)base} {}
+
+	/** Element count of the array, false if it is out of bounds */
+	template <typename T>
+	bool get(ImageCache::ArrayType type, const T **data, size_t *count) const {
+		const ImageCache::Array &array = this->header->arrays[type];
+		if (array.offset % 8 != 0 || array.offset > this->size ||
+		    array.size > this->size - array.offset ||
+		    array.size % sizeof(T) != 0) {
+			return false;
+		}
+		*data  = (const T *)(this->base + array.offset);
+		*count = array.size / sizeof(T);
+		return true;
+	}
+
+	template <typename T>
+	bool get(ImageCache::ArrayType type, std::vector<T> *out) const {
+		const T *data;
+		size_t count;
+		if (!this->get(type, &data, &count)) {
+			return false;
+		}
+		out->assign(data, data + count);
+		return true;
+	}
+
+	template <typename T>
+	bool get(ImageCache::ArrayType type, std::set<T> *out) const {
+		const T *data;
+		size_t count;
+		if (!this->get(type, &data, &count)) {
+			return false;
+		}
+		// Stored in order, each insert is at the end
+		out->clear();
+		for (size_t i = 0; i < count; i++) {
+			out->insert(out->end(), data[i]);
+		}
+		return true;
+	}
+
+private:
+	const uint8_t *base;
+	size_t size;
+	const ImageCache::Header *header;
+};
+
+} // namespace
+
+void ImageCache::clearImage(ElfKernelspaceLoader *loader) {
+	loader->textSegmentContent.clear();
+	loader->dataSegmentContent.clear();
+	loader->roData.clear();
+	loader->jumpTable.clear();
+	loader->jumpEntries.clear();
+	loader->jumpDestinations.clear();
+	loader->smpOffsets.clear();
+	loader->patchSites.clear();
+}
+
+bool ImageCache::load(ElfKernelspaceLoader *loader) const {
+	int fd = open(this->fileName.c_str(), O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+
+	struct stat fileStat;
+	if (fstat(fd, &fileStat) != 0 ||
+	    (size_t)fileStat.st_size < sizeof(Header)) {
+		close(fd);
+		return false;
+	}
+
+	size_t size = fileStat.st_size;
+	void *data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED) {
+		return false;
+	}
+
+	const Header *header = (const Header *)data;
+	if (memcmp(header->magic, imageMagic, sizeof(header->magic)) != 0 ||
+	    header->version != version ||
+	    header->keyLength != this->key.size() ||
+	    memcmp(header->key, this->key.data(), this->key.size()) != 0) {
+		munmap(data, size);
+		return false;
+	}
+
+	ArrayReader reader{(const uint8_t *)data, size};
+	const char *layout;
+	size_t layoutSize;
+	if (!reader.get(LAYOUT, &layout, &layoutSize) ||
+	    layoutSize != this->layout.size() ||
+	    memcmp(layout, this->layout.data(), layoutSize) != 0) {
+		munmap(data, size);
+		return false;
+	}
+
+	const JumpEntry *jumpEntries;
+	size_t jumpEntryCount;
+	const uint8_t *symbolTable;
+	size_t symbolTableSize;
+	bool valid =
+		reader.get(TEXT, &loader->textSegmentContent) &&
+		reader.get(DATA, &loader->dataSegmentContent) &&
+		reader.get(RODATA, &loader->roData) &&
+		reader.get(JUMP_TABLE, &loader->jumpTable) &&
+		reader.get(JUMP_ENTRIES, &jumpEntries, &jumpEntryCount) &&
+		reader.get(JUMP_DESTINATIONS, &loader->jumpDestinations) &&
+		reader.get(SMP_OFFSETS, &loader->smpOffsets) &&
+		reader.get(PATCH_SITES, &loader->patchSites) &&
+		reader.get(PATCH_SITE_PAGES, &loader->patchSitePages) &&
+		reader.get(PATCH_SITE_MASK, &loader->patchSiteMask) &&
+		reader.get(RETURN_SITE_MASK, &loader->returnSiteMask) &&
+		reader.get(RETURN_SITE_RANK, &loader->returnSiteRank) &&
+		reader.get(RETURN_SITE_CALLS, &loader->returnSiteCalls) &&
+		reader.get(SYMBOL_TABLE, &symbolTable, &symbolTableSize);
+
+	// The symbols of a module are resolved in place by the relocation,
+	// addSymbolsToStore() reads them from there
+	const SectionInfo *symtab = nullptr;
+	if (valid && loader->elffile->isRelocatable()) {
+		symtab = &loader->elffile->findSectionWithName(".symtab");
+		valid  = symtab->size == symbolTableSize;
+	}
+
+	if (valid) {
+		loader->jumpEntries.clear();
+		for (size_t i = 0; i < jumpEntryCount; i++) {
+			loader->jumpEntries.emplace_hint(loader->jumpEntries.end(),
+			                                 jumpEntries[i].code,
+			                                 jumpEntries[i].destination);
+		}
+		if (symtab) {
+			memcpy(symtab->index, symbolTable, symbolTableSize);
+		}
+		loader->computeTextDigests();
+	} else {
+		std::cout << COLOR_RED << "Invalid image cache: " << this->fileName
+		          << COLOR_NORM << std::endl;
+		// The image is built from scratch, which appends to some arrays
+		clearImage(loader);
+	}
+	munmap(data, size);
+	return valid;
+}
+
+bool ImageCache::store(const ElfKernelspaceLoader *loader) const {
+	Header header;
+	memset(&header, 0, sizeof(header));
+	if (this->key.size() > sizeof(header.key)) {
+		return false;
+	}
+	memcpy(header.magic, imageMagic, sizeof(header.magic));
+	header.version   = version;
+	header.keyLength = this->key.size();
+	memcpy(header.key, this->key.data(), this->key.size());
+
+	std::vector<JumpEntry> jumpEntries;
+	jumpEntries.reserve(loader->jumpEntries.size());
+	for (auto &&entry : loader->jumpEntries) {
+		jumpEntries.push_back({entry.first, entry.second, 0});
+	}
+	std::vector<uint64_t> jumpDestinations(loader->jumpDestinations.begin(),
+	                                       loader->jumpDestinations.end());
+	std::vector<uint64_t> smpOffsets(loader->smpOffsets.begin(),
+	                                 loader->smpOffsets.end());
+
+	ArrayWriter writer{&header};
+	writer.add(TEXT, loader->textSegmentContent);
+	writer.add(DATA, loader->dataSegmentContent);
+	writer.add(RODATA, loader->roData);
+	writer.add(JUMP_TABLE, loader->jumpTable);
+	writer.add(JUMP_ENTRIES, jumpEntries);
+	writer.add(JUMP_DESTINATIONS, jumpDestinations);
+	writer.add(SMP_OFFSETS, smpOffsets);
+	writer.add(PATCH_SITES, loader->patchSites);
+	writer.add(PATCH_SITE_PAGES, loader->patchSitePages);
+	writer.add(PATCH_SITE_MASK, loader->patchSiteMask);
+	writer.add(RETURN_SITE_MASK, loader->returnSiteMask);
+	writer.add(RETURN_SITE_RANK, loader->returnSiteRank);
+	writer.add(RETURN_SITE_CALLS, loader->returnSiteCalls);
+
+	std::vector<uint8_t> symbolTable;
+	if (loader->elffile->isRelocatable()) {
+		const SectionInfo &symtab = loader->elffile->findSectionWithName(".symtab");
+		symbolTable.assign(symtab.index, symtab.index + symtab.size);
+	}
+	writer.add(SYMBOL_TABLE, symbolTable);
+	writer.add(LAYOUT, this->layout.data(), this->layout.size());
+
+	// Write to a temporary file first, so that concurrent readers never
+	// see a partially written image.
+	std::string tmpFile = this->fileName + ".tmp";
+	std::ofstream outfile(tmpFile, std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!outfile.is_open()) {
+		return false;
+	}
+	outfile.write((const char *)&header, sizeof(header));
+	outfile.write(writer.content.data(), writer.content.size());
+	outfile.close();
+
+	if (!outfile || rename(tmpFile.c_str(), this->fileName.c_str()) != 0) {
+		unlink(tmpFile.c_str());
+		return false;
+	}
+	return true;
+}
+
+} // namespace kernint
@@ -0,0 +1,107 @@
+#ifndef KERNINT_IMAGECACHE_H_
+#define KERNINT_IMAGECACHE_H_
+
+#include <cstdint>
+#include <string>
+
+namespace kernint {
+
+class ElfKernelspaceLoader;
+
+/**
+ * On-disk copy of the patched reference image of a kernel or module,
+ * so the patching and the derived tables are only computed once.
+ *
+ * The file starts with a Header, followed by the arrays it points to,
+ * each aligned to 8 bytes:
+ *
+ *   text, data and rodata images, the jump table
+ *   jump entries (code, destination), jump destinations, smp offsets
+ *   patch sites and their page index and byte mask
+ *   return site mask, rank and calls
+ *   the relocated .symtab of modules, empty for the kernel
+ *   the layout of the loaded module, empty for the kernel
+ *
+ * The key and the layout identify everything the image depends on,
+ * both are compared in full. A file with a different key, layout or
+ * version is ignored and replaced. The text digests are keyed per run
+ * and thus recomputed after loading.
+ *
+ * The files are kept in a cache directory apart from the reference
+ * kernel and modules, see path().
+ */
+class ImageCache {
+public:
+	static const uint32_t version = 4;
+
+	enum ArrayType : uint32_t {
+		TEXT,
+		DATA,
+		RODATA,
+		JUMP_TABLE,
+		JUMP_ENTRIES,
+		JUMP_DESTINATIONS,
+		SMP_OFFSETS,
+		PATCH_SITES,
+		PATCH_SITE_PAGES,
+		PATCH_SITE_MASK,
+		RETURN_SITE_MASK,
+		RETURN_SITE_RANK,
+		RETURN_SITE_CALLS,
+		SYMBOL_TABLE,
+		LAYOUT,
+		ARRAY_COUNT
+	};
+
+	struct Array {
+		uint64_t offset;
+		/** In bytes */
+		uint64_t size;
+	};
+
+	struct Header {
+		char magic[8];
+		uint32_t version;
+		uint32_t keyLength;
+		char key[256];
+		Array arrays[ARRAY_COUNT];
+	};
+
+	/** Element of the JUMP_ENTRIES array */
+	struct JumpEntry {
+		uint64_t code;
+		int32_t destination;
+		uint32_t padding;
+	};
+
+	ImageCache(const std::string &fileName, const std::string &key,
+	           const std::string &layout="");
+
+	/** File of the image name with buildID in cacheDir */
+	static std::string path(const std::string &cacheDir,
+	                        const std::string &name,
+	                        const std::string &buildID);
+
+	/**
+	 * Restore the image of loader from the file. Returns false if it
+	 * does not exist, is invalid or belongs to another key.
+	 */
+	bool load(ElfKernelspaceLoader *loader) const;
+
+	/** Write the image of loader to the file */
+	bool store(const ElfKernelspaceLoader *loader) const;
+
+	const std::string &getFileName() const { return this->fileName; }
+
+private:
+	/** Reset what a partial load() may have filled */
+	static void clearImage(ElfKernelspaceLoader *loader);
+
+	std::string fileName;
+	std::string key;
+	std::string layout;
+};
+
+} // namespace kernint
+
+#endif
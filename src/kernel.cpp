@@ -10,11 +10,16 @@
 #include <iostream>
 #include <cctype>
 
+#include <fcntl.h>
 #include <regex>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <thread>
+#include <unistd.h>
 
 #include "elffile.h"
 
+#include "elfmoduleloader.h"
 #include "elfuserspaceloader.h"
 
 #include "libdwarfparser/variable.h"
@@ -25,6 +30,7 @@ namespace kernint {
 
 Kernel::Kernel()
 	:
+	vmi{nullptr},
 	paravirt{this},
 	tm{this} {}
 
@@ -37,6 +43,10 @@ void Kernel::setKernelDir(const std::string &dirName) {
 	this->kernelDirName = dirName;
 }
 
+void Kernel::setCacheDir(const std::string &dirName) {
+	this->cacheDirName = dirName;
+}
+
 TaskManager *Kernel::getTaskManager() {
 	return &this->tm;
 }
@@ -83,6 +93,17 @@ ElfModuleLoader *Kernel::loadModule(const std::string &moduleNameOrig) {
 	return module;
 }
 
+std::vector<ElfKernelspaceLoader *> Kernel::getLoadedModules() {
+	std::vector<ElfKernelspaceLoader *> modules;
+	std::lock_guard<std::mutex> lock(this->moduleMapMutex);
+	for (auto &modulePair : this->moduleMap) {
+		if (modulePair.second) {
+			modules.push_back(modulePair.second);
+		}
+	}
+	return modules;
+}
+
 void Kernel::loadModuleThread(std::list<std::string> &modList,
                                      std::mutex &modMutex) {
 	while (true) {
@@ -183,28 +204,129 @@ void Kernel::loadKernelModules() {
 	}
 }
 
+namespace {
+
+/** A line of System.map, name points into the mapped file */
+struct SysmapSymbol {
+	uint64_t address;
+	const char *name;
+	uint32_t nameLength;
+	char mode;
+};
+
+inline bool isBlank(char c) {
+	return c == ' ' || c == '\t' || c == '\r';
+}
+
+/**
+ * Parse the lines in [pos, end), which ends with a complete line.
+ * Lines of kallsyms have the module in brackets after the name, those
+ * symbols are skipped as they are read from the module files.
+ */
+void parseSysmapLines(const char *pos, const char *end,
+                      std::vector<SysmapSymbol> *symbols) {
+	while (pos < end) {
+		const char *lineEnd = (const char *)memchr(pos, '\n', end - pos);
+		if (!lineEnd) {
+			lineEnd = end;
+		}
+
+		uint64_t address = 0;
+		const char *digits = pos;
+		for (; pos < lineEnd; pos++) {
+			char c = *pos;
+			if (c >= '0' && c <= '9') {
+				address = (address << 4) | (c - '0');
+			} else if ((c | 0x20) >= 'a' && (c | 0x20) <= 'f') {
+				address = (address << 4) | ((c | 0x20) - 'a' + 10);
+			} else {
+				break;
+			}
+		}
+		bool valid = pos > digits;
+
+		while (pos < lineEnd && isBlank(*pos)) pos++;
+		char mode = pos < lineEnd ? *pos++ : '\0';
+		valid = valid && mode && pos < lineEnd && isBlank(*pos);
+
+		while (pos < lineEnd && isBlank(*pos)) pos++;
+		const char *name = pos;
+		while (pos < lineEnd && !isBlank(*pos)) pos++;
+		uint32_t nameLength = pos - name;
+
+		while (pos < lineEnd && isBlank(*pos)) pos++;
+		bool moduleSymbol = pos < lineEnd && *pos == '[';
+
+		if (valid && nameLength && !moduleSymbol) {
+			symbols->push_back({address, name, nameLength, mode});
+		}
+		pos = lineEnd + 1;
+	}
+}
+
+} // namespace
+
 void Kernel::parseSystemMap() {
 	std::string sysMapFileName = this->kernelDirName;
 	sysMapFileName.append("/System.map");
-	std::string line;
-	std::ifstream sysMapFile(sysMapFileName);
-	if (sysMapFile.is_open()) {
-		while (sysMapFile.good()) {
-			uint64_t address;
-			char mode = '\0';
-			std::string varname;
-			std::getline(sysMapFile, line);
-			std::stringstream iss(line);
-			iss >> std::hex >> address >> mode >> varname;
-
-			this->symbols.addSysmapSymbol(varname, address, not std::isupper(mode));
+	if (!fexists(sysMapFileName) && fexists(this->kernelDirName + "/kallsyms")) {
+		sysMapFileName = this->kernelDirName + "/kallsyms";
+	}
+
+	int fd = open(sysMapFileName.c_str(), O_RDONLY);
+	struct stat fileStat;
+	if (fd < 0 || fstat(fd, &fileStat) != 0) {
+		if (fd >= 0) {
+			close(fd);
 		}
-		sysMapFile.close();
-	} else {
 		std::cout << "Unable to open systemmap file at '"
 		          << sysMapFileName << "'" << std::endl;
 		return;
 	}
+
+	size_t size = fileStat.st_size;
+	void *data = size ? mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0)
+	                  : MAP_FAILED;
+	close(fd);
+	if (data == MAP_FAILED) {
+		return;
+	}
+	const char *content = (const char *)data;
+
+	// Chunks of at least 1 MiB, each starting at the beginning of a line
+	const size_t minChunkSize = 1 << 20;
+	size_t chunkCount = std::max<size_t>(1, std::min<size_t>(
+		std::thread::hardware_concurrency(), size / minChunkSize));
+	std::vector<const char *> bounds{content};
+	for (size_t i = 1; i < chunkCount; i++) {
+		const char *start = std::max(bounds.back(), content + i * size / chunkCount);
+		const char *lineEnd = (const char *)memchr(start, '\n',
+		                                           content + size - start);
+		bounds.push_back(lineEnd ? lineEnd + 1 : content + size);
+	}
+	bounds.push_back(content + size);
+
+	std::vector<std::vector<SysmapSymbol>> chunks(chunkCount);
+	std::vector<std::thread> threads;
+	for (size_t i = 1; i < chunkCount; i++) {
+		threads.emplace_back(parseSysmapLines, bounds[i], bounds[i + 1],
+		                     &chunks[i]);
+	}
+	parseSysmapLines(bounds[0], bounds[1], &chunks[0]);
+	for (auto &&thread : threads) {
+		thread.join();
+	}
+
+	// The SymbolManager is not thread safe, insert in file order
+	std::string name;
+	for (auto &&chunk : chunks) {
+		for (auto &&symbol : chunk) {
+			name.assign(symbol.name, symbol.nameLength);
+			this->symbols.addSysmapSymbol(name, symbol.address,
+			                              not std::isupper(symbol.mode));
+		}
+	}
+	munmap(data, size);
 }
 
 
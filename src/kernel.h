@@ -25,6 +25,11 @@ public:
 	virtual ~Kernel() = default;
 
 	void setKernelDir(const std::string &dirName);
+	const std::string &getKernelDir() const { return this->kernelDirName; }
+
+	/** Directory of the image caches, none are used if it is empty */
+	void setCacheDir(const std::string &dirName);
+	const std::string &getCacheDir() const { return this->cacheDirName; }
 
 	void setVMIInstance(VMIInstance *vmi);
 
@@ -36,6 +41,13 @@ public:
 	void loadModuleThread(std::list<std::string> &modList,
 	                      std::mutex &modMutex);
 	ElfModuleLoader *loadModule(const std::string &moduleName);
+	/** All modules loaded so far */
+	std::vector<ElfKernelspaceLoader *> getLoadedModules();
+	/**
+	 * Add the symbols of <kernelDir>/System.map, or of a copy of the
+	 * guest's /proc/kallsyms in <kernelDir>/kallsyms if there is no
+	 * System.map.
+	 */
 	void parseSystemMap();
 
 	ParavirtState *getParavirtState();
@@ -60,6 +72,7 @@ protected:
 
 private:
 	std::string kernelDirName;
+	std::string cacheDirName;
 
 	typedef std::unordered_map<std::string, Instance> ModuleInstanceMap;
 	ModuleInstanceMap moduleInstanceMap;
@@ -1,6 +1,7 @@
 #include "kernelvalidator.h"
 
 #include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <chrono>
 #include <fstream>
@@ -10,6 +11,7 @@
 #include <memory>
 #include <cstdio>
 #include <cstdlib>
+#include <thread>
 #include <unistd.h>
 #include <unordered_map>
 
@@ -18,56 +20,113 @@
 #include "elfmoduleloader.h"
 #include "helpers.h"
 #include "kernel_headers.h"
+#include "metrics.h"
+#include "ptrscanner.h"
+#include "reporter.h"
+#include "simd.h"
+#include "vmitrace.h"
 
 namespace kernint {
 
-KernelValidator::KernelValidator(ElfKernelLoader *kernelLoader,
-                                 const std::string &targetsFile)
+/** Pages validatePageList() hands out to a worker at once */
+static const size_t chunkSize = 64;
+
+KernelValidator::KernelValidator(ElfKernelLoader *kernelLoader)
 	:
 	kernelLoader(kernelLoader),
-	stackAddresses() {
-
-	this->kernelLoader->loadAllModules();
-	this->kernelLoader->symbols.updateRevMaps();
-
-	if (targetsFile.length() > 0) {
-		// Read targets of calls
-		std::ifstream infile;
-		infile.open(targetsFile, std::ios::in|std::ios::binary);
-		uint64_t callAddr;
-		uint64_t callDest;
-
-		while (!infile.eof()) {
-			infile.read((char*)&callAddr, sizeof(callAddr));
-			if (infile.eof()) break;
-			infile.read((char*)&callDest, sizeof(callDest));
-
-			this->callTargets.insert(
-				std::pair<uint64_t,uint64_t>(callAddr, callDest));
-		}
-		infile.close();
+	stackAddresses(),
+	chunkPages{nullptr},
+	chunkCount{0},
+	nextChunk{0} {
+
+	// Without a guest only the kernel itself is validated
+	if (this->kernelLoader->vmi) {
+		ScopedTimer timer{Metrics::LOADING};
+		this->kernelLoader->loadAllModules();
 	}
+	this->kernelLoader->updateAddressIndex();
+	this->kernelLoader->symbols.updateRevMaps();
 
 	this->setOptions();
+	this->setThreadCount(1);
+	this->setIncremental(false);
+	this->setRateLimit(0, 0);
 }
 
 KernelValidator::~KernelValidator() {}
 
+bool KernelValidator::loadCallTargets(const std::string &targetsFile) {
+	return this->callTargets.load(targetsFile,
+	                              this->kernelLoader->elffile->getBuildID());
+}
+
 void KernelValidator::setOptions(bool lm, bool cv, bool pe){
 	this->options.loopMode = lm;
 	this->options.codeValidation = cv;
 	this->options.pointerExamination = pe;
 }
 
-ElfKernelLoader *KernelValidator::loadKernel(const std::string &dirName) {
+void KernelValidator::setThreadCount(uint32_t threads) {
+	if (threads == 0) {
+		threads = std::thread::hardware_concurrency();
+	}
+	this->options.threadCount = std::max(threads, 1U);
+
+	// One pool per worker, kept across iterations
+	// The batches of the workers return their buffers to the pools
+	this->pageWorkers.resize(this->options.threadCount);
+	this->bufferPools.resize(this->options.threadCount);
+	for (uint32_t i = 0; i < this->options.threadCount; i++) {
+		if (!this->bufferPools[i]) {
+			this->bufferPools[i].reset(new BufferPool());
+		}
+		if (!this->pageWorkers[i]) {
+			this->pageWorkers[i].reset(
+				new PageWorker(this->bufferPools[i].get()));
+		}
+	}
+	this->workers.resize(this->options.threadCount);
+}
+
+void KernelValidator::setIncremental(bool incremental) {
+	this->options.incremental = incremental;
+	this->pageFingerprints.clear();
+}
+
+void KernelValidator::setRateLimit(uint32_t maxPagesPerSec,
+                                   uint32_t budgetMsPerSec) {
+	this->options.maxPagesPerSec = maxPagesPerSec;
+	this->options.budgetMsPerSec = std::min<uint32_t>(budgetMsPerSec, 1000);
+}
+
+bool KernelValidator::setTiers(uint32_t intervalMs, const std::string &tierFile) {
+	return this->scheduler.assignTiers(this->kernelLoader, intervalMs,
+	                                   tierFile);
+}
+
+void KernelValidator::setSampling(uint32_t window, uint64_t seed) {
+	this->scheduler.setSampling(window, seed);
+}
+
+void KernelValidator::setMetricsFile(const std::string &prefix) {
+	this->metricsFile = prefix;
+}
+
+ElfKernelLoader *KernelValidator::loadKernel(const std::string &dirName,
+                                             bool dwarfSnapshot,
+                                             const std::string &cacheDir) {
+	ScopedTimer timer{Metrics::LOADING};
+
 	std::string kernelName = dirName;
 	kernelName.append("/vmlinux");
 
 	ElfFile *kernelFile = ElfFile::loadElfFile(kernelName);
 
-	ElfKernelLoader *kernelLoader = kernelFile->parseKernel();
+	ElfKernelLoader *kernelLoader = kernelFile->parseKernel(
+		dwarfSnapshot ? kernelName + ".kernint-dwarf" : "");
 
 	kernelLoader->setKernelDir(dirName);
+	kernelLoader->setCacheDir(cacheDir);
 	kernelLoader->parseSystemMap();
 	kernelLoader->initImage();
 
@@ -79,73 +138,390 @@ uint64_t KernelValidator::validatePages() {
 
 	do {
 		iterations++;
+		const auto iterationStart = std::chrono::steady_clock::now();
 
 		globalCodePtrs = 0;
 		if (this->options.pointerExamination) {
+			ScopedTimer timer{Metrics::VALIDATION};
+
 			//Validate all Stacks
 			this->updateStackAddresses();
+			PageBatch stacks{this->bufferPools[0].get()};
 			for (auto &stack : this->stackAddresses) {
-				std::vector<uint8_t> pageInMem = this->kernelLoader->vmi->readVectorFromVA(stack.first, 0x2000);
-				this->validateStackPage(pageInMem.data(),
+				stacks.add(stack.first, 0x2000);
+			}
+			this->readBatch(stacks);
+			for (auto &stack : this->stackAddresses) {
+				uint8_t *stackInMem = stacks.get(stack.first, 0x2000);
+				if (!stackInMem) {
+					Metrics::count(Metrics::UNREADABLE_PAGES, 2);
+					continue;
+				}
+				this->validateStackPage(stackInMem,
 				                        stack.first,
 				                        stack.second);
 			}
 		}
 
-		PageMap executablePageMap = this->kernelLoader->vmi->getPages(0);
+		PageMap executablePageMap = VMITrace::get().getPages(this->kernelLoader->vmi, 0);
+
+		std::vector<page_info_t *> pages = this->sortPages(executablePageMap);
+		const size_t pageCount = pages.size();
+		this->scheduler.sample(pages);
+
+		const auto coverageStart = std::chrono::steady_clock::now();
+		uint64_t skippedPages;
+		uint64_t validatedPages = pages.size();
+		if (this->options.maxPagesPerSec || this->options.budgetMsPerSec ||
+		    this->scheduler.isTiered()) {
+			skippedPages = this->validatePageSlices(executablePageMap, pages,
+			                                        &validatedPages);
+		} else {
+			skippedPages = this->validatePageList(pages);
+		}
+		const double coverageTime = std::chrono::duration<double>(
+			std::chrono::steady_clock::now() - coverageStart).count();
+		const double pageRate = coverageTime > 0 ? validatedPages / coverageTime : 0;
+		// A sample window needs that many iterations for all pages
+		const uint32_t window = std::max(this->scheduler.getSampleWindow(), 1U);
+		Metrics::set(Metrics::COVERAGE_SECONDS, coverageTime * window);
+		Metrics::set(Metrics::PAGE_RATE, pageRate);
+
+		if (this->options.incremental) {
+			report() << "Skipped " << skippedPages << " of " << validatedPages
+			         << " unchanged pages" << std::endl;
+		}
+		if (this->options.maxPagesPerSec || this->options.budgetMsPerSec) {
+			report() << "Validated " << validatedPages << " pages in "
+			         << coverageTime << " s ("
+			         << (uint64_t)pageRate
+			         << " pages/s)" << std::endl;
+		}
+		// Missed right after the check, found when the page is due again
+		const double latency = std::chrono::duration<double>(
+			std::chrono::steady_clock::now() - iterationStart).count() *
+			window;
+		Metrics::set(Metrics::DETECTION_LATENCY_SECONDS, latency);
+		if (window > 1) {
+			report() << "Sampled " << pages.size() << " of " << pageCount
+			         << " pages, every page is validated once in " << window
+			         << " iterations. Modifications are found within "
+			         << window << " iterations (about "
+			         << (uint64_t)latency << " s)" << std::endl;
+		}
+		if (this->scheduler.isTiered()) {
+			report() << "Validated "
+			         << this->scheduler.getPageCount(PageScheduler::CRITICAL)
+			         << " critical pages "
+			         << this->scheduler.getCriticalRounds()
+			         << " times so far" << std::endl;
+		}
 
-		for (auto &page : executablePageMap) {
-			if ((page.second->vaddr & 0xff0000000000) == 0x8800000000000){
-				continue;
-			}
-			this->validatePage(page.second);
+		if (globalCodePtrs) {
+			report() << COLOR_GREEN << "Still " << globalCodePtrs
+			         << " unidentified changes" << COLOR_NORM << std::endl;
 		}
 
-		std::cout << COLOR_GREEN << COLOR_BOLD
-		          << "Done validating pages"
-		          << COLOR_BOLD_OFF << COLOR_NORM << std::endl;
+		report() << COLOR_GREEN << COLOR_BOLD
+		         << "Done validating pages"
+		         << COLOR_BOLD_OFF << COLOR_NORM << std::endl;
+		Reporter::get().flush();
+		Metrics::write(this->metricsFile);
+		VMITrace::get().flush();
 
-		this->kernelLoader->vmi->destroyMap(executablePageMap);
+		VMITrace::get().destroyMap(this->kernelLoader->vmi,
+		                           executablePageMap);
 	} while (this->options.loopMode);
 
 	return iterations;
 }
 
 
-void KernelValidator::validatePage(page_info_t * page) {
+size_t KernelValidator::readVA(uint64_t address, uint64_t len, uint8_t *buffer) {
+	std::lock_guard<std::mutex> lock(this->vmiMutex);
+	size_t size = VMITrace::get().readVA(this->kernelLoader->vmi, address,
+	                                     len, buffer);
+	Metrics::count(Metrics::VMI_READS);
+	Metrics::count(Metrics::VMI_BYTES, size);
+	return size;
+}
+
+std::vector<page_info_t *> KernelValidator::sortPages(const PageMap &map) const {
+	std::vector<page_info_t *> pages;
+	pages.reserve(map.size());
+	for (auto &page : map) {
+		if ((page.second->vaddr & 0xff0000000000) == 0x8800000000000){
+			continue;
+		}
+		pages.push_back(page.second);
+	}
+	// Neighbouring pages end up in the same chunk and are read together
+	std::sort(pages.begin(), pages.end(),
+	          [](const page_info_t *a, const page_info_t *b) {
+		          return a->vaddr < b->vaddr;
+	          });
+	return pages;
+}
+
+void KernelValidator::readBatch(PageBatch &batch) {
+	batch.read([this](uint64_t address, uint64_t len, uint8_t *buffer) {
+		return this->readVA(address, len, buffer);
+	});
+}
+
+uint64_t KernelValidator::validatePageSlices(PageMap &map,
+                                             std::vector<page_info_t *> &pages,
+                                             uint64_t *validatedPages) {
+	// A slice gives every worker one chunk of validatePageList
+	const size_t sliceSize = chunkSize * this->options.threadCount;
+	const auto tick = std::chrono::seconds(1);
+	const auto budget = std::chrono::milliseconds(this->options.budgetMsPerSec);
+	const bool limited = this->options.maxPagesPerSec ||
+	                     this->options.budgetMsPerSec;
+	uint64_t skippedPages = 0;
+	std::vector<page_info_t *> slice;
+
+	*validatedPages = 0;
+	this->scheduler.start(pages);
+
+	bool done = false;
+	bool slept = false;
+	while (!done) {
+		const auto tickStart = std::chrono::steady_clock::now();
+		// The guest may have changed its mappings in the meantime
+		if (slept) {
+			PageMap current = VMITrace::get().getPages(this->kernelLoader->vmi, 0);
+			pages = this->sortPages(current);
+			this->scheduler.refresh(pages);
+			VMITrace::get().destroyMap(this->kernelLoader->vmi, map);
+			map = std::move(current);
+		}
+		size_t tickPages = 0;
+		while (true) {
+			// Stopped with setOptions(false, false, false), e.g. by SIGINT
+			if (!this->options.codeValidation &&
+			    !this->options.pointerExamination) {
+				return skippedPages;
+			}
+
+			size_t count = sliceSize;
+			if (this->options.maxPagesPerSec) {
+				count = std::min<size_t>(count, this->options.maxPagesPerSec -
+				                                tickPages);
+			}
+			if (!this->scheduler.next(count, &slice)) {
+				done = true;
+				break;
+			}
+			skippedPages    += this->validatePageList(slice);
+			tickPages       += slice.size();
+			*validatedPages += slice.size();
+
+			// The critical pages may exceed the page limit
+			if ((this->options.maxPagesPerSec &&
+			     tickPages >= this->options.maxPagesPerSec) ||
+			    (this->options.budgetMsPerSec &&
+			     std::chrono::steady_clock::now() - tickStart >= budget)) {
+				break;
+			}
+		}
+
+		// The rest of the second belongs to the guest, except for the
+		// critical pages whose interval may be shorter than a tick
+		if (!done && limited) {
+			const auto tickEnd = tickStart + tick;
+			while (this->scheduler.getCriticalDeadline() < tickEnd) {
+				std::this_thread::sleep_until(
+					this->scheduler.getCriticalDeadline());
+				if (!this->options.codeValidation &&
+				    !this->options.pointerExamination) {
+					return skippedPages;
+				}
+				if (this->scheduler.nextCritical(&slice)) {
+					skippedPages    += this->validatePageList(slice);
+					*validatedPages += slice.size();
+				}
+			}
+			std::this_thread::sleep_until(tickEnd);
+			slept = true;
+		}
+	}
+
+	return skippedPages;
+}
+
+uint64_t KernelValidator::validatePageList(const std::vector<page_info_t *> &pages) {
+	ScopedTimer timer{Metrics::VALIDATION};
+
+	// Pages are handed out to the workers in chunks. Each chunk collects
+	// its own output, which is printed in page order after all workers
+	// are done. Thus the result does not depend on the thread count.
+	// The workers, their batches and the chunk results are kept across
+	// calls, so a steady validation loop does not allocate.
+	this->chunkPages = &pages;
+	this->chunkCount = (pages.size() + chunkSize - 1) / chunkSize;
+	this->nextChunk  = 0;
+	if (this->chunkResults.size() < this->chunkCount) {
+		this->chunkResults.resize(this->chunkCount);
+	}
+
+	const WorkerPool::Job job = [this](uint32_t id) {
+		this->validateChunks(id);
+	};
+	this->workers.run(job, std::min<size_t>(this->options.threadCount,
+	                                        this->chunkCount));
+	this->chunkPages = nullptr;
+
+	uint64_t skippedPages = 0;
+	for (size_t chunk = 0; chunk < this->chunkCount; chunk++) {
+		ValidationContext &result = this->chunkResults[chunk];
+		emit(result.findings);
+		globalCodePtrs += result.codePtrs;
+		skippedPages += result.skippedPages;
+
+		for (auto &&clean : result.cleanPages) {
+			this->pageFingerprints[clean.first] = clean.second;
+		}
+		for (auto &&dirty : result.dirtyPages) {
+			this->pageFingerprints.erase(dirty);
+		}
+		result.clear();
+	}
+
+	return skippedPages;
+}
+
+void KernelValidator::validateChunks(uint32_t worker) {
+	const std::vector<page_info_t *> &pages = *this->chunkPages;
+	PageBatch &batch = this->pageWorkers[worker]->batch;
+	auto &targets    = this->pageWorkers[worker]->targets;
+
+	size_t chunk;
+	while ((chunk = this->nextChunk++) < this->chunkCount) {
+		size_t begin = chunk * chunkSize;
+		size_t end   = std::min(pages.size(), (chunk + 1) * chunkSize);
+		ValidationContext &result = this->chunkResults[chunk];
+
+		// Read all pages of the chunk that need validation at once
+		batch.clear();
+		targets.assign(end - begin, {nullptr, false});
+		for (size_t i = begin; i < end; i++) {
+			auto &target = targets[i - begin];
+			target.first = this->classifyPage(pages[i], &target.second,
+			                                  result);
+			if (target.first) {
+				batch.add(pages[i]->vaddr, pages[i]->size);
+			}
+		}
+		this->readBatch(batch);
+
+		for (size_t i = begin; i < end; i++) {
+			auto &target = targets[i - begin];
+			if (!target.first) {
+				continue;
+			}
+			uint8_t *pageInMem = batch.get(pages[i]->vaddr, pages[i]->size);
+			if (!pageInMem) {
+				// E.g. unmapped since the page map was taken, a guest
+				// could also try to hide a page this way
+				std::stringstream msg;
+				msg << "Could not read page: " << std::hex
+				    << pages[i]->vaddr;
+				Metrics::count(Metrics::UNREADABLE_PAGES);
+				result.add(Finding::Kind::UNREADABLE_PAGE,
+				           Finding::Severity::WARNING,
+				           pages[i]->vaddr, 0,
+				           target.first->getName(), msg.str());
+				continue;
+			}
+			this->validatePage(pages[i], target.first, target.second,
+			                   pageInMem, result);
+		}
+	}
+	// The buffers go back to the pool, the next call reuses them
+	batch.clear();
+}
+
+ElfKernelspaceLoader *KernelValidator::classifyPage(page_info_t *page,
+                                                    bool *codePage,
+                                                    ValidationContext &ctx) {
 	//std::cout << "Try to verify page: " << std::hex <<
 	//             page->vaddr << std::dec << std::endl;
 
 	if ((page->vaddr & 0xff0000000000) == 0xc900000000000){
 		// TODO investigate, what are these c9 addresses
-		return;
+		return nullptr;
 	}
 
-	ElfKernelspaceLoader *module = kernelLoader->getModuleForAddress(page->vaddr);
+	ElfKernelLoader::AddressKind kind;
+	ElfKernelspaceLoader *module = kernelLoader->getModuleForAddress(page->vaddr, &kind);
 	//assert(module);
+	*codePage = false;
 	if (!module) {
-		if(this->kernelLoader->vmi->isPageExecutable(page)){
-			std::cout << COLOR_MARGENTA << COLOR_BOLD <<
-			"No Module found for address: " << std::hex <<
-			page->vaddr << std::dec << COLOR_RESET << std::endl;
+		if(VMITrace::get().isPageExecutable(this->kernelLoader->vmi, page)){
+			std::stringstream msg;
+			msg << "No Module found for address: " << std::hex << page->vaddr;
+			ctx.add(Finding::Kind::NO_MODULE, Finding::Severity::WARNING,
+			        page->vaddr, 0, "", msg.str());
 		}
+		return nullptr;
 	} else if (this->options.codeValidation &&
-	           module->isCodeAddress(page->vaddr)) {
-		this->validateCodePage(page, module);
+	           kind == ElfKernelLoader::AddressKind::CODE) {
+		*codePage = true;
 	}
 	else if (this->options.pointerExamination &&
-	         module->isDataAddress(page->vaddr)) {
-		if (this->kernelLoader->vmi->isPageExecutable(page)) {
-			static bool execData = false;
-			if (!execData) {
-				std::cout << COLOR_RED << COLOR_BOLD <<
-				"Warning: Executable Data Page" <<
-				COLOR_NORM << COLOR_BOLD_OFF << std::endl;
-				execData = true;
+	         kind == ElfKernelLoader::AddressKind::DATA) {
+		if (VMITrace::get().isPageExecutable(this->kernelLoader->vmi, page)) {
+			static std::atomic<bool> execData{false};
+			if (!execData.exchange(true)) {
+				ctx.add(Finding::Kind::EXECUTABLE_DATA, Finding::Severity::ALERT,
+				        page->vaddr, 0, module->getName(),
+				        "Warning: Executable Data Page");
 			}
 		}
+	} else {
+		return nullptr;
+	}
+	return module;
+}
+
+void KernelValidator::validatePage(page_info_t *page,
+                                   ElfKernelspaceLoader *module,
+                                   bool codePage,
+                                   uint8_t *pageInMem,
+                                   ValidationContext &ctx) {
+	// In incremental mode pages that did not change since their last
+	// clean validation are skipped. The fingerprint is keyed, so the
+	// guest cannot hide a change behind a colliding page.
+	uint64_t fingerprint = 0;
+	bool cacheable = this->options.incremental;
+	if (cacheable) {
+		fingerprint = hashPageKeyed(pageInMem, page->size);
+		auto known = this->pageFingerprints.find(page->vaddr);
+		if (known != this->pageFingerprints.end() &&
+		    known->second == fingerprint) {
+			ctx.skippedPages++;
+			Metrics::count(Metrics::SKIPPED_PAGES);
+			return;
+		}
+	}
+
+	bool clean;
+	if (codePage) {
+		Metrics::count(Metrics::CODE_PAGES);
+		clean = this->validateCodePage(page, module, pageInMem, ctx,
+		                               cacheable ? &fingerprint : nullptr);
+	} else {
+		clean = this->validateDataPage(page, module, pageInMem, ctx);
+	}
 
-		this->validateDataPage(page, module);
+	if (!cacheable) {
+		return;
+	}
+	if (clean) {
+		ctx.cleanPages.emplace_back(page->vaddr, fingerprint);
+	} else {
+		ctx.dirtyPages.push_back(page->vaddr);
 	}
 }
 
@@ -164,48 +540,42 @@ void KernelValidator::validateStackPage(uint8_t* memory,
 	// Reset unused part of Stack to Zero
 	// TODO
 
-	// Go through every byte and check if it contains a kernel pointer
-	for (int32_t i = stackEnd % 0x2000; i < 0x2000 - 4; i++) {
-
-		// TODO!! warning: cast from 'uint8_t *' (aka 'unsigned char *') to 'uint32_t *' (aka 'unsigned int *') increases required alignment from 1 to 4
-		uint32_t* intPtr = (uint32_t*)(memory + i);
-
-		// Check if this could be a valid kernel address.
-		if (*intPtr != (uint32_t)0xffffffff)
-			continue;
+	// Check every value that could be a valid kernel address
+	static const PointerScanner scanner{PointerScanner::kernelImageMask};
+	// Reused by all pages of the thread
+	static thread_local std::vector<uint32_t> candidates;
+	candidates.clear();
+	scanner.scan(memory, stackEnd % 0x2000, 0x2000, &candidates);
+	Metrics::count(Metrics::STACK_PAGES);
+	Metrics::count(Metrics::POINTER_CANDIDATES, candidates.size());
 
-		// TODO!! warning: cast from 'uint32_t *' (aka 'unsigned int *') to 'uint64_t *' (aka 'unsigned long *') increases required alignment from 4 to 8
-		// The first 4 byte could belong to a kernel address.
-		uint64_t* longPtr = (uint64_t*)(intPtr - 1);
-		if (*longPtr == (uint64_t)0xffffffffffffffffL) {
-			i += 8;
-			continue;
-		}
+	for (uint32_t i : candidates) {
+		uint64_t value = PointerScanner::read(memory, i);
 
-		ElfKernelspaceLoader *elfloader = kernelLoader->getModuleForAddress(*longPtr);
-		if (!elfloader || !elfloader->isCodeAddress(*longPtr)) {
+		ElfKernelspaceLoader *elfloader = kernelLoader->getModuleForCodeAddress(value);
+		if (!elfloader) {
 			continue;
 		}
 
-		if (kernelLoader->symbols.isFunction(*longPtr))
+		if (kernelLoader->symbols.isFunction(value))
 			continue;
 
-		if (kernelLoader->symbols.isSymbol(*longPtr))
+		if (kernelLoader->symbols.isSymbol(value))
 			continue;
 
-		uint64_t offset = *longPtr - elfloader->textSegment.memindex;
+		uint64_t offset = value - elfloader->textSegment.memindex;
 
 		if (offset > elfloader->getTextSegment().size()) {
 			stackInteresting = true;
 			ss << std::hex << COLOR_RED << COLOR_BOLD
-			   << "Found possible malicious pointer: 0x" << *longPtr
-			   << " ( @ 0x" << i - 4 + stackBottom << " )"
+			   << "Found possible malicious pointer: 0x" << value
+			   << " ( @ 0x" << i + stackBottom << " )"
 			   << " Pointing to code after initialized content" << COLOR_NORM
 			   << COLOR_BOLD_OFF << std::dec << std::endl;
 			continue;
 		}
 
-		returnAddresses[i - 4 + stackBottom] = *longPtr;
+		returnAddresses[i + stackBottom] = value;
 	}
 
 	uint64_t oldRetFunc = 0;
@@ -217,13 +587,7 @@ void KernelValidator::validateStackPage(uint8_t* memory,
 		// Return Address (Stack)
 		uint64_t offset = retAddr.second - elfloader->textSegment.memindex;
 
-		std::vector<uint8_t> pageInMem = this->kernelLoader->vmi->readVectorFromVA(
-			elfloader->textSegment.memindex, offset + 0x40);
-
-		uint64_t callAddr = isReturnAddress(elfloader->textSegmentContent.data(),
-		                         offset,
-		                         elfloader->textSegment.memindex,
-		                         this->kernelLoader->vmi);
+		uint64_t callAddr = elfloader->isReturnAddress(offset);
 
 		if (!callAddr) {
 			stackInteresting = true;
@@ -277,27 +641,11 @@ void KernelValidator::validateStackPage(uint8_t* memory,
 		//	continue;
 		//}
 
-		if (this->callTargets.size() > 0) {
-			auto call = (this->callTargets.upper_bound(retAddr.second)--);
-
-			while (call->first > retAddr.second) {
-				call--;
-			}
-			uint64_t addressOfCall = call->first;
-			auto boundaries        = this->callTargets.equal_range(addressOfCall);
-			bool found             = false;
-
-			for (auto& element = boundaries.first; element != boundaries.second;
-			     element++) {
-				if (element->second == oldRetFunc) {
-					oldRetFunc     = retFunc;
-					oldRetFuncName = retFuncName;
-					found          = true;
-					break;
-				}
-			}
-			if (found)
-				continue;
+		if (!this->callTargets.empty() &&
+		    this->callTargets.hasTarget(retAddr.second, oldRetFunc)) {
+			oldRetFunc     = retFunc;
+			oldRetFuncName = retFuncName;
+			continue;
 		}
 
 		stackInteresting = true;
@@ -324,31 +672,11 @@ void KernelValidator::validateStackPage(uint8_t* memory,
 	}
 }
 
-bool KernelValidator::isValidJmpLabel(uint8_t* pageInMem,
-                                      uint64_t codeAddress,
-                                      int32_t i,
-                                      ElfKernelspaceLoader* elf) {
-	auto entry = elf->jumpEntries.find(codeAddress);
-
-	if (entry != elf->jumpEntries.end()) {
-		// Check if the entry is currently disabled
-		if ((memcmp(pageInMem + i, this->kernelLoader->pvpatcher.pvstate->ideal_nops[5], 5) == 0 ||
-		     memcmp(pageInMem + i, this->kernelLoader->pvpatcher.pvstate->ideal_nops[9], 5) == 0)) {
-			return true;
-		}
-		// Otherwise check if the destination matches
-		int32_t jmpDestInt = 0;
-		memcpy(&jmpDestInt, pageInMem + i + 1, 4);
-
-		if (pageInMem[i] == (uint8_t)0xe9 && entry->second == jmpDestInt) {
-			return true;
-		}
-	}
-	return false;
-}
-
-void KernelValidator::validateCodePage(page_info_t *page,
-                                       ElfKernelspaceLoader *elf) {
+bool KernelValidator::validateCodePage(page_info_t *page,
+                                       ElfKernelspaceLoader *elf,
+                                       uint8_t *pageInMem,
+                                       ValidationContext &ctx,
+                                       const uint64_t *fingerprint) {
 	assert(page);
 	assert(elf);
 
@@ -370,16 +698,37 @@ void KernelValidator::validateCodePage(page_info_t *page,
 		assert(false);
 	}
 	uint8_t* loadedPage = elf->textSegmentContent.data() + pageOffset;
-	// get Page from memdump
-	std::vector<uint8_t> pageInMem = this->kernelLoader->vmi->readVectorFromVA(page->vaddr, page->size);
+
+	// Fast path: compare against the precomputed reference digests and
+	// only fall back to the byte wise comparison on a mismatch. The
+	// digests are keyed, a guest cannot forge a matching page. The
+	// fingerprint of incremental mode is the digest of a single page.
+	const std::vector<uint64_t> &digests = elf->getTextDigests();
+	const uint32_t digestSize = ElfKernelspaceLoader::digestPageSize;
+	if (pageOffset % digestSize == 0 && page->size % digestSize == 0 &&
+	    (pageOffset + page->size) / digestSize <= digests.size()) {
+		bool intact = true;
+		for (int32_t sub = 0; sub < page->size && intact; sub += digestSize) {
+			uint64_t digest = fingerprint && page->size == digestSize ?
+			                  *fingerprint :
+			                  hashPageKeyed(pageInMem + sub, digestSize);
+			intact = digest == digests[(pageOffset + sub) / digestSize];
+		}
+		if (intact) {
+			return true;
+		}
+	}
 
 	uint32_t changeCount = 0;
+	ElfKernelLoader *kernelElf = dynamic_cast<ElfKernelLoader *>(elf);
 
-	for (int32_t i = 0; i < page->size; i++) {
-		if (loadedPage[i] == pageInMem[i]) {
-			continue;
-		}
+	// Only visit the offsets where the page differs from the reference
+	auto nextDiff = [&](int32_t from) -> int32_t {
+		return findFirstDifference(loadedPage, pageInMem,
+		                           std::max(from, 0), page->size);
+	};
 
+	for (int32_t i = nextDiff(0); i < page->size; i = nextDiff(i + 1)) {
 		// Show first changed byte only thus continue
 		// if last byte also is different
 		if (i > 0 && loadedPage[i - 1] != pageInMem[i - 1]) {
@@ -392,10 +741,21 @@ void KernelValidator::validateCodePage(page_info_t *page,
 			continue;
 		}
 
+		// Smp locks, jump labels and mcount sites recorded while patching
+		const ElfKernelspaceLoader::PatchSite *site =
+			elf->findPatchSite(pageOffset + i);
+		if (site && site->offset >= pageOffset &&
+		    site->offset + site->length <= pageOffset + page->size &&
+		    elf->isValidPatchSite(site, pageInMem +
+		                                (site->offset - pageOffset))) {
+			i = site->offset + site->length - pageOffset - 1;
+			continue;
+		}
+
 		// Check for ATOMIC_NOP
 		if (i > 1 && memcmp(loadedPage + i - 2,
 		                    this->kernelLoader->pvpatcher.pvstate->ideal_nops[5], 5) == 0 &&
-		    memcmp(pageInMem.data() + i - 2,
+		    memcmp(pageInMem + i - 2,
 		           this->kernelLoader->pvpatcher.pvstate->ideal_nops[9], 5) == 0) {
 			i += 5;
 			continue;
@@ -409,12 +769,7 @@ void KernelValidator::validateCodePage(page_info_t *page,
 		}
 
 		if (memcmp(loadedPage + i, "\x0f\x1f\x44\x00\x00", 5) == 0 &&
-		    memcmp(pageInMem.data() + i, "\x66\x66\x66\x66\x90", 5) == 0) {
-			i += 5;
-			continue;
-		}
-
-		if (isValidJmpLabel(pageInMem.data(), unkCodeAddress, i, elf)) {
+		    memcmp(pageInMem + i, "\x66\x66\x66\x66\x90", 5) == 0) {
 			i += 5;
 			continue;
 		}
@@ -426,15 +781,14 @@ void KernelValidator::validateCodePage(page_info_t *page,
 			uint64_t elfDestAddress = (uint64_t)elf->textSegment.memindex +
 			                          pageOffset + i + jmpDestElfInt + 5;
 
-			auto kernelLoader = dynamic_cast<ElfKernelLoader*>(elf);
-			if (kernelLoader) {
-				if (kernelLoader->genericUnrolledAddress == elfDestAddress) {
+			if (kernelElf) {
+				if (kernelElf->genericUnrolledAddress == elfDestAddress) {
 					i += 4;
 					continue;
 				}
-			} else if (dynamic_cast<ElfModuleLoader*>(elf)) {
+			} else {
 				uint32_t jmpDestMemInt = 0;
-				memcpy(&jmpDestMemInt, pageInMem.data() + i + 1, 4);
+				memcpy(&jmpDestMemInt, pageInMem + i + 1, 4);
 
 				// TODO Why is this commented out?
 				// uint64_t memDestAddress = (uint64_t)
@@ -454,55 +808,55 @@ void KernelValidator::validateCodePage(page_info_t *page,
 			}
 		}
 
-		// Handle smp locks
-		if ((loadedPage[i] == (uint8_t)0x3e && pageInMem[i] == (uint8_t)0xf0) ||
-		    (loadedPage[i] == (uint8_t)0xf0 && pageInMem[i] == (uint8_t)0x3e)) {
-			// TODO get smpOffsets
-			if (elf->smpOffsets.find(i + pageOffset) != elf->smpOffsets.end()) {
-				continue;
-			}
-		}
-
 		// TODO investigate
 		if (memcmp(loadedPage + i, "\xe9\x00\x00\x00\x00", 5) == 0 &&
-		    memcmp(pageInMem.data() + i, this->kernelLoader->pvpatcher.pvstate->ideal_nops[9], 5) == 0) {
+		    memcmp(pageInMem + i, this->kernelLoader->pvpatcher.pvstate->ideal_nops[9], 5) == 0) {
 			i += 5;
 			continue;
 		}
 
 		// check for uninitialized content after initialized
 		// part of kernels text segment
-		if (dynamic_cast<ElfKernelLoader *>(elf) &&
+		if (kernelElf &&
 		    i >= (int32_t) (elf->textSegmentContent.size() - pageOffset)) {
-			std::cout << COLOR_RED <<
-			             "Validating: " << elf->getName() <<
-			             " Page: " << std::hex << pageIndex
-			                       << std::dec << std::endl;
-			std::cout << "Unknown code @ " << std::hex << unkCodeAddress <<
-			             std::dec << COLOR_NORM << std::endl;
+			std::stringstream msg;
+			msg << "Validating: " << elf->getName()
+			    << " Page: " << std::hex << pageIndex
+			    << " Unknown code @ " << unkCodeAddress;
+			std::string detail;
 			if (changeCount == 0) {
-				std::cout << "The Code Segment is fully intact but " <<
-				             "the rest of the page is uninitialized" <<
-				             std::dec << std::endl << std::endl;
+				detail = "The Code Segment is fully intact but "
+				         "the rest of the page is uninitialized\n\n";
 			}
+			Metrics::count(Metrics::MISMATCHES);
+			ctx.add(Finding::Kind::UNKNOWN_CODE, Finding::Severity::ALERT,
+			        unkCodeAddress, pageIndex, elf->getName(), msg.str(),
+			        detail);
 
-			break;
+			return false;
 		}
 
-		std::cout << COLOR_RED << "Validating: " << elf->getName()
-		          << " Page: " << std::hex << pageIndex << std::dec
-		          << " Address: " << std::hex << unkCodeAddress << std::dec
-		          << COLOR_NORM << std::endl;
-		displayChange(pageInMem.data(), loadedPage, i, page->size);
+		std::stringstream msg;
+		msg << "Validating: " << elf->getName()
+		    << " Page: " << std::hex << pageIndex
+		    << " Address: " << unkCodeAddress;
+		std::stringstream detail;
+		displayChange(pageInMem, loadedPage, i, page->size, detail);
+		Metrics::count(Metrics::MISMATCHES);
+		ctx.add(Finding::Kind::CODE_CHANGE, Finding::Severity::ALERT,
+		        unkCodeAddress, pageIndex, elf->getName(), msg.str(),
+		        detail.str());
 		// exit(0);
 		changeCount++;
-		return;
+		return false;
 	}
 
 	if (changeCount > 0) {
-		std::cout << elf->getName() << " Section: " << pageIndex
-		          << " mismatch! " << changeCount << " inconsistent changes."
-		          << std::endl;
+		std::stringstream msg;
+		msg << elf->getName() << " Section: " << pageIndex
+		    << " mismatch! " << changeCount << " inconsistent changes.";
+		ctx.add(Finding::Kind::CODE_CHANGE, Finding::Severity::ALERT,
+		        page->vaddr, pageIndex, elf->getName(), msg.str());
 		// exit(0);
 	}
 	// const auto time2_stop = std::chrono::system_clock::now();
@@ -511,27 +865,28 @@ void KernelValidator::validateCodePage(page_info_t *page,
 	// const auto time2 = std::chrono::duration_cast<std::chrono::milliseconds>(time2_stop - time2_start).count();
 
 	// std::cout << "Needed " << time1 << " / " << time2 << " ms " << std::endl;
-	return;
-	// return changeCount;
+	return changeCount == 0;
 }
 
-void KernelValidator::validateDataPage(page_info_t* page, ElfKernelspaceLoader* elf) {
+bool KernelValidator::validateDataPage(page_info_t* page,
+                                       ElfKernelspaceLoader* elf,
+                                       uint8_t *pageInMem,
+                                       ValidationContext &ctx) {
 	assert(page);
 	assert(elf);
 
-	// get Page from memdump
-	std::vector<uint8_t> pageInMem = this->kernelLoader->vmi->readVectorFromVA(page->vaddr, page->size);
-
 	if (page->vaddr == (kernelLoader->idt_tableAddress & 0xffffffffffff) ||
 	    page->vaddr == (kernelLoader->nmi_idt_tableAddress & 0xffffffffffff)) {
 		// Verify IDT Table
 		// Verify nmi IDT Table
 		//
+		Metrics::count(Metrics::IDT_PAGES);
 
+		bool idtIntact     = true;
 		uint64_t idtPtr    = 0;
 		uint8_t* idtPtrPtr = (uint8_t*)&idtPtr;
 		for (uint32_t i = 0; i < page->size; i += 0x10) {
-			uint8_t* pagePtr = pageInMem.data() + i;
+			uint8_t* pagePtr = pageInMem + i;
 
 			// TODO: warning: cast from 'uint8_t *' (aka 'unsigned char *') to 'uint64_t *' (aka 'unsigned long *') increases required alignment from 1 to 8
 			idtPtr       = *((uint64_t*)(pagePtr + 4));
@@ -562,14 +917,18 @@ void KernelValidator::validateDataPage(page_info_t* page, ElfKernelspaceLoader*
 
 			// TODO:  warning: cast from 'uint8_t *' (aka 'unsigned char *') to 'uint32_t *' (aka 'unsigned int *') increases required alignment from 1 to 4
 			//        in ..(pagePtr + 12)..
-			std::cout << COLOR_RED << COLOR_BOLD << "Could not verify idt ptr "
-			          << std::hex << idtPtr << " @ " << page->vaddr + i
-			          << " Padding is: " << *((uint32_t*)(pagePtr + 12))
-			          << COLOR_BOLD_OFF << COLOR_NORM << std::dec << std::endl;
+			std::stringstream msg;
+			msg << "Could not verify idt ptr "
+			    << std::hex << idtPtr << " @ " << page->vaddr + i
+			    << " Padding is: " << *((uint32_t*)(pagePtr + 12));
+			Metrics::count(Metrics::MISMATCHES);
+			ctx.add(Finding::Kind::IDT_ENTRY, Finding::Severity::ALERT,
+			        page->vaddr + i, idtPtr, elf->getName(), msg.str());
+			idtIntact = false;
 
 			// stats.unknownPtrs++;
 		}
-		return;
+		return idtIntact;
 	}
 
 	uint8_t *loadedPage;
@@ -579,18 +938,21 @@ void KernelValidator::validateDataPage(page_info_t* page, ElfKernelspaceLoader*
 
 	if (page->vaddr >= roDataOffset &&
 	    page->vaddr < roDataOffset + elf->roDataSection.size) {
+		Metrics::count(Metrics::RODATA_PAGES);
 
 		loadedPage = elf->roData.data() + (page->vaddr - ((uint64_t)kernelLoader->roDataSection.memindex & 0xffffffffffff));
 
-		if (memcmp(pageInMem.data(), loadedPage, page->size) != 0) {
-			std::cout << COLOR_RED << "RoData Hash does not match @ "
-			          << std::hex << page->vaddr << std::dec << COLOR_NORM
-			          << std::endl;
+		if (memcmp(pageInMem, loadedPage, page->size) != 0) {
+			std::stringstream msg;
+			msg << "RoData Hash does not match @ " << std::hex << page->vaddr;
+			Metrics::count(Metrics::MISMATCHES);
+			ctx.add(Finding::Kind::RODATA_CHANGE, Finding::Severity::ALERT,
+			        page->vaddr, 0, elf->getName(), msg.str());
 			for (int32_t count = 0; count <= page->size; count++) {
 				if (loadedPage[count] != pageInMem[count]) {
 
 					// TODO:  warning: cast from 'unsigned char *' to 'uint64_t *' (aka 'unsigned long *') increases required alignment from 1 to 8
-					uint64_t currentPtr = (uint64_t)((uint64_t*)(pageInMem.data() + count))[0];
+					uint64_t currentPtr = (uint64_t)((uint64_t*)(pageInMem + count))[0];
 
 					// TODO this is not clean!
 					// kvm_guest_apic_eoi_write vs native_apic_mem_write
@@ -598,51 +960,73 @@ void KernelValidator::validateDataPage(page_info_t* page, ElfKernelspaceLoader*
 					//     kvm_guest_apic_eoi_write
 					if (kernelLoader->symbols.getFunctionAddress(
 						    "kvm_guest_apic_eoi_write") == currentPtr) {
-						std::cout << "Found pointer to kvm_guest_apic_eoi_write"
-						          << " ... skipping" << std::endl;
+						ctx.add(Finding::Kind::RODATA_CHANGE,
+						        Finding::Severity::INFO,
+						        page->vaddr + count, currentPtr, elf->getName(),
+						        "Found pointer to kvm_guest_apic_eoi_write"
+						        " ... skipping");
 						count += 7;
 						continue;
 					} else if (count + page->vaddr ==
 					           0xffff81aef000 /* 3. 8 */ ||
 					           count + page->vaddr ==
 					           0xffff817c6000 /* 3.16 */) {
-						std::cout << COLOR_RED << "Found pages that should be "
-						                          "zero @ ffffffff81aef000"
-						          << COLOR_NORM << std::endl;
-						return;
+						ctx.add(Finding::Kind::RODATA_CHANGE,
+						        Finding::Severity::ALERT,
+						        page->vaddr + count, 0, elf->getName(),
+						        "Found pages that should be "
+						        "zero @ ffffffff81aef000");
+						return false;
 					} else {
-						std::cout << COLOR_RED << "Could not find function @ "
-						          << std::hex << currentPtr << " ( "
-						          << count + page->vaddr << " ) " << std::dec
-						          << COLOR_NORM << std::endl;
+						std::stringstream msg;
+						msg << "Could not find function @ "
+						    << std::hex << currentPtr << " ( "
+						    << count + page->vaddr << " ) ";
+						std::stringstream detail;
+						displayChange(pageInMem, loadedPage, count, page->size,
+						              detail);
+						ctx.add(Finding::Kind::RODATA_CHANGE,
+						        Finding::Severity::ALERT,
+						        page->vaddr + count, currentPtr, elf->getName(),
+						        msg.str(), detail.str());
 					}
-					displayChange(pageInMem.data(), loadedPage, count, page->size);
 				}
 			}
+			return false;
 		}
-		return;
+		return true;
+	}
+
+	if (this->stackAddresses.find(page->vaddr & 0xffffffffe000) !=
+	    this->stackAddresses.end()) {
+		// This is a stack that will be evaluated separately. It may be
+		// reused as ordinary data later, so do not remember it as clean.
+		return false;
 	}
 
-	uint64_t codePtrs = this->findCodePtrs(page, pageInMem.data());
+	Metrics::count(Metrics::DATA_PAGES);
+	uint64_t codePtrs = this->findCodePtrs(page, pageInMem, ctx);
 	if (!codePtrs) {
-		return;
+		return true;
 	} else {
-		globalCodePtrs += codePtrs;
-		std::cout << COLOR_RED << COLOR_BOLD << "FOUND " << codePtrs
-		          << " undecidable ptrs to executable memory"
-		          << " in module " << elf->getName() << std::dec << COLOR_NORM
-		          << COLOR_BOLD_OFF << std::endl;
+		ctx.codePtrs += codePtrs;
 	}
 
-	std::cout << COLOR_GREEN << "Still " << globalCodePtrs
-	          << " unidentified changes" << COLOR_NORM << std::endl;
-
-	std::cout << COLOR_RED << "Still unprocessed data page @ " << std::hex
-	          << page->vaddr << " with size: " << page->size << std::dec
-	          << COLOR_NORM << std::endl;
+	std::stringstream msg;
+	msg << "FOUND " << codePtrs
+	    << " undecidable ptrs to executable memory"
+	    << " in module " << elf->getName();
+	std::stringstream detail;
+	detail << "Still unprocessed data page @ " << std::hex
+	       << page->vaddr << " with size: " << page->size << std::endl;
+	ctx.add(Finding::Kind::UNDECIDABLE_PAGE, Finding::Severity::ALERT,
+	        page->vaddr, codePtrs, elf->getName(), msg.str(), detail.str());
+	return false;
 }
 
-uint64_t KernelValidator::findCodePtrs(page_info_t* page, uint8_t* pageInMem) {
+uint64_t KernelValidator::findCodePtrs(page_info_t* page,
+                                       uint8_t* pageInMem,
+                                       ValidationContext &ctx) {
 	uint64_t codePtrs = 0;
 
 	SectionInfo exTable = kernelLoader->elffile->findSectionWithName("__ex_table");
@@ -653,110 +1037,104 @@ uint64_t KernelValidator::findCodePtrs(page_info_t* page, uint8_t* pageInMem) {
 		return 0;
 	}
 
-	// Go through every byte and check if it contains a kernel pointer
-	for (int32_t i = 4; i < page->size - 4; i++) {
-		// TODO: warning: cast from 'uint8_t *' (aka 'unsigned char *') to 'uint32_t *' (aka 'unsigned int *') increases required alignment from 1 to 4
-		uint32_t *intPtr = (uint32_t*)(pageInMem + i);
-
-		// Check if this could be a valid kernel address.
-		if (*intPtr == (uint32_t)0xffffffff) {
-			// The first 4 byte could belong to a kernel address.
-
-			// TODO: warning: cast from 'uint32_t *' (aka 'unsigned int *') to 'uint64_t *' (aka 'unsigned long *') increases required alignment from 4 to 8
-			uint64_t* longPtr = (uint64_t*)(intPtr - 1);
-			if (*longPtr == (uint64_t)0xffffffffffffffffL) {
-				i += 8;
-				continue;
-			}
-
-			if (*longPtr == (uint64_t)0xffffffff815237b0L) {
-				std::cout << "Found @ " << std::hex << " ( @ 0x"
-				          << i - 4 + page->vaddr << " )" << std::dec
-				          << std::endl;
-				exit(0);
-			}
-
-			if (kernelLoader->symbols.isFunction(*longPtr)) {
-				continue;
-			}
+	// Check every candidate that could be a valid kernel address
+	static const PointerScanner scanner{PointerScanner::kernelImageMask};
+	// Reused by all pages of the thread
+	static thread_local std::vector<uint32_t> candidates;
+	candidates.clear();
+	scanner.scan(pageInMem, 0, page->size, &candidates);
+	Metrics::count(Metrics::POINTER_CANDIDATES, candidates.size());
+
+	uint32_t skipUntil = 0;
+	for (uint32_t i : candidates) {
+		if (i < skipUntil) {
+			continue;
+		}
+		uint64_t value = PointerScanner::read(pageInMem, i);
 
-			if (kernelLoader->symbols.isSymbol(*longPtr)) {
-				// stats.symPtrs++;
-				continue;
-			}
+		if (kernelLoader->symbols.isFunction(value)) {
+			continue;
+		}
 
-			ElfKernelspaceLoader* elfloader = kernelLoader->getModuleForAddress(*longPtr);
-			if (!elfloader || !elfloader->isCodeAddress(*longPtr)) {
-				continue;
-			}
+		if (kernelLoader->symbols.isSymbol(value)) {
+			// stats.symPtrs++;
+			continue;
+		}
 
-			uint64_t offset = *longPtr - elfloader->textSegment.memindex;
+		ElfKernelspaceLoader* elfloader = kernelLoader->getModuleForCodeAddress(value);
+		if (!elfloader) {
+			continue;
+		}
 
-			if (offset > elfloader->textSegmentContent.size()) {
-				std::cout << std::hex << COLOR_RED << COLOR_BOLD
-				          << "Found possible malicious pointer: 0x" << *longPtr
-				          << " ( @ 0x" << i - 4 + page->vaddr << " )"
-				          << " Pointing to code after initialized content"
-				          << COLOR_NORM << COLOR_BOLD_OFF << std::dec
-				          << std::endl;
-				continue;
-			}
+		uint64_t offset = value - elfloader->textSegment.memindex;
 
-			if (elfloader->smpOffsets.find(offset) !=
-			    elfloader->smpOffsets.end()) {
-				continue;
-			}
+		if (offset > elfloader->textSegmentContent.size()) {
+			std::stringstream msg;
+			msg << std::hex
+			    << "Found possible malicious pointer: 0x" << value
+			    << " ( @ 0x" << i + page->vaddr << " )"
+			    << " Pointing to code after initialized content";
+			ctx.add(Finding::Kind::CODE_POINTER, Finding::Severity::ALERT,
+			        i + page->vaddr, value, elfloader->getName(), msg.str());
+			continue;
+		}
 
-			// Jump Instruction
-			if (elfloader->jumpEntries.find(*longPtr) !=
-			    elfloader->jumpEntries.end() ||
-			    elfloader->jumpDestinations.find(*longPtr) !=
-			    elfloader->jumpDestinations.end()) {
-				//stats.jumpEntry++;
-				continue;
-			}
+		if (elfloader->smpOffsets.find(offset) !=
+		    elfloader->smpOffsets.end()) {
+			continue;
+		}
 
-			// Exception Table
-			if (*longPtr > (uint64_t)exTable.memindex) {
-				//stats.exPtr++;
-				continue;
-			}
+		// Jump Instruction
+		if (elfloader->jumpEntries.find(value) !=
+		    elfloader->jumpEntries.end() ||
+		    elfloader->jumpDestinations.find(value) !=
+		    elfloader->jumpDestinations.end()) {
+			//stats.jumpEntry++;
+			continue;
+		}
 
-			// Return Address (Stack)
-			uint64_t callAddr =
-			isReturnAddress(elfloader->textSegmentContent.data(),
-			                offset, elfloader->textSegment.memindex,
-			                this->kernelLoader->vmi);
-			if (callAddr) {
-				std::cout << std::hex << COLOR_BLUE << COLOR_BOLD
-				          << "return address: 0x" << *longPtr << " ( @ 0x"
-				          << i - 4 + page->vaddr << " )" << COLOR_NORM
-				          << COLOR_BOLD_OFF << std::dec << std::endl;
-				continue;
-			}
+		// Exception Table
+		if (value > (uint64_t)exTable.memindex) {
+			//stats.exPtr++;
+			continue;
+		}
 
-			//if (*longPtr == 0xffffffff81412843) {
-			//	continue;
-			//}
+		// Return Address (Stack)
+		uint64_t callAddr = elfloader->isReturnAddress(offset);
+		if (callAddr) {
+			std::stringstream msg;
+			msg << std::hex << "return address: 0x" << value << " ( @ 0x"
+			    << i + page->vaddr << " )";
+			ctx.add(Finding::Kind::RETURN_ADDRESS, Finding::Severity::INFO,
+			        i + page->vaddr, value, elfloader->getName(), msg.str());
+			continue;
+		}
 
-			// Handle bp_int3_addr and bp_int3_handler
-			static uint64_t bp_int3_addr =
-			kernelLoader->symbols.getSymbolAddress("bp_int3_addr");
-			if ((page->vaddr + i - 4) == (bp_int3_addr & 0xffffffffffff)) {
-				i += 16;
-				continue;
-			}
+		//if (value == 0xffffffff81412843) {
+		//	continue;
+		//}
 
-			std::cout << std::hex << COLOR_RED << COLOR_BOLD
-			          << "Found possible malicious pointer: 0x" << *longPtr
-			          << " ( @ 0x" << i - 4 + page->vaddr << " )" << std::endl
-			          << " Pointing to module: " << elfloader->getName()
-			          << COLOR_NORM << COLOR_BOLD_OFF << std::dec << std::endl;
-			// stats.unknownPtrs++;
-			codePtrs++;
+		// Handle bp_int3_addr and bp_int3_handler
+		static uint64_t bp_int3_addr =
+		kernelLoader->symbols.getSymbolAddress("bp_int3_addr");
+		if ((page->vaddr + i) == (bp_int3_addr & 0xffffffffffff)) {
+			// bp_int3_handler follows
+			skipUntil = i + 16;
+			continue;
 		}
+
+		std::stringstream msg;
+		msg << std::hex
+		    << "Found possible malicious pointer: 0x" << value
+		    << " ( @ 0x" << i + page->vaddr << " )"
+		    << " Pointing to module: " << elfloader->getName();
+		ctx.add(Finding::Kind::CODE_POINTER, Finding::Severity::ALERT,
+		        i + page->vaddr, value, elfloader->getName(), msg.str());
+		// stats.unknownPtrs++;
+		codePtrs++;
 	}
 
+	Metrics::count(Metrics::POINTERS_UNDECIDABLE, codePtrs);
 	return codePtrs;
 }
 
@@ -1,12 +1,25 @@
 #ifndef KERNINT_KERNELVALIDATOR_H_
 #define KERNINT_KERNELVALIDATOR_H_
 
+#include <atomic>
 #include <cstdint>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include "libdwarfparser/libdwarfparser.h"
 #include "libvmiwrapper/libvmiwrapper.h"
 
+#include "calltargets.h"
+#include "findings.h"
+#include "pagebatch.h"
+#include "pagescheduler.h"
+#include "workerpool.h"
+
 
 namespace kernint {
 
@@ -15,44 +28,205 @@ class ElfKernelspaceLoader;
 
 class KernelValidator {
 public:
-	KernelValidator(ElfKernelLoader *kernelLoader,
-	                const std::string &targetsFile="");
+	KernelValidator(ElfKernelLoader *kernelLoader);
 	virtual ~KernelValidator();
 
+	/**
+	 * Load the call targets the return addresses on the stacks are
+	 * checked against. Returns false if the file is unusable, every
+	 * return address would be reported then.
+	 */
+	bool loadCallTargets(const std::string &targetsFile);
+
 	uint64_t validatePages();
-	void validatePage(page_info_t *page);
 	void setOptions(bool lm=false, bool cv=true, bool pe=true);
+	void setThreadCount(uint32_t threads);
+	void setIncremental(bool incremental);
+	/**
+	 * Spread each iteration over several seconds: validate at most
+	 * maxPagesPerSec pages and spend at most budgetMsPerSec ms per
+	 * second on it. 0 disables a limit.
+	 */
+	void setRateLimit(uint32_t maxPagesPerSec, uint32_t budgetMsPerSec);
+	/**
+	 * Validate the critical pages every intervalMs ms and rotate the
+	 * other tiers in between, see PageScheduler. Returns false if the
+	 * tier file can not be loaded.
+	 */
+	bool setTiers(uint32_t intervalMs, const std::string &tierFile="");
+	/**
+	 * Only validate a sample of the pages in each iteration, so that
+	 * every page is validated once per window iterations.
+	 */
+	void setSampling(uint32_t window, uint64_t seed);
+	/** Export the metrics to <prefix>.prom/.json after each iteration */
+	void setMetricsFile(const std::string &prefix);
 	ElfKernelLoader *getKernelLoader(){ return this->kernelLoader; }
 
-	static ElfKernelLoader *loadKernel(const std::string &dirName);
+	/**
+	 * Load <dirName>/vmlinux. With dwarfSnapshot the types are parsed
+	 * from the DwarfSnapshot <dirName>/vmlinux.kernint-dwarf. The
+	 * patched images are cached in cacheDir if it is not empty.
+	 */
+	static ElfKernelLoader *loadKernel(const std::string &dirName,
+	                                   bool dwarfSnapshot=false,
+	                                   const std::string &cacheDir="");
 
 private:
+	/** Runs the page validation on fixture data, see kernint-bench.cpp */
+	friend class KernelValidatorBench;
+	/** Drives validatePageList() on a replayed trace, see check-reads.cpp */
+	friend class KernelValidatorCheck;
+
+	/**
+	 * Results of validating one chunk of the page map.
+	 * A chunk is only ever processed by a single worker thread, so the
+	 * validation functions can write into it without any locking.
+	 */
+	struct ValidationContext {
+		/** Emitted in page order once all workers are done */
+		std::vector<Finding> findings;
+		uint64_t codePtrs = 0;
+		uint64_t skippedPages = 0;
+		/** Fingerprints of pages that validated cleanly */
+		std::vector<std::pair<uint64_t, uint64_t>> cleanPages;
+		/** Pages whose validation reported something */
+		std::vector<uint64_t> dirtyPages;
+
+		/** Reset for the next chunk, keeps the allocated memory */
+		void clear() {
+			this->findings.clear();
+			this->codePtrs     = 0;
+			this->skippedPages = 0;
+			this->cleanPages.clear();
+			this->dirtyPages.clear();
+		}
+
+		void add(Finding::Kind kind, Finding::Severity severity,
+		         uint64_t address, uint64_t value,
+		         const std::string &module, const std::string &message,
+		         const std::string &detail="") {
+			Finding finding{kind, severity};
+			finding.address = address;
+			finding.value   = value;
+			finding.module  = module;
+			finding.message = message;
+			finding.detail  = detail;
+			this->findings.push_back(std::move(finding));
+		}
+	};
+
 	struct {
 		bool loopMode;
 		bool codeValidation;
 		bool pointerExamination;
+		uint32_t threadCount;
+		bool incremental;
+		uint32_t maxPagesPerSec;
+		uint32_t budgetMsPerSec;
 	} options;
 
 	ElfKernelLoader *kernelLoader;
+	std::string metricsFile;
 	std::map<uint64_t, uint64_t> stackAddresses;
-	std::multimap<uint64_t, uint64_t> callTargets;
+	CallTargets callTargets;
 
 	uint64_t globalCodePtrs;
 
-	void validateCodePage(page_info_t *page, ElfKernelspaceLoader *elf);
-	bool isValidJmpLabel(uint8_t *pageInMem,
-	                     uint64_t codeAddress,
-	                     int32_t i,
-	                     ElfKernelspaceLoader *elf);
-
-	void validateDataPage(page_info_t *page, ElfKernelspaceLoader *elf);
+	/**
+	 * Incremental mode: fingerprint of the last clean validation result
+	 * of each page, keyed by vaddr. Only modified between iterations,
+	 * the page workers just read it.
+	 */
+	std::unordered_map<uint64_t, uint64_t> pageFingerprints;
+
+	/** Order of the pages in the rate limited and tiered modes */
+	PageScheduler scheduler;
+
+	/**
+	 * The VMI backend is not thread safe, all guest reads of the
+	 * page workers are serialized by this mutex.
+	 */
+	std::mutex vmiMutex;
+
+	/** Buffers of the batches, one pool per worker thread */
+	std::vector<std::unique_ptr<BufferPool>> bufferPools;
+
+	/** State of a worker of validatePageList, kept across calls */
+	struct PageWorker {
+		PageWorker(BufferPool *pool) : batch{pool} {}
+
+		PageBatch batch;
+		/** Image of each page of the chunk and whether it is code */
+		std::vector<std::pair<ElfKernelspaceLoader *, bool>> targets;
+	};
+	std::vector<std::unique_ptr<PageWorker>> pageWorkers;
+	WorkerPool workers;
+
+	/** The page list validatePageList() hands out in chunks */
+	const std::vector<page_info_t *> *chunkPages;
+	size_t chunkCount;
+	std::atomic<size_t> nextChunk;
+	/** Output of each chunk, only the first chunkCount are used */
+	std::vector<ValidationContext> chunkResults;
+
+	/** Read into buffer, returns the number of bytes read */
+	size_t readVA(uint64_t address, uint64_t len, uint8_t *buffer);
+	/** Read all ranges of the batch through readVA */
+	void readBatch(PageBatch &batch);
+	/** The pages of map that are validated, sorted by vaddr */
+	std::vector<page_info_t *> sortPages(const PageMap &map) const;
+
+	/** Returns the number of skipped unchanged pages */
+	uint64_t validatePageList(const std::vector<page_info_t *> &pages);
+	/** Validate chunks of validatePageList() until none is left */
+	void validateChunks(uint32_t worker);
+	/**
+	 * Validate pages in slices handed out by the scheduler, within the
+	 * rate limits. After each pause map and pages are replaced by the
+	 * current page map. The number of pages handed out, including the
+	 * repeated critical ones, is stored in validatedPages. Returns the
+	 * number of skipped unchanged pages.
+	 */
+	uint64_t validatePageSlices(PageMap &map,
+	                            std::vector<page_info_t *> &pages,
+	                            uint64_t *validatedPages);
+	/**
+	 * Find the image a page belongs to and whether it has to be
+	 * validated as code or data. nullptr if the page is not validated.
+	 */
+	ElfKernelspaceLoader *classifyPage(page_info_t *page,
+	                                   bool *codePage,
+	                                   ValidationContext &ctx);
+	void validatePage(page_info_t *page,
+	                  ElfKernelspaceLoader *module,
+	                  bool codePage,
+	                  uint8_t *pageInMem,
+	                  ValidationContext &ctx);
+
+	/**
+	 * fingerprint is the hashPageKeyed() of the whole page if it was
+	 * computed already, nullptr otherwise.
+	 */
+	bool validateCodePage(page_info_t *page,
+	                      ElfKernelspaceLoader *elf,
+	                      uint8_t *pageInMem,
+	                      ValidationContext &ctx,
+	                      const uint64_t *fingerprint=nullptr);
+
+	bool validateDataPage(page_info_t *page,
+	                      ElfKernelspaceLoader *elf,
+	                      uint8_t *pageInMem,
+	                      ValidationContext &ctx);
 	void validateStackPage(uint8_t *memory,
 	                       uint64_t stackBottom,
 	                       uint64_t stackEnd);
 
 	void updateStackAddresses();
 
-	uint64_t findCodePtrs(page_info_t *page, uint8_t *pageInMem);
+	uint64_t findCodePtrs(page_info_t *page,
+	                      uint8_t *pageInMem,
+	                      ValidationContext &ctx);
 };
 
 } // namespace kernint
@@ -0,0 +1,376 @@
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <getopt.h>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include "elfkernelloader.h"
+#include "guestfixture.h"
+#include "helpers.h"
+#include "kernelvalidator.h"
+#include "metrics.h"
+#include "process.h"
+#include "processvalidator.h"
+
+namespace kernint {
+
+/**
+ * Access to the private validation steps of KernelValidator.
+ * The findings of the pages are discarded.
+ */
+class KernelValidatorBench {
+public:
+	KernelValidatorBench(KernelValidator *validator)
+		:
+		validator{validator} {}
+
+	bool validateCodePage(page_info_t *page, uint8_t *pageInMem) {
+		KernelValidator::ValidationContext ctx;
+		return this->validator->validateCodePage(
+			page, this->validator->kernelLoader, pageInMem, ctx);
+	}
+
+	uint64_t findCodePtrs(page_info_t *page, uint8_t *pageInMem) {
+		KernelValidator::ValidationContext ctx;
+		return this->validator->findCodePtrs(page, pageInMem, ctx);
+	}
+
+private:
+	KernelValidator *validator;
+};
+
+} // namespace kernint
+
+using namespace kernint;
+
+const char *helpString = R"EOF(
+    Usage: %s [options]
+
+    Microbenchmarks of the validation and relocation hot loops.
+    The kernel benchmarks use the vmlinux of <kernelDir> as fixture
+    and run without a guest. Every benchmark is run <rounds> times,
+    the fastest round is reported.
+
+    Possible options are:
+
+    -h, --help
+        Display the help page.
+
+    -k, --kernel=<kernelDir>
+        Use the vmlinux and System.map in <kernelDir>.
+
+    -n, --rounds=<N>
+        Run every benchmark <N> times, the default is 3.
+
+    -g, --guest=<guest(File)>
+    -r, --root-path=<rootPath>
+    -p, --pid=<pid>
+        Also load and validate process <pid> of the guest to measure
+        the relocation of its libraries and the pointer classification.
+        These need a guest as the libraries are loaded like in the
+        guest process.
+
+    -F, --fixture=<image>
+        Run the process benchmarks on an image of kernint-fixture with
+        the libvmi file backend instead, no VM is needed. <image>.conf
+        has to be in the libvmi configuration, --root-path is the one
+        given to kernint-fixture. The default <pid> is the first
+        process of the image.
+)EOF";
+
+void displayHelp(const char *argv0) {
+	printf(helpString, argv0);
+}
+
+/** Nanoseconds of the fastest of rounds runs of bench */
+static uint64_t measure(uint32_t rounds, const std::function<void()> &bench) {
+	uint64_t best = UINT64_MAX;
+	for (uint32_t i = 0; i < rounds; i++) {
+		auto start = std::chrono::steady_clock::now();
+		bench();
+		auto stop = std::chrono::steady_clock::now();
+		uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+			stop - start).count();
+		best = std::min(best, ns);
+	}
+	return best;
+}
+
+static void printResult(const std::string &name, double value,
+                        const std::string &unit, uint64_t count) {
+	std::cout << std::left << std::setw(44) << name << std::right
+	          << std::fixed << std::setprecision(1) << std::setw(14)
+	          << value << " " << std::setw(12) << std::left << unit
+	          << std::right << " (" << count << ")" << std::endl;
+}
+
+int main(int argc, char **argv) {
+	std::cout << COLOR_RESET;
+
+	std::string kerndir;
+	std::string vmPath;
+	std::string rootDir;
+	uint32_t rounds = 3;
+	pid_t pid = 0;
+	int hypflag = VMI_AUTO;
+
+	int c;
+
+	opterr = 0;
+
+	int option_index                    = 0;
+	static struct option long_options[] = {
+		{"help", no_argument, 0, 'h'},
+		{"kernel", required_argument, 0, 'k'},
+		{"rounds", required_argument, 0, 'n'},
+		{"guest", required_argument, 0, 'g'},
+		{"root-path", required_argument, 0, 'r'},
+		{"pid", required_argument, 0, 'p'},
+		{"fixture", required_argument, 0, 'F'},
+		{0, 0, 0, 0}
+	};
+
+	while ((c = getopt_long(argc, argv, ":hk:n:g:r:p:F:", long_options, &option_index)) != -1) {
+		switch (c) {
+		case 'h':
+			displayHelp(argv[0]);
+			return 0;
+
+		case 'k':
+			kerndir.assign(optarg);
+			break;
+
+		case 'n':
+		case 'p': {
+			char *endptr;
+			errno = 0;
+			long value = strtol(optarg, &endptr, 10);
+			if (errno != 0 || endptr == optarg || *endptr != '\0' || value <= 0) {
+				std::cout << "Invalid value: " << optarg << std::endl;
+				return 1;
+			}
+			if (c == 'n') {
+				rounds = value;
+			} else {
+				pid = value;
+			}
+			break;
+		}
+
+		case 'g':
+			vmPath.assign(optarg);
+			break;
+
+		case 'F':
+			vmPath.assign(optarg);
+			hypflag = VMI_FILE;
+			break;
+
+		case 'r':
+			rootDir.assign(optarg);
+			break;
+
+		case '?':
+			if (isprint(optopt)) {
+				fprintf(stderr, "Unknown option `-%c'.\n", optopt);
+			}
+			else {
+				fprintf(stderr, "Unknown option character `\\x%x'.\n", optopt);
+			}
+
+		default:
+			displayHelp(argv[0]);
+			return 1;
+		}
+	}
+
+	if (kerndir.empty() || !fexists(kerndir)) {
+		std::cout << COLOR_RED << COLOR_BOLD
+		          << "Wrong Path given for Kernel Directory: " << kerndir
+		          << COLOR_RESET << std::endl;
+		return 1;
+	}
+
+	std::cout << COLOR_GREEN << "Loading Kernel" << COLOR_NORM << std::endl;
+	ElfKernelLoader *kl = KernelValidator::loadKernel(kerndir);
+
+	// No guest yet, so only the kernel is loaded
+	KernelValidator validator{kl};
+	KernelValidatorBench bench{&validator};
+
+	const uint32_t pageSize = 0x1000;
+	const std::vector<uint8_t> &text = kl->getTextSegment();
+	uint64_t textStart = (uint64_t)kl->textSegment.memindex & 0xffffffffffff;
+	size_t textPages = kl->textSegment.size / pageSize;
+
+	std::vector<page_info_t> pages(textPages);
+	for (size_t i = 0; i < textPages; i++) {
+		pages[i] = page_info_t{};
+		pages[i].vaddr = textStart + i * pageSize;
+		pages[i].size  = pageSize;
+	}
+
+	// Clean pages take the digest fast path
+	std::vector<uint8_t> image(text.begin(),
+	                           text.begin() +
+	                           textPages * pageSize);
+	uint64_t ns = measure(rounds, [&]() {
+		for (size_t i = 0; i < textPages; i++) {
+			bench.validateCodePage(&pages[i], image.data() + i * pageSize);
+		}
+	});
+	printResult("validateCodePage (clean)", (double)ns / textPages,
+	            "ns/page", textPages);
+
+	// A few scattered changes per page force the byte wise comparison
+	srand(0);
+	for (size_t i = 0; i < textPages; i++) {
+		for (int k = 0; k < 4; k++) {
+			image[i * pageSize + rand() % pageSize] ^= 0xff;
+		}
+	}
+	ns = measure(rounds, [&]() {
+		for (size_t i = 0; i < textPages; i++) {
+			bench.validateCodePage(&pages[i], image.data() + i * pageSize);
+		}
+	});
+	printResult("validateCodePage (scattered diffs)", (double)ns / textPages,
+	            "ns/page", textPages);
+
+	// The initialized .data of the kernel has the pointers of a live guest
+	const SectionInfo &data = kl->dataSection;
+	uint64_t dataStart = (uint64_t)data.memindex & 0xffffffffffff;
+	size_t dataPages = data.size / pageSize;
+	std::vector<page_info_t> dataPageInfo(dataPages);
+	for (size_t i = 0; i < dataPages; i++) {
+		dataPageInfo[i] = page_info_t{};
+		dataPageInfo[i].vaddr = dataStart + i * pageSize;
+		dataPageInfo[i].size  = pageSize;
+	}
+	uint64_t candidates = Metrics::collect().counters[Metrics::POINTER_CANDIDATES];
+	ns = measure(rounds, [&]() {
+		for (size_t i = 0; i < dataPages; i++) {
+			bench.findCodePtrs(&dataPageInfo[i], data.index + i * pageSize);
+		}
+	});
+	candidates = (Metrics::collect().counters[Metrics::POINTER_CANDIDATES] -
+	              candidates) / rounds;
+	printResult("findCodePtrs", (double)ns / std::max<size_t>(dataPages, 1),
+	            "ns/page", dataPages);
+	printResult("findCodePtrs", (double)ns / std::max<uint64_t>(candidates, 1),
+	            "ns/pointer", candidates);
+
+	// Instruction checks at every 61st byte of the kernel text
+	std::vector<uint32_t> offsets;
+	for (uint32_t offset = 16; offset < textPages * pageSize; offset += 61) {
+		offsets.push_back(offset);
+	}
+	auto instructionBench = [&](const char *name,
+	                            const std::function<void(uint32_t)> &check) {
+		uint64_t ns = measure(rounds, [&]() {
+			for (uint32_t offset : offsets) {
+				check(offset);
+			}
+		});
+		printResult(name, (double)ns / offsets.size(), "ns/call",
+		            offsets.size());
+	};
+	instructionBench("isValidInstruction", [&](uint32_t offset) {
+		isValidInstruction(text.data(), offset, textStart);
+	});
+	instructionBench("isReturnAddress", [&](uint32_t offset) {
+		isReturnAddress(text.data(), offset, textStart, nullptr, 0);
+	});
+	instructionBench("isReturnAddress (table)", [&](uint32_t offset) {
+		kl->isReturnAddress(offset);
+	});
+
+	// The table has to match the backward decoding, checked at every
+	// offset of the first pages and at the sampled ones
+	uint32_t checkEnd = std::min<uint32_t>(64 * pageSize, textPages * pageSize);
+	std::vector<uint32_t> checkOffsets = offsets;
+	for (uint32_t offset = 16; offset < checkEnd; offset++) {
+		checkOffsets.push_back(offset);
+	}
+	size_t mismatches = 0;
+	for (uint32_t offset : checkOffsets) {
+		uint64_t expected = isReturnAddress(text.data(), offset, textStart);
+		uint64_t result   = kl->isReturnAddress(offset);
+		if (expected != result && mismatches++ < 10) {
+			std::cout << COLOR_RED << "isReturnAddress mismatch at 0x"
+			          << std::hex << textStart + offset << ": 0x" << expected
+			          << " table 0x" << result << std::dec << COLOR_NORM
+			          << std::endl;
+		}
+	}
+	printResult("isReturnAddress mismatches", mismatches, "offsets",
+	            checkOffsets.size());
+	if (mismatches) {
+		return 1;
+	}
+	// Disassembles from the start of the page up to the offset
+	instructionBench("isIntendedInstruction", [&](uint32_t offset) {
+		uint32_t page = offset & ~(pageSize - 1);
+		isIntendedInstruction(text.data() + page, offset - page, textStart + page);
+	});
+
+	if (pid == 0 && hypflag == VMI_FILE) {
+		pid = GuestFixture::firstPid;
+	}
+	if (pid == 0) {
+		return 0;
+	}
+
+	if (vmPath.empty() || rootDir.empty()) {
+		std::cout << COLOR_RED << COLOR_BOLD
+		          << "The process benchmarks need --guest or --fixture "
+		          << "and --root-path" << COLOR_RESET << std::endl;
+		return 1;
+	}
+
+	VMIInstance vmi(vmPath, hypflag | VMI_INIT_COMPLETE);
+	kl->setVMIInstance(&vmi);
+	kl->initTaskManager();
+	while (rootDir.back() == '/') {
+		rootDir.pop_back();
+	}
+	kl->getTaskManager()->setRootDir(rootDir);
+
+	auto tm = kl->getTaskManager();
+	if (tm->terminated(pid)) {
+		std::cout << "No task with pid: " << pid << std::endl;
+		return 1;
+	}
+
+	// Relocation and classification are measured by the phase timers,
+	// loading the process includes reading the guest.
+	Metrics::Snapshot before = Metrics::collect();
+	Process proc{tm->getTaskExeName(pid), kl, pid};
+	ProcessValidator processValidator{kl, &proc, &vmi};
+	processValidator.validateProcess();
+	Metrics::Snapshot after = Metrics::collect();
+
+	uint64_t relocations = after.counters[Metrics::RELOCATIONS] -
+	                       before.counters[Metrics::RELOCATIONS];
+	uint64_t relocationNs = after.timers[Metrics::RELOCATION] -
+	                        before.timers[Metrics::RELOCATION];
+	printResult("applyRelocations",
+	            relocations / (relocationNs / 1e9), "relocs/s", relocations);
+
+	uint64_t pointers = after.counters[Metrics::USER_POINTERS] -
+	                    before.counters[Metrics::USER_POINTERS];
+	uint64_t classificationNs = after.timers[Metrics::CLASSIFICATION] -
+	                            before.timers[Metrics::CLASSIFICATION];
+	printResult("PagePtrInfo::showPtrs",
+	            (double)classificationNs / std::max<uint64_t>(pointers, 1),
+	            "ns/pointer", pointers);
+	return 0;
+}
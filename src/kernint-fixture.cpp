@@ -0,0 +1,261 @@
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <getopt.h>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "elfkernelloader.h"
+#include "guestfixture.h"
+#include "helpers.h"
+#include "kernelvalidator.h"
+
+using namespace kernint;
+
+const char *helpString = R"EOF(
+    Usage: %s [options]
+
+    Generate a synthetic guest for the libvmi file backend from a
+    reference kernel and a userspace tree. kernint can then validate
+    the guest without a hypervisor.
+
+    Possible options are:
+
+    -h, --help
+        Display the help page.
+
+    -k, --kernel=<kernelDir>
+        Use the vmlinux, System.map and modules in <kernelDir>.
+
+    -o, --output=<image>
+        Write the memory image to <image> and the libvmi configuration
+        entry for it to <image>.conf.
+
+    -u, --userspace=<userspaceDir>
+        Take the binaries of the processes from <userspaceDir>.
+
+    -e, --exe=<path>
+        Start a process of the binary <path> within <userspaceDir>,
+        may be given more than once.
+
+    -n, --processes=<N>
+        Start <N> processes, the binaries given with -e are used in
+        turn. Default is one process per binary.
+
+    -r, --root-path=<rootDir>
+        Copy the binaries used by the processes to <rootDir>, which is
+        passed to kernint as root path.
+
+    -M, --modules=<N>
+        Load up to <N> modules of <kernelDir>, default is none. Their
+        code is relocated by reading the written image with libvmi, so
+        <image>.conf has to be in the libvmi configuration. Modules that
+        can not be relocated, e.g. as a dependency is missing, are
+        reported as modified, their code ranges are written to
+        <image>.modules.
+
+    -x, --modify=<N>
+        Modify <N> random pages of the kernel code. Their addresses are
+        written to <image>.modifications.
+
+    -s, --seed=<seed>
+        Seed for the modifications, default is 0.
+)EOF";
+
+void displayHelp(const char *argv0) {
+	printf(helpString, argv0);
+}
+
+int main(int argc, char **argv) {
+	std::cout << COLOR_RESET;
+
+	std::string kerndir;
+	std::string imageFile;
+	std::string userspaceDir;
+	std::string rootDir;
+	std::vector<std::string> executables;
+	uint32_t processes     = 0;
+	uint32_t modules       = 0;
+	uint32_t modifications = 0;
+	uint32_t seed          = 0;
+
+	int c;
+
+	opterr = 0;
+
+	int option_index                    = 0;
+	static struct option long_options[] = {
+		{"help", no_argument, 0, 'h'},
+		{"kernel", required_argument, 0, 'k'},
+		{"output", required_argument, 0, 'o'},
+		{"userspace", required_argument, 0, 'u'},
+		{"exe", required_argument, 0, 'e'},
+		{"processes", required_argument, 0, 'n'},
+		{"root-path", required_argument, 0, 'r'},
+		{"modules", required_argument, 0, 'M'},
+		{"modify", required_argument, 0, 'x'},
+		{"seed", required_argument, 0, 's'},
+		{0, 0, 0, 0}
+	};
+
+	while ((c = getopt_long(argc, argv, ":hk:o:u:e:n:r:M:x:s:", long_options, &option_index)) != -1) {
+		switch (c) {
+		case 'h':
+			displayHelp(argv[0]);
+			return 0;
+
+		case 'k':
+			kerndir.assign(optarg);
+			break;
+
+		case 'o':
+			imageFile.assign(optarg);
+			break;
+
+		case 'u':
+			userspaceDir.assign(optarg);
+			break;
+
+		case 'e':
+			executables.emplace_back(optarg);
+			break;
+
+		case 'r':
+			rootDir.assign(optarg);
+			break;
+
+		case 'n':
+		case 'M':
+		case 'x':
+		case 's': {
+			char *endptr;
+			errno = 0;
+			long value = strtol(optarg, &endptr, 10);
+			if (errno != 0 || endptr == optarg || *endptr != '\0' ||
+			    value < 0 || value > UINT32_MAX) {
+				std::cout << "Invalid value: " << optarg << std::endl;
+				return 1;
+			}
+			if (c == 'n') {
+				processes = value;
+			} else if (c == 'M') {
+				modules = value;
+			} else if (c == 'x') {
+				modifications = value;
+			} else {
+				seed = value;
+			}
+			break;
+		}
+
+		case '?':
+			if (isprint(optopt)) {
+				fprintf(stderr, "Unknown option `-%c'.\n", optopt);
+			}
+			else {
+				fprintf(stderr, "Unknown option character `\\x%x'.\n", optopt);
+			}
+
+		default:
+			displayHelp(argv[0]);
+			return 1;
+		}
+	}
+
+	if (kerndir.empty() || !fexists(kerndir)) {
+		std::cout << COLOR_RED << COLOR_BOLD
+		          << "Wrong Path given for Kernel Directory: " << kerndir
+		          << COLOR_RESET << std::endl;
+		return 1;
+	}
+
+	if (imageFile.empty()) {
+		std::cout << COLOR_RED << COLOR_BOLD
+		          << "No output file given" << COLOR_RESET << std::endl;
+		return 1;
+	}
+
+	if (!executables.empty() && (userspaceDir.empty() || rootDir.empty())) {
+		std::cout << COLOR_RED << COLOR_BOLD
+		          << "Processes need --userspace and --root-path"
+		          << COLOR_RESET << std::endl;
+		return 1;
+	}
+	while (!userspaceDir.empty() && userspaceDir.back() == '/') {
+		userspaceDir.pop_back();
+	}
+	if (processes == 0) {
+		processes = executables.size();
+	}
+
+	std::cout << COLOR_GREEN << "Loading Kernel" << COLOR_NORM << std::endl;
+	ElfKernelLoader *kl = KernelValidator::loadKernel(kerndir);
+
+	GuestFixture fixture{kl, kerndir};
+	fixture.addModules(modules);
+
+	for (uint32_t i = 0; i < processes && !executables.empty(); i++) {
+		const std::string &exe = executables[i % executables.size()];
+		if (!fixture.addProcess(userspaceDir, exe)) {
+			std::cout << COLOR_RED << COLOR_BOLD
+			          << "Could not load binary: " << exe
+			          << COLOR_RESET << std::endl;
+			return 1;
+		}
+	}
+
+	fixture.injectModifications(modifications, seed);
+
+	if (!fixture.write(imageFile, rootDir)) {
+		std::cout << COLOR_RED << COLOR_BOLD
+		          << "Could not write fixture: " << imageFile
+		          << COLOR_RESET << std::endl;
+		return 1;
+	}
+
+	if (modifications) {
+		FILE *out = fopen((imageFile + ".modifications").c_str(), "w");
+		if (!out) {
+			std::cout << COLOR_RED << COLOR_BOLD
+			          << "Could not write modifications of " << imageFile
+			          << COLOR_RESET << std::endl;
+			return 1;
+		}
+		for (uint64_t address : fixture.getModifications()) {
+			fprintf(out, "0x%lx\n", address);
+		}
+		fclose(out);
+	}
+
+	if (modules && !fixture.relocateModules(imageFile)) {
+		std::cout << "Could not open " << imageFile << " with libvmi, add "
+		          << imageFile << ".conf to the libvmi configuration "
+		          << "and run again to relocate the modules" << std::endl;
+	}
+
+	if (modules) {
+		FILE *out = fopen((imageFile + ".modules").c_str(), "w");
+		if (!out) {
+			std::cout << COLOR_RED << COLOR_BOLD
+			          << "Could not write module ranges of " << imageFile
+			          << COLOR_RESET << std::endl;
+			return 1;
+		}
+		for (auto &range : fixture.getModuleCode()) {
+			fprintf(out, "0x%lx-0x%lx\n", range.first, range.second);
+		}
+		fclose(out);
+		if (!fixture.getModuleCode().empty()) {
+			std::cout << "The code of " << fixture.getModuleCode().size()
+			          << " modules is not relocated and will be "
+			          << "reported as modified" << std::endl;
+		}
+	}
+
+	std::cout << "Wrote guest with " << fixture.getProcessCount()
+	          << " processes and " << fixture.getModuleCount()
+	          << " modules to " << imageFile << std::endl;
+	return 0;
+}
@@ -0,0 +1,153 @@
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <getopt.h>
+#include <iostream>
+#include <memory>
+
+#include "calltargetextractor.h"
+#include "elfkernelloader.h"
+#include "helpers.h"
+#include "kernelvalidator.h"
+
+using namespace kernint;
+
+const char *helpString = R"EOF(
+    Usage: %s [options]
+
+    Generate the call targets file for the stack validation
+    of kernint (--targets-file).
+
+    Possible options are:
+
+    -h, --help
+        Display the help page.
+
+    -k, --kernel=<kernelDir>
+        Use the vmlinux and modules in <kernelDir>.
+
+    -o, --output=<targets>
+        Write the targets file to <targets>.
+
+    -g, --guest=<guest(File)>
+        Load the modules of guest(File). Modules are placed at
+        their load address in the guest, so without a guest only
+        the kernel itself is processed.
+
+    -j, --threads=<N>
+        Use <N> threads for disassembling.
+        0 uses all available CPUs, which is the default.
+)EOF";
+
+void displayHelp(const char *argv0) {
+	printf(helpString, argv0);
+}
+
+int main(int argc, char **argv) {
+	std::cout << COLOR_RESET;
+
+	std::string kerndir;
+	std::string outputFile;
+	std::string vmPath;
+	uint32_t threads = 0;
+
+	int c;
+
+	opterr = 0;
+
+	int option_index                    = 0;
+	static struct option long_options[] = {
+		{"help", no_argument, 0, 'h'},
+		{"kernel", required_argument, 0, 'k'},
+		{"output", required_argument, 0, 'o'},
+		{"guest", required_argument, 0, 'g'},
+		{"threads", required_argument, 0, 'j'},
+		{0, 0, 0, 0}
+	};
+
+	while ((c = getopt_long(argc, argv, ":hk:o:g:j:", long_options, &option_index)) != -1) {
+		switch (c) {
+		case 'h':
+			displayHelp(argv[0]);
+			return 0;
+
+		case 'k':
+			kerndir.assign(optarg);
+			break;
+
+		case 'o':
+			outputFile.assign(optarg);
+			break;
+
+		case 'g':
+			vmPath.assign(optarg);
+			break;
+
+		case 'j': {
+			char *endptr;
+			errno = 0;
+			long value = strtol(optarg, &endptr, 10);
+			if (errno != 0 || endptr == optarg || *endptr != '\0' || value < 0) {
+				std::cout << "Invalid thread count: " << optarg << std::endl;
+				return 1;
+			}
+			threads = value;
+			break;
+		}
+
+		case '?':
+			if (isprint(optopt)) {
+				fprintf(stderr, "Unknown option `-%c'.\n", optopt);
+			}
+			else {
+				fprintf(stderr, "Unknown option character `\\x%x'.\n", optopt);
+			}
+
+		default:
+			displayHelp(argv[0]);
+			return 1;
+		}
+	}
+
+	if (kerndir.empty() || !fexists(kerndir)) {
+		std::cout << COLOR_RED << COLOR_BOLD
+		          << "Wrong Path given for Kernel Directory: " << kerndir
+		          << COLOR_RESET << std::endl;
+		return 1;
+	}
+
+	if (outputFile.empty()) {
+		std::cout << COLOR_RED << COLOR_BOLD
+		          << "No output file given" << COLOR_RESET << std::endl;
+		return 1;
+	}
+
+	std::cout << COLOR_GREEN << "Loading Kernel" << COLOR_NORM << std::endl;
+	ElfKernelLoader *kl = KernelValidator::loadKernel(kerndir);
+
+	std::unique_ptr<VMIInstance> vmi;
+	if (!vmPath.empty()) {
+		vmi.reset(new VMIInstance(vmPath, VMI_AUTO | VMI_INIT_COMPLETE));
+		kl->setVMIInstance(vmi.get());
+		kl->initTaskManager();
+
+		std::cout << COLOR_GREEN << "Loading Modules" << COLOR_NORM << std::endl;
+		kl->loadAllModules();
+	}
+	kl->symbols.updateRevMaps();
+
+	CallTargetExtractor extractor{kl};
+	extractor.extract(threads);
+
+	if (!extractor.write(outputFile)) {
+		std::cout << COLOR_RED << COLOR_BOLD
+		          << "Could not write targets file: " << outputFile
+		          << COLOR_RESET << std::endl;
+		return 1;
+	}
+
+	std::cout << "Wrote targets of " << extractor.getCallCount()
+	          << " calls to " << outputFile << std::endl;
+	return 0;
+}
@@ -1,5 +1,6 @@
 #include "kernint.h"
 
+#include <algorithm>
 #include <cassert>
 #include <typeinfo>
 #include <ctype.h>
@@ -8,13 +9,20 @@
 
 #include <csignal>
 #include <chrono>
+#include <fstream>
 #include <getopt.h>
 #include <memory>
+#include <thread>
 
 #include "elfkernelloader.h"
+#include "findings.h"
 #include "kernelvalidator.h"
+#include "metrics.h"
 #include "processvalidator.h"
 #include "process.h"
+#include "ptrscanner.h"
+#include "reporter.h"
+#include "vmitrace.h"
 
 #include <boost/filesystem.hpp>
 namespace fs = boost::filesystem;
@@ -35,12 +43,12 @@ void validateKernel(KernelValidator *val) {
 	    std::chrono::duration_cast<std::chrono::milliseconds>
 	        (time_stop - time_start).count();
 
-	std::cout << "Executed " << iterations << " iterations in " << d_actual
-	          << " ms ( " << (((double)d_actual) / iterations)
-	          << " ms/iteration) " << std::endl;
+	report() << "Executed " << iterations << " iterations in " << d_actual
+	         << " ms ( " << (((double)d_actual) / iterations)
+	         << " ms/iteration) " << std::endl;
 }
 
-void validateUserspace(ProcessValidator *val) {
+void validateUserspace(ProcessValidator *val, const std::string &metricsFile) {
 	// whitelisted values for environment
 	// if LD_BIND_NOW = "" -> lazyBinding is off
 	// if LD_BIND_NOW = "nope" or LD_BIND_NOW is nonexistant -> lazyBinding is on
@@ -52,6 +60,9 @@ void validateUserspace(ProcessValidator *val) {
 
 	val->checkEnvironment(configEnv);
 	val->validateProcess();
+	Reporter::get().flush();
+	Metrics::write(metricsFile);
+	VMITrace::get().flush();
 }
 
 const char *helpString = R"EOF(
@@ -73,6 +84,10 @@ const char *helpString = R"EOF(
     -l, --loop
         Run introspection component until external interrupt.
 
+    -i, --incremental
+        Only validate pages again that changed since their last
+        clean validation. Useful together with --loop.
+
     -k, --checkKernel=<kernelDir>
         Check for kernel integrity. Use binaries in <kernelDir> as
         trusted reference.
@@ -85,6 +100,7 @@ const char *helpString = R"EOF(
 
     -t, --targetsFile=<targets>
         Use call targets in <targets> for stackvalidation.
+        The file is generated by kernint-targets.
 
     -p, --pid=<pid>
         Check <pid> for integrity
@@ -92,22 +108,90 @@ const char *helpString = R"EOF(
     -l, --libraryPath=<libraryPath>
         Use <libraryPath> to load trusted libraries.
 
+    -j, --threads=<N>
+        Use <N> worker threads for kernel page validation.
+        0 uses all available CPUs, the default is 1. At most four
+        threads per CPU are accepted.
+
+    -s, --max-pages-per-sec=<N>
+        Validate at most <N> kernel pages per second. An iteration is
+        spread over several seconds and continues where the last
+        second stopped.
+
+    -B, --budget-ms-per-sec=<ms>
+        Spend at most <ms> milliseconds of each second on the kernel
+        page validation, may be combined with --max-pages-per-sec.
+        The time needed for a full iteration and the achieved page
+        rate are exported with --metrics.
+
+    -T, --critical-interval=<ms>
+        Validate the IDT, .rodata and the pv ops every <ms> ms and
+        rotate the rest of the kernel and the modules in between.
+        Intervals below a second are kept in the pauses of
+        --max-pages-per-sec and --budget-ms-per-sec.
+
+    -C, --tier-file=<file>
+        Override the tiers of --critical-interval with the rules in
+        <file>, see pagescheduler.h.
+
+    -K, --sample-window=<K>
+        Only validate a random sample of the kernel pages in each
+        iteration, so that every page is validated once in <K>
+        iterations. The resulting bound of the time until a
+        modification is found is reported after each iteration.
+
+    -S, --sample-seed=<seed>
+        Seed of the sample, the same seed picks the same pages.
+        Default is 0.
+
+    -o, --output=<file>
+        Write the results to <file> instead of the terminal,
+        without color codes.
+
+    -f, --output-format=<format>
+        Write the findings as text (default), json (JSON Lines),
+        csv or binary (length prefixed records, see findings.h).
+        Other formats only contain the findings and summaries, the
+        progress and error messages go to stderr.
+
+    -m, --metrics=<prefix>
+        Write counters and phase timers to <prefix>.prom (Prometheus
+        text format) and <prefix>.json after each iteration.
+
+    -R, --record-trace=<file>
+        Record all guest reads of kernint to <file>.
+
+    -P, --replay-trace=<file>
+        Answer the guest reads of kernint from a trace recorded with
+        --record-trace instead of the guest. The kernel structures are
+        still read from the guest given with -g, e.g. a memory dump.
+
+    -D, --dwarf-snapshot
+        Only parse the debug information of the kernel types kernint
+        uses, from <kernelDir>/vmlinux.kernint-dwarf. The snapshot is
+        created from vmlinux on the first run.
+
+    -A, --cache-dir=<dir>
+        Keep the patched images of the kernel and its modules in
+        <dir>, by default $XDG_CACHE_HOME/kernint or
+        ~/.cache/kernint. An empty <dir> disables the image caches.
+
     Note: If the guest os is mounted via sshfs the transform_symlinks
           option needs to be used!
           sshfs -o transform_symlinks <user>@<ip>:/ <dir>/
 )EOF";
 
 void displayHelp(const char *argv0) {
+	Reporter::get().flush();
 	printf(helpString, argv0);
 }
 
 int main(int argc, char **argv) {
-	std::cout << COLOR_RESET;
-
 	// Parse options from cmdline
 	std::string vmPath;
 	int hypflag   = 0;
 	bool loopMode = false;
+	bool incremental = false;
 
 	std::string kerndir;
 	bool codeValidation     = true;
@@ -117,8 +201,27 @@ int main(int argc, char **argv) {
 	std::string targetsFile;
 
 	std::string libraryDir;
+	std::string outputFile;
+	std::string outputFormat;
+	std::string metricsFile;
 	std::string rootDir;
+	std::string recordTrace;
+	std::string replayTrace;
+	bool dwarfSnapshot = false;
+	std::string cacheDir;
+	if (getenv("XDG_CACHE_HOME") && *getenv("XDG_CACHE_HOME")) {
+		cacheDir = std::string{getenv("XDG_CACHE_HOME")} + "/kernint";
+	} else if (getenv("HOME") && *getenv("HOME")) {
+		cacheDir = std::string{getenv("HOME")} + "/.cache/kernint";
+	}
 	int32_t pid = 0;
+	uint32_t threads = 1;
+	uint32_t maxPagesPerSec = 0;
+	uint32_t budgetMsPerSec = 0;
+	uint32_t criticalInterval = 0;
+	std::string tierFile;
+	uint32_t sampleWindow = 0;
+	uint64_t sampleSeed = 0;
 
 	int c;
 
@@ -132,6 +235,7 @@ int main(int argc, char **argv) {
 		{"hypervisor_file", no_argument, &hypflag, VMI_FILE},
 		{"guest(File)", required_argument, 0, 'g'},
 		{"loop", no_argument, 0, 'l'},
+		{"incremental", no_argument, 0, 'i'},
 
 		{"check-kernel", required_argument, 0, 'k'},
 		{"kernel-validation", no_argument, 0, 'a'},
@@ -144,15 +248,29 @@ int main(int argc, char **argv) {
 		{"pid", required_argument, 0, 'p'},
 		{"root-path", required_argument, 0, 'r'},
 		{"library-path", required_argument, 0, 'b'},
+		{"threads", required_argument, 0, 'j'},
+		{"max-pages-per-sec", required_argument, 0, 's'},
+		{"budget-ms-per-sec", required_argument, 0, 'B'},
+		{"critical-interval", required_argument, 0, 'T'},
+		{"tier-file", required_argument, 0, 'C'},
+		{"sample-window", required_argument, 0, 'K'},
+		{"sample-seed", required_argument, 0, 'S'},
+		{"output", required_argument, 0, 'o'},
+		{"output-format", required_argument, 0, 'f'},
+		{"metrics", required_argument, 0, 'm'},
+		{"record-trace", required_argument, 0, 'R'},
+		{"replay-trace", required_argument, 0, 'P'},
+		{"dwarf-snapshot", no_argument, 0, 'D'},
+		{"cache-dir", required_argument, 0, 'A'},
 		{0, 0, 0, 0}
 	};
 
-	while ((c = getopt_long(argc, argv, ":hg:lk:acet:xp:b:r:", long_options, &option_index)) != -1) {
+	while ((c = getopt_long(argc, argv, ":hg:lik:acet:xp:b:r:j:s:B:T:C:K:S:o:f:m:R:P:DA:", long_options, &option_index)) != -1) {
 		switch (c) {
 		case 0: break;
 
 		case 'h':
-			std::cout << "Showing help as requested..." << std::endl;
+			report() << "Showing help as requested..." << std::endl;
 			displayHelp(argv[0]);
 			return 0;
 			break;
@@ -165,6 +283,10 @@ int main(int argc, char **argv) {
 			loopMode = true;
 			break;
 
+		case 'i':
+			incremental = true;
+			break;
+
 		case 'k':
 			kerndir.assign(optarg);
 			break;
@@ -189,14 +311,98 @@ int main(int argc, char **argv) {
 			char *endptr;
 			pid = strtol(optarg, &endptr, 10);
 			if ((errno == ERANGE) || (errno != 0 && pid == 0)) {
-				std::cout << "Entered pid value is invalid.";
+				report() << "Entered pid value is invalid.";
 				return 1;
 			}
 			if (endptr == optarg) {
-				std::cout << "No digit found in specified pid." << std::endl;
+				report() << "No digit found in specified pid." << std::endl;
+				return 1;
+			}
+			break;
+
+		case 'j': {
+			// Every worker gets its own buffer pool, do not allocate
+			// them for absurd values
+			long maxThreads = std::max(std::thread::hardware_concurrency(), 1U) * 4;
+			char *endptr;
+			errno = 0;
+			long value = strtol(optarg, &endptr, 10);
+			if (errno != 0 || endptr == optarg || *endptr != '\0' ||
+			    value < 0 || value > maxThreads) {
+				report() << "Invalid thread count: " << optarg << std::endl;
+				return 1;
+			}
+			threads = value;
+			break;
+		}
+
+		case 's':
+		case 'B':
+		case 'T':
+		case 'K': {
+			char *endptr;
+			errno = 0;
+			long value = strtol(optarg, &endptr, 10);
+			if (errno != 0 || endptr == optarg || *endptr != '\0' ||
+			    value < 0 || value > UINT32_MAX ||
+			    (c == 'B' && value > 1000)) {
+				report() << "Invalid value: " << optarg << std::endl;
+				return 1;
+			}
+			if (c == 's') {
+				maxPagesPerSec = value;
+			} else if (c == 'B') {
+				budgetMsPerSec = value;
+			} else if (c == 'T') {
+				criticalInterval = value;
+			} else {
+				sampleWindow = value;
+			}
+			break;
+		}
+
+		case 'S': {
+			char *endptr;
+			errno = 0;
+			sampleSeed = strtoull(optarg, &endptr, 0);
+			if (errno != 0 || endptr == optarg || *endptr != '\0') {
+				report() << "Invalid seed: " << optarg << std::endl;
 				return 1;
 			}
 			break;
+		}
+
+		case 'C':
+			tierFile.assign(optarg);
+			break;
+
+		case 'o':
+			outputFile.assign(optarg);
+			break;
+
+		case 'f':
+			outputFormat.assign(optarg);
+			break;
+
+		case 'm':
+			metricsFile.assign(optarg);
+			break;
+
+		case 'R':
+			recordTrace.assign(optarg);
+			break;
+
+		case 'P':
+			replayTrace.assign(optarg);
+			break;
+
+		case 'D':
+			dwarfSnapshot = true;
+			break;
+
+		case 'A':
+			cacheDir.assign(optarg);
+			break;
 
 		case 'r':
 			rootDir.assign(optarg);
@@ -225,11 +431,65 @@ int main(int argc, char **argv) {
 		}
 	}
 
+	if (!outputFile.empty()) {
+		// Still used by the reporter while the program exits
+		std::ofstream *output = new std::ofstream(outputFile);
+		if (!output->is_open()) {
+			report() << "Could not open output file: " << outputFile
+			         << std::endl;
+			return 1;
+		}
+		Reporter::get().setOutput(output);
+		Reporter::get().setStripColors(true);
+	}
+
+	if (!outputFormat.empty()) {
+		auto writer = FindingWriter::create(outputFormat);
+		if (!writer) {
+			report() << "Unknown output format: " << outputFormat
+			         << std::endl;
+			Reporter::get().flush();
+			return 1;
+		}
+		// Binary records may contain anything that looks like a color
+		Reporter::get().setStripColors(writer->isText() &&
+		                               !outputFile.empty());
+		if (!writer->isText() && outputFile.empty()) {
+			// The records own stdout, whatever else the loaders and
+			// libraries print goes to stderr
+			static std::ostream records{std::cout.rdbuf()};
+			Reporter::get().setOutput(&records);
+			std::cout.rdbuf(std::cerr.rdbuf());
+		}
+		FindingWriter::set(std::move(writer));
+	}
+
+	// Only written with the text format
+	report() << COLOR_RESET;
+
 	if (rootDir.empty()){
-		std::cout << "Guest root path not set, exiting ..." << std::endl;
+		report() << "Guest root path not set, exiting ..." << std::endl;
 		exit(0);
 	}
 
+	if (!recordTrace.empty() && !replayTrace.empty()) {
+		report() << "Can not record and replay a trace at once" << std::endl;
+		Reporter::get().flush();
+		return 1;
+	}
+	if (!recordTrace.empty() && !VMITrace::get().record(recordTrace)) {
+		report() << "Could not open trace file: " << recordTrace
+		         << std::endl;
+		Reporter::get().flush();
+		return 1;
+	}
+	if (!replayTrace.empty() && !VMITrace::get().replay(replayTrace)) {
+		report() << "Could not read trace file: " << replayTrace
+		         << std::endl;
+		Reporter::get().flush();
+		return 1;
+	}
+
 	if (hypflag == 0) {
 		hypflag = VMI_AUTO;
 	}
@@ -239,21 +499,38 @@ int main(int argc, char **argv) {
 	}
 
 	VMIInstance vmi(vmPath, hypflag | VMI_INIT_COMPLETE);
+	// The page reads go into the pooled buffers directly
+	if (VMITrace::get().getMode() == VMITrace::Mode::OFF &&
+	    !VMITrace::get().openDirect(vmPath, hypflag | VMI_INIT_COMPLETE)) {
+		report() << "Could not open a second libvmi handle, "
+		         << "page reads are copied" << std::endl;
+	}
 
 	if (kerndir.empty()) {
 		assert(false);
 	}
 
 	if (kerndir.empty() || !fexists(kerndir)) {
-		std::cout << COLOR_RED << COLOR_BOLD
-		          << "Wrong Path given for Kernel Directory: " << kerndir
-		          << COLOR_RESET << std::endl;
+		report() << COLOR_RED << COLOR_BOLD
+		         << "Wrong Path given for Kernel Directory: " << kerndir
+		         << COLOR_RESET << std::endl;
 		exit(0);
 	}
 
-	std::cout << COLOR_GREEN << "Loading Kernel" << COLOR_NORM << std::endl;
+	report() << COLOR_GREEN << "Loading Kernel" << COLOR_NORM << std::endl;
 
-	ElfKernelLoader *kl = KernelValidator::loadKernel(kerndir);
+	boost::system::error_code error;
+	if (!cacheDir.empty() && !fs::is_directory(cacheDir, error) &&
+	    !fs::create_directories(cacheDir, error)) {
+		report() << "Could not create the cache directory " << cacheDir
+		         << ", the images are not cached" << std::endl;
+		cacheDir.clear();
+	}
+
+	// The loaders print directly, keep the order of the messages
+	Reporter::get().flush();
+	ElfKernelLoader *kl = KernelValidator::loadKernel(kerndir, dwarfSnapshot,
+	                                                  cacheDir);
 	kl->setVMIInstance(&vmi);
 	kl->initTaskManager();
 	if (!rootDir.empty()) {
@@ -269,14 +546,32 @@ int main(int argc, char **argv) {
 
 	if (kernelValidation) {
 		if (!fexists(targetsFile)) {
-			std::cout << COLOR_RED << COLOR_BOLD
-			          << "Wrong Path given for Targets File: " << targetsFile
-			          << COLOR_RESET << std::endl;
+			report() << COLOR_RED << COLOR_BOLD
+			         << "Wrong Path given for Targets File: " << targetsFile
+			         << COLOR_RESET << std::endl;
 			exit(0);
 		}
 
-		KernelValidator val{kl, targetsFile};
+		Reporter::get().flush();
+		KernelValidator val{kl};
+		if (!val.loadCallTargets(targetsFile)) {
+			report() << COLOR_RED << COLOR_BOLD
+			         << "Could not load the targets file: " << targetsFile
+			         << COLOR_RESET << std::endl;
+			Reporter::get().flush();
+			exit(1);
+		}
 		val.setOptions(loopMode, codeValidation, pointerExamination);
+		val.setThreadCount(threads);
+		val.setIncremental(incremental);
+		val.setRateLimit(maxPagesPerSec, budgetMsPerSec);
+		val.setSampling(sampleWindow, sampleSeed);
+		if ((criticalInterval || !tierFile.empty()) &&
+		    !val.setTiers(criticalInterval, tierFile)) {
+			Reporter::get().flush();
+			exit(1);
+		}
+		val.setMetricsFile(metricsFile);
 
 		validator = &val;
 
@@ -289,7 +584,7 @@ int main(int argc, char **argv) {
 		signal(SIGINT, signalHandler);
 		signal(SIGTERM, signalHandler);
 
-		std::cout << "Starting Kernel Validation" << std::endl;
+		report() << "Starting Kernel Validation" << std::endl;
 		validateKernel(&val);
 	}
 
@@ -297,23 +592,24 @@ int main(int argc, char **argv) {
 
 	if (pid != 0 && !tm->terminated(pid)) {
 		std::string exe = tm->getTaskExeName(pid);
-		std::cout << "Creating process image to verify..." << std::endl;
+		report() << "Creating process image to verify..." << std::endl;
+		Reporter::get().flush();
 		Process proc{exe, kl, pid};
-		std::cout << "Starting process validation..." << std::endl;
+		report() << "Starting process validation..." << std::endl;
 		ProcessValidator val{kl, &proc, &vmi};
-		validateUserspace(&val);
+		validateUserspace(&val, metricsFile);
 	} else {
-		std::cout << COLOR_RED << COLOR_BOLD
-		          << "No task with pid: " << pid
-		          << COLOR_RESET << std::endl;
+		report() << COLOR_RED << COLOR_BOLD
+		         << "No task with pid: " << pid
+		         << COLOR_RESET << std::endl;
 	}
 
 	if (listprocs) {
 		const auto time1_start = std::chrono::system_clock::now();
 
-		std::cout << COLOR_GREEN
-		          << "Starting to find kernel pointers in userspace applications"
-		          << COLOR_NORM << std::endl;
+		report() << COLOR_GREEN
+		         << "Starting to find kernel pointers in userspace applications"
+		         << COLOR_NORM << std::endl;
 		auto tasks = kl->getTaskManager()->getTasks();
 
 		std::unordered_map<uint64_t, std::vector<std::tuple<pid_t, std::string, VMAInfo>>> physMap;
@@ -340,8 +636,8 @@ int main(int argc, char **argv) {
 
 			std::string exe = tm->getTaskExeName(pid);
 
-			std::cout << "Loading next process: "
-			          << pid <<": " << comm << " " << exe << std::endl;
+			report() << "Loading next process: "
+			         << pid <<": " << comm << " " << exe << std::endl;
 
 			// the taskmanager must be cleaned up after each process!
 			// this is because the loaded libraries depend on the
@@ -350,11 +646,12 @@ int main(int argc, char **argv) {
 
 			// kl->getTaskManager()->cleanupLibraries();
 			const auto time2_start = std::chrono::system_clock::now();
+			Reporter::get().flush();
 			Process proc{exe, kl, pid};
 			ProcessValidator val{kl, &proc, &vmi};
 			const auto time2_stop = std::chrono::system_clock::now();
 			const auto time3_start = std::chrono::system_clock::now();
-			validateUserspace(&val);
+			validateUserspace(&val, metricsFile);
 			const auto time3_stop = std::chrono::system_clock::now();
 			time2 += std::chrono::duration_cast<std::chrono::milliseconds>(time2_stop - time2_start).count();
 			time3 += std::chrono::duration_cast<std::chrono::milliseconds>(time3_stop - time3_start).count();
@@ -375,63 +672,63 @@ int main(int argc, char **argv) {
 
 				for (size_t i = 0; i < mlength; i++) {
 					uint64_t phys =
-					vmi.translateV2P(info.start + i * 0x1000, pid);
+					VMITrace::get().translateV2P(&vmi, info.start + i * 0x1000,
+					                             pid);
 					physMap[phys].push_back(std::make_tuple(pid, comm, info));
 				}
 				mapcount++;
 				// info.print();
 			}
 		}
-		std::cout << "Number of mappings in all " << tasks.size()
-		          << " processes " << mapcount << std::endl;
-		std::cout << "Number of different physical pages: " << physMap.size()
-		          << std::endl;
+		report() << "Number of mappings in all " << tasks.size()
+		         << " processes " << mapcount << std::endl;
+		report() << "Number of different physical pages: " << physMap.size()
+		         << std::endl;
 
-		std::cout << "Starting to iterate through physical pages" << std::endl;
+		report() << "Starting to iterate through physical pages" << std::endl;
 		int addressCount = 0;
 		// const uint64_t kernelStart = 0xffffffff80000000;
 
+		PointerScanner scanner{PointerScanner::kernelSpaceMask};
+		std::vector<uint32_t> candidates;
 		for (auto phys : physMap) {
-			auto physPage = vmi.readVectorFromPA(phys.first, 0x1000);
+			auto physPage = VMITrace::get().readVectorFromPA(&vmi, phys.first,
+			                                                 0x1000);
 			if (physPage.size() == 0)
 				continue;
 			const unsigned char *physData = physPage.data();
-			for (uint16_t i = 0; i < 0x1000; i++) {
-				uint64_t *physPtr = (uint64_t *)(physData + i);
-				if (*physPtr == 0xffffffffffffffff) {
-					continue;
-				}
-				if ((*physPtr & 0xffff000000000000) != 0xffff000000000000) {
-					continue;
-				}
-				// if ((*physPtr & kernelStart) != kernelStart) continue;
-				// if (*physPtr > kernelStart + 0x10000000) continue;
-				if (!(kl->isCodeAddress(*physPtr) ||
-				      kl->isDataAddress(*physPtr))) {
+			candidates.clear();
+			scanner.scan(physData, 0, physPage.size(), &candidates);
+			for (uint32_t i : candidates) {
+				uint64_t physPtr = PointerScanner::read(physData, i);
+				// if ((physPtr & kernelStart) != kernelStart) continue;
+				// if (physPtr > kernelStart + 0x10000000) continue;
+				if (!(kl->isCodeAddress(physPtr) ||
+				      kl->isDataAddress(physPtr))) {
 					continue;
 				}
 				addressCount++;
 
-				std::cout << "Found address with the correct start: "
-				          << std::hex << *(uint64_t *)(physData + i) << std::dec
-				          << std::endl;
+				report() << "Found address with the correct start: "
+				         << std::hex << physPtr << std::dec
+				         << std::endl;
 				for (auto &&mapping : phys.second) {
-					std::cout << "Mapped into PID: " << std::get<0>(mapping)
-					          << " " << std::get<1>(mapping) << std::endl;
+					report() << "Mapped into PID: " << std::get<0>(mapping)
+					         << " " << std::get<1>(mapping) << std::endl;
 					std::get<2>(mapping).print();
 				}
 			}
 		}
-		std::cout << std::endl
-		          << "Done iterating through physical pages" << std::endl;
-		std::cout << "Found " << addressCount
-		          << " address with the correct start" << std::endl;
+		report() << std::endl
+		         << "Done iterating through physical pages" << std::endl;
+		report() << "Found " << addressCount
+		         << " address with the correct start" << std::endl;
 
 		const auto time1_stop = std::chrono::system_clock::now();
 		const auto time1 = std::chrono::duration_cast<std::chrono::milliseconds>(time1_stop - time1_start).count();
 
-		std::cout << "Needed " << time1 << " ms " << std::endl;
-		std::cout << "Process Loading " << time2 << " ms " << std::endl;
-		std::cout << "Process Validation " << time3 << " ms " << std::endl;
+		report() << "Needed " << time1 << " ms " << std::endl;
+		report() << "Process Loading " << time2 << " ms " << std::endl;
+		report() << "Process Validation " << time3 << " ms " << std::endl;
 	}
 }
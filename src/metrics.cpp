@@ -0,0 +1,301 @@
+#include "metrics.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+#include <vector>
+
+namespace kernint {
+
+static const char *counterNames[Metrics::COUNTER_COUNT] = {
+	"code_pages",
+	"data_pages",
+	"rodata_pages",
+	"idt_pages",
+	"stack_pages",
+	"skipped_pages",
+	"unreadable_pages",
+	"mismatches",
+	"pointer_candidates",
+	"pointers_undecidable",
+	"decodes",
+	"vmi_reads",
+	"vmi_bytes",
+	"relocations",
+	"user_pointers",
+};
+
+static const char *timerNames[Metrics::TIMER_COUNT] = {
+	"loading",
+	"relocation",
+	"patching",
+	"validation",
+	"classification",
+};
+
+static const char *gaugeNames[Metrics::GAUGE_COUNT] = {
+	"coverage_seconds",
+	"page_rate",
+	"detection_latency_seconds",
+};
+
+namespace {
+
+/**
+ * Values of one thread. Only the owning thread writes, so the atomics
+ * are just there to make the reads of collect() well defined.
+ */
+struct ThreadMetrics {
+	std::atomic<uint64_t> counters[Metrics::COUNTER_COUNT];
+	std::atomic<uint64_t> timers[Metrics::TIMER_COUNT];
+
+	ThreadMetrics() {
+		for (auto &value : this->counters) {
+			value.store(0, std::memory_order_relaxed);
+		}
+		for (auto &value : this->timers) {
+			value.store(0, std::memory_order_relaxed);
+		}
+	}
+};
+
+struct Registry {
+	std::mutex mutex;
+	std::vector<ThreadMetrics *> threads;
+	/** Values of threads that already exited */
+	Metrics::Snapshot retired{};
+	/** Totals at the end of the last iteration */
+	Metrics::Snapshot last{};
+	uint64_t iterations = 0;
+	double gauges[Metrics::GAUGE_COUNT] = {};
+};
+
+Registry &registry() {
+	static Registry instance;
+	return instance;
+}
+
+class ThreadSlot {
+public:
+	ThreadSlot() : metrics{new ThreadMetrics()} {
+		Registry &reg = registry();
+		std::lock_guard<std::mutex> lock(reg.mutex);
+		reg.threads.push_back(this->metrics);
+	}
+
+	~ThreadSlot() {
+		Registry &reg = registry();
+		std::lock_guard<std::mutex> lock(reg.mutex);
+		for (uint32_t i = 0; i < Metrics::COUNTER_COUNT; i++) {
+			reg.retired.counters[i] += this->metrics->counters[i].load();
+		}
+		for (uint32_t i = 0; i < Metrics::TIMER_COUNT; i++) {
+			reg.retired.timers[i] += this->metrics->timers[i].load();
+		}
+		for (auto it = reg.threads.begin(); it != reg.threads.end(); it++) {
+			if (*it == this->metrics) {
+				reg.threads.erase(it);
+				break;
+			}
+		}
+		delete this->metrics;
+	}
+
+	ThreadMetrics *metrics;
+};
+
+ThreadMetrics &local() {
+	static thread_local ThreadSlot slot;
+	return *slot.metrics;
+}
+
+/** Increment without a locked instruction, there is only one writer */
+inline void add(std::atomic<uint64_t> &value, uint64_t n) {
+	value.store(value.load(std::memory_order_relaxed) + n,
+	            std::memory_order_relaxed);
+}
+
+} // namespace
+
+void Metrics::count(Counter counter, uint64_t n) {
+	add(local().counters[counter], n);
+}
+
+void Metrics::addTime(Timer timer, uint64_t ns) {
+	add(local().timers[timer], ns);
+}
+
+void Metrics::set(Gauge gauge, double value) {
+	Registry &reg = registry();
+	std::lock_guard<std::mutex> lock(reg.mutex);
+	reg.gauges[gauge] = value;
+}
+
+static Metrics::Snapshot collectLocked(Registry &reg) {
+	Metrics::Snapshot snapshot = reg.retired;
+	for (auto &&thread : reg.threads) {
+		for (uint32_t i = 0; i < Metrics::COUNTER_COUNT; i++) {
+			snapshot.counters[i] +=
+				thread->counters[i].load(std::memory_order_relaxed);
+		}
+		for (uint32_t i = 0; i < Metrics::TIMER_COUNT; i++) {
+			snapshot.timers[i] +=
+				thread->timers[i].load(std::memory_order_relaxed);
+		}
+	}
+	return snapshot;
+}
+
+Metrics::Snapshot Metrics::collect() {
+	Registry &reg = registry();
+	std::lock_guard<std::mutex> lock(reg.mutex);
+	return collectLocked(reg);
+}
+
+static double seconds(uint64_t ns) {
+	return ns / 1e9;
+}
+
+static void writePrometheus(std::ostream &out,
+                            const Metrics::Snapshot &total,
+                            const double *gauges,
+                            uint64_t iterations) {
+	using M = Metrics;
+
+	auto counter = [&](const char *name, const char *help, uint64_t value) {
+		out << "# HELP kernint_" << name << " " << help << "\n"
+		    << "# TYPE kernint_" << name << " counter\n"
+		    << "kernint_" << name << " " << value << "\n";
+	};
+
+	counter("iterations_total", "Completed validation iterations",
+	        iterations);
+
+	out << "# HELP kernint_pages_validated_total Validated pages by type\n"
+	    << "# TYPE kernint_pages_validated_total counter\n";
+	const std::pair<const char *, M::Counter> pageTypes[] = {
+		{"code",   M::CODE_PAGES},
+		{"data",   M::DATA_PAGES},
+		{"rodata", M::RODATA_PAGES},
+		{"idt",    M::IDT_PAGES},
+		{"stack",  M::STACK_PAGES},
+	};
+	for (auto &type : pageTypes) {
+		out << "kernint_pages_validated_total{type=\"" << type.first << "\"} "
+		    << total.counters[type.second] << "\n";
+	}
+
+	counter("pages_skipped_total", "Unchanged pages skipped",
+	        total.counters[M::SKIPPED_PAGES]);
+	counter("pages_unreadable_total", "Pages not validated as the read failed",
+	        total.counters[M::UNREADABLE_PAGES]);
+	counter("mismatches_total", "Modified code, rodata or IDT entries",
+	        total.counters[M::MISMATCHES]);
+	counter("pointer_candidates_total", "Possible kernel code pointers",
+	        total.counters[M::POINTER_CANDIDATES]);
+	counter("pointers_undecidable_total", "Code pointers not explained",
+	        total.counters[M::POINTERS_UNDECIDABLE]);
+	counter("decodes_total", "Instructions decoded",
+	        total.counters[M::DECODES]);
+	counter("vmi_reads_total", "Guest memory reads",
+	        total.counters[M::VMI_READS]);
+	counter("vmi_read_bytes_total", "Bytes read from guest memory",
+	        total.counters[M::VMI_BYTES]);
+	counter("relocations_total", "Relocation entries applied",
+	        total.counters[M::RELOCATIONS]);
+	counter("user_pointers_total", "Userspace pointers classified",
+	        total.counters[M::USER_POINTERS]);
+
+	out << "# HELP kernint_phase_seconds_total Time spent per phase\n"
+	    << "# TYPE kernint_phase_seconds_total counter\n";
+	for (uint32_t i = 0; i < M::TIMER_COUNT; i++) {
+		out << "kernint_phase_seconds_total{phase=\"" << timerNames[i]
+		    << "\"} " << seconds(total.timers[i]) << "\n";
+	}
+
+	auto gauge = [&](const char *help, M::Gauge gauge) {
+		out << "# HELP kernint_" << gaugeNames[gauge] << " " << help << "\n"
+		    << "# TYPE kernint_" << gaugeNames[gauge] << " gauge\n"
+		    << "kernint_" << gaugeNames[gauge] << " " << gauges[gauge]
+		    << "\n";
+	};
+	gauge("Time needed to validate all kernel pages once",
+	      M::COVERAGE_SECONDS);
+	gauge("Kernel pages validated per second", M::PAGE_RATE);
+	gauge("Time until a kernel modification is found at most",
+	      M::DETECTION_LATENCY_SECONDS);
+}
+
+static void writeJsonSnapshot(std::ostream &out,
+                              const Metrics::Snapshot &snapshot) {
+	out << "{\"counters\":{";
+	for (uint32_t i = 0; i < Metrics::COUNTER_COUNT; i++) {
+		out << (i ? "," : "") << "\"" << counterNames[i] << "\":"
+		    << snapshot.counters[i];
+	}
+	out << "},\"seconds\":{";
+	for (uint32_t i = 0; i < Metrics::TIMER_COUNT; i++) {
+		out << (i ? "," : "") << "\"" << timerNames[i] << "\":"
+		    << seconds(snapshot.timers[i]);
+	}
+	out << "}}";
+}
+
+/** Write to a temporary file first, readers never see partial files */
+template <typename F>
+static void replaceFile(const std::string &file, F &&writer) {
+	std::string tmp = file + ".tmp";
+	{
+		std::ofstream out(tmp);
+		if (!out.is_open()) {
+			return;
+		}
+		writer(out);
+	}
+	std::rename(tmp.c_str(), file.c_str());
+}
+
+void Metrics::write(const std::string &prefix) {
+	if (prefix.empty()) {
+		return;
+	}
+
+	Registry &reg = registry();
+	Snapshot total;
+	Snapshot iteration;
+	uint64_t iterations;
+	double gauges[GAUGE_COUNT];
+	{
+		std::lock_guard<std::mutex> lock(reg.mutex);
+		total = collectLocked(reg);
+		for (uint32_t i = 0; i < COUNTER_COUNT; i++) {
+			iteration.counters[i] = total.counters[i] - reg.last.counters[i];
+		}
+		for (uint32_t i = 0; i < TIMER_COUNT; i++) {
+			iteration.timers[i] = total.timers[i] - reg.last.timers[i];
+		}
+		reg.last = total;
+		iterations = ++reg.iterations;
+		std::copy(reg.gauges, reg.gauges + GAUGE_COUNT, gauges);
+	}
+
+	replaceFile(prefix + ".prom", [&](std::ostream &out) {
+		writePrometheus(out, total, gauges, iterations);
+	});
+	replaceFile(prefix + ".json", [&](std::ostream &out) {
+		out << "{\"iterations\":" << iterations << ",\"total\":";
+		writeJsonSnapshot(out, total);
+		out << ",\"last_iteration\":";
+		writeJsonSnapshot(out, iteration);
+		out << ",\"gauges\":{";
+		for (uint32_t i = 0; i < GAUGE_COUNT; i++) {
+			out << (i ? "," : "") << "\"" << gaugeNames[i] << "\":"
+			    << gauges[i];
+		}
+		out << "}}\n";
+	});
+}
+
+} // namespace kernint
@@ -0,0 +1,114 @@
+#ifndef KERNINT_METRICS_H_
+#define KERNINT_METRICS_H_
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace kernint {
+
+/**
+ * Counters and phase timers of a validation run.
+ *
+ * Every thread counts into its own slots without any synchronization,
+ * collect() merges the slots of all threads. Threads that exit hand
+ * their values over, so short living workers are not lost.
+ */
+class Metrics {
+public:
+	enum Counter : uint32_t {
+		CODE_PAGES,
+		DATA_PAGES,
+		RODATA_PAGES,
+		IDT_PAGES,
+		STACK_PAGES,
+		/** Unchanged pages skipped in incremental mode */
+		SKIPPED_PAGES,
+		/** Pages that could not be read and were not validated */
+		UNREADABLE_PAGES,
+		/** Modified code, rodata or IDT entries */
+		MISMATCHES,
+		/** Values that look like kernel code pointers */
+		POINTER_CANDIDATES,
+		/** Candidates that could not be explained */
+		POINTERS_UNDECIDABLE,
+		/** Instructions decoded by capstone */
+		DECODES,
+		VMI_READS,
+		VMI_BYTES,
+		/** Relocation entries applied */
+		RELOCATIONS,
+		/** Userspace pointers classified by the process validator */
+		USER_POINTERS,
+		COUNTER_COUNT
+	};
+
+	/** Phases may be nested, e.g. loading includes patching */
+	enum Timer : uint32_t {
+		LOADING,
+		RELOCATION,
+		PATCHING,
+		VALIDATION,
+		/** Classification of userspace pointers */
+		CLASSIFICATION,
+		TIMER_COUNT
+	};
+
+	/** Values of the last completed iteration */
+	enum Gauge : uint32_t {
+		/** Time needed to validate all kernel pages once */
+		COVERAGE_SECONDS,
+		/** Kernel pages validated per second of coverage time */
+		PAGE_RATE,
+		/** Upper bound of the time until a modification is found */
+		DETECTION_LATENCY_SECONDS,
+		GAUGE_COUNT
+	};
+
+	struct Snapshot {
+		uint64_t counters[COUNTER_COUNT];
+		/** Nanoseconds */
+		uint64_t timers[TIMER_COUNT];
+	};
+
+	static void count(Counter counter, uint64_t n=1);
+	static void addTime(Timer timer, uint64_t ns);
+	static void set(Gauge gauge, double value);
+
+	/** Sum of all threads since the start of the program */
+	static Snapshot collect();
+
+	/**
+	 * End an iteration: write the metrics in Prometheus text format to
+	 * <prefix>.prom and as JSON to <prefix>.json. Both files are
+	 * replaced atomically. Does nothing if prefix is empty.
+	 */
+	static void write(const std::string &prefix);
+};
+
+/** Adds the lifetime of the object to a phase timer */
+class ScopedTimer {
+public:
+	ScopedTimer(Metrics::Timer timer)
+		:
+		timer{timer},
+		start{std::chrono::steady_clock::now()} {}
+
+	~ScopedTimer() {
+		auto duration = std::chrono::steady_clock::now() - this->start;
+		Metrics::addTime(this->timer,
+		                 std::chrono::duration_cast<std::chrono::nanoseconds>(
+		                     duration).count());
+	}
+
+	ScopedTimer(const ScopedTimer &) = delete;
+	ScopedTimer &operator=(const ScopedTimer &) = delete;
+
+private:
+	Metrics::Timer timer;
+	std::chrono::steady_clock::time_point start;
+};
+
+} // namespace kernint
+
+#endif
@@ -0,0 +1,93 @@
+#include "pagebatch.h"
+
+#include <algorithm>
+
+namespace kernint {
+
+PageBatch::PageBatch(BufferPool *pool)
+	:
+	pool{pool},
+	ranges{},
+	runs{},
+	readCount{0} {}
+
+void PageBatch::add(uint64_t address, uint64_t len) {
+	if (len > 0) {
+		this->ranges.emplace_back(address, len);
+	}
+}
+
+void PageBatch::read(const Reader &reader) {
+	std::sort(this->ranges.begin(), this->ranges.end());
+	this->ranges.erase(std::unique(this->ranges.begin(), this->ranges.end()),
+	                   this->ranges.end());
+
+	auto readRun = [&](uint64_t start, uint64_t len) {
+		Run run{start, this->pool->get(len)};
+		run.data.setSize(reader(start, len, run.data.data()));
+		this->readCount++;
+		return run;
+	};
+
+	auto flush = [&](size_t first, size_t last, uint64_t start, uint64_t end) {
+		Run run = readRun(start, end - start);
+		if (run.data.size() == end - start) {
+			this->runs.push_back(std::move(run));
+			return;
+		}
+		// Some page of the run is not mapped,
+		// read the ranges separately to get the others
+		run.data = BufferPool::Buffer{};
+		for (size_t i = first; i < last; i++) {
+			const auto &range = this->ranges[i];
+			this->runs.push_back(readRun(range.first, range.second));
+		}
+	};
+
+	size_t first = 0;
+	uint64_t start = 0;
+	uint64_t end = 0;
+	for (size_t i = 0; i < this->ranges.size(); i++) {
+		uint64_t rangeStart = this->ranges[i].first;
+		uint64_t rangeEnd   = rangeStart + this->ranges[i].second;
+
+		if (i > first && rangeStart <= end &&
+		    std::max(end, rangeEnd) - start <= maxReadSize) {
+			end = std::max(end, rangeEnd);
+			continue;
+		}
+		if (i > first) {
+			flush(first, i, start, end);
+		}
+		first = i;
+		start = rangeStart;
+		end   = rangeEnd;
+	}
+	if (first < this->ranges.size()) {
+		flush(first, this->ranges.size(), start, end);
+	}
+	this->ranges.clear();
+}
+
+uint8_t *PageBatch::get(uint64_t address, uint64_t len) {
+	auto run = std::upper_bound(this->runs.begin(), this->runs.end(), address,
+	                            [](uint64_t value, const Run &r) {
+		                            return value < r.start;
+	                            });
+	if (run == this->runs.begin()) {
+		return nullptr;
+	}
+	run--;
+	if (address + len > run->start + run->data.size()) {
+		return nullptr;
+	}
+	return run->data.data() + (address - run->start);
+}
+
+void PageBatch::clear() {
+	this->ranges.clear();
+	this->runs.clear();
+	this->readCount = 0;
+}
+
+} // namespace kernint
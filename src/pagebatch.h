@@ -0,0 +1,70 @@
+#ifndef KERNINT_PAGEBATCH_H_
+#define KERNINT_PAGEBATCH_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "bufferpool.h"
+
+namespace kernint {
+
+/**
+ * Collects the guest memory ranges a validation step needs and reads
+ * them with as few VMI calls as possible: ranges are sorted and
+ * contiguous ones are merged into a single read.
+ *
+ * The validators then get pointers into the read buffers instead of
+ * reading every page on their own. The buffers are borrowed from a
+ * BufferPool and returned by clear().
+ */
+class PageBatch {
+public:
+	/**
+	 * Reads len bytes at a guest virtual address into the buffer,
+	 * returns the number of bytes read.
+	 */
+	typedef std::function<size_t(uint64_t, uint64_t, uint8_t *)> Reader;
+
+	/** Ranges are only merged up to this size */
+	static const uint64_t maxReadSize = BufferPool::maxSize;
+
+	PageBatch(BufferPool *pool);
+
+	void add(uint64_t address, uint64_t len);
+
+	/**
+	 * Read all ranges added so far. If a merged read comes back
+	 * incomplete, its ranges are read one by one.
+	 */
+	void read(const Reader &reader);
+
+	/**
+	 * Memory of a range added before read(),
+	 * nullptr if it could not be read completely.
+	 */
+	uint8_t *get(uint64_t address, uint64_t len);
+
+	/** Number of reads issued by read() */
+	size_t getReadCount() const { return this->readCount; }
+
+	void clear();
+
+private:
+	struct Run {
+		uint64_t start;
+		/** Sized to the bytes actually read */
+		BufferPool::Buffer data;
+	};
+
+	BufferPool *pool;
+	std::vector<std::pair<uint64_t, uint64_t>> ranges;
+	/** Sorted by start address, not overlapping */
+	std::vector<Run> runs;
+	size_t readCount;
+};
+
+} // namespace kernint
+
+#endif
@@ -0,0 +1,319 @@
+#include "pagescheduler.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+#include "elfkernelloader.h"
+#include "helpers.h"
+#include "reporter.h"
+
+namespace kernint {
+
+/** Page vaddrs of the page map only have the lower 48 bits */
+static const uint64_t vaddrMask = 0xffffffffffff;
+static const uint64_t pageSize  = 0x1000;
+
+/** Symbols of CRITICAL pages and their type, used for the size */
+static const std::pair<const char *, const char *> criticalSymbols[] = {
+	{"idt_table", nullptr},
+	{"nmi_idt_table", nullptr},
+	{"sys_call_table", nullptr},
+	{"ia32_sys_call_table", nullptr},
+	{"pv_ops", "paravirt_patch_template"},
+	{"pv_info", "pv_info"},
+	{"pv_init_ops", "pv_init_ops"},
+	{"pv_time_ops", "pv_time_ops"},
+	{"pv_cpu_ops", "pv_cpu_ops"},
+	{"pv_irq_ops", "pv_irq_ops"},
+	{"pv_mmu_ops", "pv_mmu_ops"},
+	{"pv_lock_ops", "pv_lock_ops"},
+};
+
+PageScheduler::PageScheduler()
+	:
+	kernel{nullptr},
+	interval{0},
+	lastCritical{},
+	criticalRounds{0},
+	cursors{},
+	positions{},
+	covered{},
+	rotation{0},
+	sampleWindow{0},
+	sampleSeed{0},
+	sampleIteration{0},
+	sampleKey{0},
+	sampleSlot{0} {}
+
+bool PageScheduler::assignTiers(ElfKernelLoader *kernel, uint32_t intervalMs,
+                                const std::string &configFile) {
+	this->kernel   = kernel;
+	this->interval = std::chrono::milliseconds(intervalMs);
+	this->ranges.clear();
+	this->moduleTiers.clear();
+
+	if (!configFile.empty() && !this->loadConfig(configFile)) {
+		this->kernel = nullptr;
+		return false;
+	}
+
+	for (auto &symbol : criticalSymbols) {
+		uint64_t address =
+			kernel->symbols.getSystemMapAddress(symbol.first, true);
+		if (!address) {
+			continue;
+		}
+		uint64_t size = pageSize;
+		if (symbol.second) {
+			BaseType *type = kernel->symbols.findBaseTypeByName(symbol.second);
+			size = type ? type->getByteSize() : pageSize;
+		}
+		this->addRange(address, size, CRITICAL);
+	}
+
+	const SectionInfo &rodata = kernel->roDataSection;
+	this->addRange(rodata.memindex, rodata.size, CRITICAL);
+	return true;
+}
+
+void PageScheduler::addRange(uint64_t start, uint64_t size, Tier tier) {
+	// Whole pages are validated, round to them
+	start &= vaddrMask;
+	uint64_t end = (start + std::max<uint64_t>(size, 1) + pageSize - 1) &
+	               ~(pageSize - 1);
+	this->ranges.push_back({start & ~(pageSize - 1), end, tier});
+}
+
+bool PageScheduler::loadConfig(const std::string &fileName) {
+	std::ifstream infile(fileName);
+	if (!infile.is_open()) {
+		report() << COLOR_RED << "Could not open tier file: "
+		         << fileName << COLOR_NORM << std::endl;
+		return false;
+	}
+
+	std::string line;
+	uint32_t lineNumber = 0;
+	while (std::getline(infile, line)) {
+		lineNumber++;
+		line = line.substr(0, line.find('#'));
+
+		std::istringstream fields(line);
+		uint32_t tier;
+		std::string kind;
+		std::string what;
+		if (!(fields >> tier)) {
+			if (line.find_first_not_of(" \t\r") == std::string::npos) {
+				continue;
+			}
+			tier = TIER_COUNT;
+		}
+		fields >> kind >> what;
+
+		uint64_t size = pageSize;
+		std::string sizeField;
+		if (fields >> sizeField) {
+			size = strtoull(sizeField.c_str(), nullptr, 0);
+		}
+
+		bool valid = tier < TIER_COUNT && !what.empty() && size;
+		if (valid && kind == "module") {
+			this->moduleTiers.emplace(what, (Tier)tier);
+		} else if (valid && kind == "symbol") {
+			uint64_t address =
+				this->kernel->symbols.getSystemMapAddress(what, true);
+			if (!address) {
+				report() << COLOR_RED << fileName << ":" << lineNumber
+				         << ": Unknown symbol " << what << COLOR_NORM
+				         << std::endl;
+				return false;
+			}
+			this->addRange(address, size, (Tier)tier);
+		} else if (valid && kind == "address") {
+			this->addRange(strtoull(what.c_str(), nullptr, 0), size,
+			               (Tier)tier);
+		} else {
+			report() << COLOR_RED << fileName << ":" << lineNumber
+			         << ": Invalid rule: " << line << COLOR_NORM
+			         << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+PageScheduler::Tier PageScheduler::getTier(const page_info_t *page) const {
+	if (!this->kernel) {
+		return CORE;
+	}
+
+	uint64_t vaddr = page->vaddr & vaddrMask;
+	for (auto &range : this->ranges) {
+		if (vaddr >= range.start && vaddr < range.end) {
+			return range.tier;
+		}
+	}
+
+	ElfKernelspaceLoader *module =
+		this->kernel->getModuleForAddress(page->vaddr);
+	if (module && !this->moduleTiers.empty()) {
+		auto tier = this->moduleTiers.find(module->getName());
+		if (tier != this->moduleTiers.end()) {
+			return tier->second;
+		}
+	}
+	return module == this->kernel ? CORE : COLD;
+}
+
+/** splitmix64, spreads neighbouring pages over the whole window */
+static uint64_t mix(uint64_t value) {
+	value += 0x9e3779b97f4a7c15;
+	value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9;
+	value = (value ^ (value >> 27)) * 0x94d049bb133111eb;
+	return value ^ (value >> 31);
+}
+
+void PageScheduler::setSampling(uint32_t window, uint64_t seed) {
+	this->sampleWindow    = window;
+	this->sampleSeed      = seed;
+	this->sampleIteration = 0;
+	this->sampleKey       = mix(seed);
+}
+
+void PageScheduler::sample(std::vector<page_info_t *> &pages) {
+	if (this->sampleWindow <= 1) {
+		return;
+	}
+
+	// The slot of a page only depends on the seed, so it is due at
+	// fixed intervals
+	this->sampleSlot = this->sampleIteration % this->sampleWindow;
+	this->sampleIteration++;
+
+	this->removeUnsampled(pages);
+}
+
+void PageScheduler::removeUnsampled(std::vector<page_info_t *> &pages) const {
+	if (this->sampleWindow <= 1) {
+		return;
+	}
+	pages.erase(std::remove_if(pages.begin(), pages.end(),
+	                           [&](const page_info_t *page) {
+		                           if (this->isTiered() &&
+		                               this->getTier(page) == CRITICAL) {
+			                           return false;
+		                           }
+		                           return mix(this->sampleKey ^
+		                                      (page->vaddr & vaddrMask)) %
+		                                  this->sampleWindow != this->sampleSlot;
+	                           }),
+	            pages.end());
+}
+
+void PageScheduler::assignPages(const std::vector<page_info_t *> &pages) {
+	for (auto &tierPages : this->pages) {
+		tierPages.clear();
+	}
+	for (auto &&page : pages) {
+		this->pages[this->getTier(page)].push_back(page);
+	}
+
+	// Continue behind the last page handed out of each tier
+	for (uint32_t tier = 0; tier < TIER_COUNT; tier++) {
+		auto &tierPages = this->pages[tier];
+		auto next = std::lower_bound(tierPages.begin(), tierPages.end(),
+		                             this->cursors[tier],
+		                             [](const page_info_t *page, uint64_t vaddr) {
+			                             return page->vaddr < vaddr;
+		                             });
+		this->positions[tier] = next - tierPages.begin();
+	}
+}
+
+void PageScheduler::start(const std::vector<page_info_t *> &pages) {
+	for (uint32_t tier = 0; tier < TIER_COUNT; tier++) {
+		this->cursors[tier] = 0;
+	}
+	this->assignPages(pages);
+	for (uint32_t tier = 0; tier < TIER_COUNT; tier++) {
+		this->covered[tier] = this->pages[tier].empty();
+	}
+}
+
+void PageScheduler::refresh(std::vector<page_info_t *> &pages) {
+	this->removeUnsampled(pages);
+	this->assignPages(pages);
+
+	// Pages behind the cursor were handed out with the old map
+	for (uint32_t tier = 0; tier < TIER_COUNT; tier++) {
+		if (this->positions[tier] == this->pages[tier].size()) {
+			this->positions[tier] = 0;
+			this->cursors[tier]   = 0;
+			this->covered[tier]   = true;
+		}
+	}
+}
+
+bool PageScheduler::next(size_t count, std::vector<page_info_t *> *slice) {
+	if (std::all_of(std::begin(this->covered), std::end(this->covered),
+	                [](bool covered) { return covered; })) {
+		return false;
+	}
+
+	if (this->nextCritical(slice)) {
+		return true;
+	}
+
+	// CORE continues after its pass until COLD is done as well,
+	// a covered COLD leaves its slices to CORE
+	static const Tier order[] = {CORE, CORE, COLD};
+	Tier tier = order[this->rotation++ % 3];
+	if (this->pages[tier].empty() ||
+	    (tier == COLD && this->covered[COLD] && !this->covered[CORE])) {
+		tier = tier == CORE ? COLD : CORE;
+	}
+	if (this->pages[tier].empty()) {
+		return false;
+	}
+
+	auto &tierPages = this->pages[tier];
+	size_t &position = this->positions[tier];
+	size_t end = std::min(tierPages.size(), position + std::max<size_t>(count, 1));
+	slice->assign(tierPages.begin() + position, tierPages.begin() + end);
+	position = end;
+
+	if (position == tierPages.size()) {
+		position = 0;
+		this->cursors[tier] = 0;
+		this->covered[tier] = true;
+	} else {
+		this->cursors[tier] = tierPages[position]->vaddr;
+	}
+	return true;
+}
+
+bool PageScheduler::nextCritical(std::vector<page_info_t *> *slice) {
+	// Without an interval the CRITICAL pages are validated once
+	auto now = std::chrono::steady_clock::now();
+	if (this->pages[CRITICAL].empty() ||
+	    (this->covered[CRITICAL] && now < this->getCriticalDeadline())) {
+		return false;
+	}
+	*slice = this->pages[CRITICAL];
+	this->lastCritical = now;
+	this->criticalRounds++;
+	this->covered[CRITICAL] = true;
+	return true;
+}
+
+std::chrono::steady_clock::time_point
+PageScheduler::getCriticalDeadline() const {
+	if (!this->interval.count() || this->pages[CRITICAL].empty()) {
+		return std::chrono::steady_clock::time_point::max();
+	}
+	return this->lastCritical + this->interval;
+}
+
+} // namespace kernint
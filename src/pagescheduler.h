@@ -0,0 +1,155 @@
+#ifndef KERNINT_PAGESCHEDULER_H_
+#define KERNINT_PAGESCHEDULER_H_
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "libvmiwrapper/libvmiwrapper.h"
+
+namespace kernint {
+
+class ElfKernelLoader;
+
+/**
+ * Decides which kernel pages are validated next.
+ *
+ * Without tiers all pages are validated in address order. With tiers
+ * the pages are split into:
+ *
+ *   CRITICAL  IDT, .rodata (syscall and ops tables) and the pv ops,
+ *             validated again whenever the critical interval elapsed
+ *   CORE      the rest of the kernel
+ *   COLD      modules and everything else
+ *
+ * CORE and COLD are rotated in between, CORE gets two slices for each
+ * slice of COLD and continues with the next pass until COLD is done.
+ * An iteration is done once every tier was covered.
+ * A rate limited iteration takes a while, the page map can be replaced
+ * in between by refresh(). Each tier continues behind the last page it
+ * handed out.
+ *
+ * The tiers can be overridden by a file with one rule per line, the
+ * first matching rule wins:
+ *
+ *     # tier  kind     what                [bytes]
+ *     0       symbol   sys_call_table      0x1000
+ *     0       address  0xffffffff81e00000  0x2000
+ *     2       module   ext4
+ *
+ * In the sampling mode each iteration only validates a part of the
+ * pages. A seeded hash of its address assigns every page to one of
+ * window slots, iteration i validates the pages of slot i % window. So
+ * every page is validated every window iterations, and a modification
+ * is found within window iterations.
+ * CRITICAL pages are never left out.
+ */
+class PageScheduler {
+public:
+	enum Tier : uint8_t {
+		CRITICAL,
+		CORE,
+		COLD,
+		TIER_COUNT
+	};
+
+	PageScheduler();
+
+	/**
+	 * Derive the tiers from the symbols and sections of kernel, then
+	 * apply the rules of configFile if given. CRITICAL pages are
+	 * validated every intervalMs ms. Returns false if the file can not
+	 * be read or parsed.
+	 */
+	bool assignTiers(ElfKernelLoader *kernel, uint32_t intervalMs,
+	                 const std::string &configFile="");
+	bool isTiered() const { return this->kernel != nullptr; }
+
+	Tier getTier(const page_info_t *page) const;
+
+	/**
+	 * Validate every page once within window iterations, picked by a
+	 * hash seeded with seed. A window of 0 or 1 validates all pages.
+	 */
+	void setSampling(uint32_t window, uint64_t seed);
+	uint32_t getSampleWindow() const { return this->sampleWindow; }
+
+	/**
+	 * Remove the pages that are not due in the next iteration of the
+	 * sampling mode. Call once per iteration, before start().
+	 */
+	void sample(std::vector<page_info_t *> &pages);
+
+	/** Start an iteration over pages, which are sorted by vaddr */
+	void start(const std::vector<page_info_t *> &pages);
+
+	/**
+	 * Continue the iteration with a new page map of the guest. pages
+	 * are sorted by vaddr, the sampling of the iteration is applied.
+	 */
+	void refresh(std::vector<page_info_t *> &pages);
+
+	/**
+	 * The next pages to validate: all CRITICAL pages if their interval
+	 * elapsed, otherwise up to count pages of the rotation. Returns
+	 * false once the iteration is done.
+	 */
+	bool next(size_t count, std::vector<page_info_t *> *slice);
+
+	/**
+	 * All CRITICAL pages if their interval elapsed. Returns false if
+	 * they are not due.
+	 */
+	bool nextCritical(std::vector<page_info_t *> *slice);
+
+	/** When the CRITICAL pages are due next, max() without interval */
+	std::chrono::steady_clock::time_point getCriticalDeadline() const;
+
+	/** Number of times the CRITICAL pages were handed out */
+	uint64_t getCriticalRounds() const { return this->criticalRounds; }
+	size_t getPageCount(Tier tier) const {
+		return this->pages[tier].size();
+	}
+
+private:
+	struct Range {
+		uint64_t start;
+		uint64_t end;
+		Tier tier;
+	};
+
+	ElfKernelLoader *kernel;
+	std::chrono::milliseconds interval;
+	std::chrono::steady_clock::time_point lastCritical;
+	uint64_t criticalRounds;
+
+	/** Override rules first, then the derived ranges */
+	std::vector<Range> ranges;
+	std::unordered_map<std::string, Tier> moduleTiers;
+
+	std::vector<page_info_t *> pages[TIER_COUNT];
+	/** vaddr of the next page per tier, 0 at the start of a pass */
+	uint64_t cursors[TIER_COUNT];
+	size_t positions[TIER_COUNT];
+	/** Tiers that completed a pass in this iteration */
+	bool covered[TIER_COUNT];
+	uint32_t rotation;
+
+	uint32_t sampleWindow;
+	uint64_t sampleSeed;
+	uint64_t sampleIteration;
+	/** Hash key of the seed and slot of the current iteration */
+	uint64_t sampleKey;
+	uint64_t sampleSlot;
+
+	void addRange(uint64_t start, uint64_t size, Tier tier);
+	void removeUnsampled(std::vector<page_info_t *> &pages) const;
+	void assignPages(const std::vector<page_info_t *> &pages);
+	bool loadConfig(const std::string &fileName);
+};
+
+} // namespace kernint
+
+#endif
@@ -3,6 +3,7 @@
 #include "elffile.h"
 #include "elfloader.h"
 #include "kernel_headers.h"
+#include "metrics.h"
 #include "paravirt_state.h"
 
 
@@ -236,6 +237,7 @@ uint32_t ParavirtPatcher::paravirtNativePatch(uint32_t type,
 }
 
 void ParavirtPatcher::applyParainstr(ElfLoader *target) {
+	ScopedTimer timer{Metrics::PATCHING};
 	uint64_t count   = 0;
 	SectionInfo info = target->elffile->findSectionWithName(".parainstructions");
 	if (!info.index) {
@@ -8,6 +8,7 @@
 #include "error.h"
 #include "kernel.h"
 #include "libdwarfparser/instance.h"
+#include "metrics.h"
 #include "processvalidator.h"
 
 #include <boost/filesystem.hpp>
@@ -26,6 +27,7 @@ Process::Process(const std::string &binaryName, Kernel *kernel, pid_t pid)
 	vdsoLoader{nullptr},
 	binaryName{binaryName} {
 
+	ScopedTimer timer{Metrics::LOADING};
 	auto tm = this->kernel->getTaskManager();
 
 	std::cout << COLOR_GREEN << "Loading process " << binaryName
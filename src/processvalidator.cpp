@@ -16,7 +16,11 @@ namespace fs = boost::filesystem;
 #include "elffile.h"
 #include "elfkernelloader.h"
 #include "elfuserspaceloader.h"
+#include "findings.h"
+#include "metrics.h"
+#include "reporter.h"
 #include "taskmanager.h"
+#include "vmitrace.h"
 
 
 namespace kernint {
@@ -75,7 +79,7 @@ typedef enum {
 	PTR_END_PRINTABLE   = 1 << 16
 } ptr_class_e;
 
-static std::string printStat2(std::unordered_map<uint64_t, std::pair<uint64_t, uint64_t>> ptr_class) {
+static std::vector<Summary::Counter> getStat2(std::unordered_map<uint64_t, std::pair<uint64_t, uint64_t>> ptr_class) {
 	size_t overall              = 0;
 	size_t overall_not_7f       = 0;
 	size_t overall_7f           = 0;
@@ -163,22 +167,20 @@ static std::string printStat2(std::unordered_map<uint64_t, std::pair<uint64_t, u
 	//   << "Unintended Return instruction;"
 	//   << "Unintended Usable Gadget;"
 
-	std::stringstream ss;
-	ss << ";" << overall       << " (" << overall_7f << " / " << overall_not_7f << ")"
-	   << ";" << ptr_unique    << " (" << ptr_unique_7f << " / " << ptr_unique_not_7f << ")"
-	   << ";" << ptr_text      << " (" << ptr_text_7f << " / " << ptr_text_not_7f << ")"
-	   << ";" << ptr_unk       << " (" << ptr_unk_7f << " / " << ptr_unk_not_7f << ")"
-	   << ";" << ptr_unk_print << " (" << ptr_unk_print_7f << " / " << ptr_unk_print_not_7f << ")"
-	   << ";" << ptr_inv_inst  << " (" << ptr_inv_inst_7f << " / " << ptr_inv_inst_not_7f << ")"
-	   << ";" << ptr_unin_inst << " (" << ptr_unin_inst_7f << " / " << ptr_unin_inst_not_7f << ")"
-	   << ";" << ptr_unin_ret  << " (" << ptr_unin_ret_7f << " / " << ptr_unin_ret_not_7f << ")"
-	   << ";" << ptr_unin_gad  << " (" << ptr_unin_gad_7f << " / " << ptr_unin_gad_not_7f << ")"
-	;
-
-	return ss.str();
+	return {
+		{"overall",                  overall,       true, overall_7f,       overall_not_7f},
+		{"unique",                   ptr_unique,    true, ptr_unique_7f,    ptr_unique_not_7f},
+		{"text",                     ptr_text,      true, ptr_text_7f,      ptr_text_not_7f},
+		{"unknown",                  ptr_unk,       true, ptr_unk_7f,       ptr_unk_not_7f},
+		{"unknown_end_printable",    ptr_unk_print, true, ptr_unk_print_7f, ptr_unk_print_not_7f},
+		{"invalid_instruction",      ptr_inv_inst,  true, ptr_inv_inst_7f,  ptr_inv_inst_not_7f},
+		{"unintended_instruction",   ptr_unin_inst, true, ptr_unin_inst_7f, ptr_unin_inst_not_7f},
+		{"unintended_return",        ptr_unin_ret,  true, ptr_unin_ret_7f,  ptr_unin_ret_not_7f},
+		{"unintended_gadget",        ptr_unin_gad,  true, ptr_unin_gad_7f,  ptr_unin_gad_not_7f},
+	};
 }
 
-static std::string printStat(std::unordered_map<uint64_t, std::pair<uint64_t, uint64_t>> ptr_class, bool count_not_7f = true) {
+static std::vector<Summary::Counter> getStat(std::unordered_map<uint64_t, std::pair<uint64_t, uint64_t>> ptr_class, bool count_not_7f = true) {
 	size_t overall              = 0;
 	size_t ptr_not_7f           = 0;
 	size_t ptr_unk_7f           = 0;
@@ -252,45 +254,46 @@ static std::string printStat(std::unordered_map<uint64_t, std::pair<uint64_t, ui
 	//   << "Unintended Return instruction;"
 	//   << "Unintended Usable Gadget;"
 
-	std::stringstream ss;
-	ss << ";" << overall
-	   << ";" << ptr_class.size()
-	   << ";" << ptr_not_7f
-	   << ";" << ptr_class.size() - ptr_unknown
-	   << ";" << ptr_no_section
-//	   << ";" << ptr_plain_file
-	   << ";" << ptr_section_start
-	   << ";" << ptr_sec_not_text
-	   << ";" << ptr_dynstr
-	   << ";" << ptr_dynsym
-	   << ";" << ptr_symbol
-	   << ";" << ptr_entry
-	   << ";" << ptr_return
-	   << ";" << ptr_unknown
-	   << ";" << ptr_unk_7f
-	   << ";" << ptr_unk_7f_end_print
-	   << ";" << ptr_invalid_instr
-	   << ";" << ptr_unint_instr
-	   << ";" << ptr_unint_instr_nc
-	   << ";" << ptr_unint_return
-	   << ";" << ptr_unint_gadget;
-
-	return ss.str();
+	return {
+		{"overall",                    overall,                          false, 0, 0},
+		{"unique",                     ptr_class.size(),                 false, 0, 0},
+		{"not_pie",                    ptr_not_7f,                       false, 0, 0},
+		{"known",                      ptr_class.size() - ptr_unknown,   false, 0, 0},
+		{"no_section",                 ptr_no_section,                   false, 0, 0},
+//		{"plain_file",                 ptr_plain_file,                   false, 0, 0},
+		{"section_start",              ptr_section_start,                false, 0, 0},
+		{"section_not_text",           ptr_sec_not_text,                 false, 0, 0},
+		{"dynstr",                     ptr_dynstr,                       false, 0, 0},
+		{"dynsym",                     ptr_dynsym,                       false, 0, 0},
+		{"symbol",                     ptr_symbol,                       false, 0, 0},
+		{"entry",                      ptr_entry,                        false, 0, 0},
+		{"return",                     ptr_return,                       false, 0, 0},
+		{"unknown",                    ptr_unknown,                      false, 0, 0},
+		{"unknown_pie",                ptr_unk_7f,                       false, 0, 0},
+		{"unknown_pie_end_printable",  ptr_unk_7f_end_print,             false, 0, 0},
+		{"invalid_instruction",        ptr_invalid_instr,                false, 0, 0},
+		{"unintended_instruction",     ptr_unint_instr,                  false, 0, 0},
+		{"unintended_unchecked",       ptr_unint_instr_nc,               false, 0, 0},
+		{"unintended_return",          ptr_unint_return,                 false, 0, 0},
+		{"unintended_gadget",          ptr_unint_gadget,                 false, 0, 0},
+	};
 }
 
-std::string printMappingInfo() {
-	std::stringstream ss;
-	ss << "Mapping summary"
-	   << ";" << this->process->getPID()
-	   << ";" << this->process->getName()
-	   << ";" << this->fromVMA->name
-	   << ";" << this->toVMA.name
-	   << ";" << ((this->toLoader) ?0 :this->toLoader->elffile->getSymbolCount());
-	return ss.str();
+Summary getMappingSummary(std::vector<Summary::Counter> &&counters) {
+	Summary summary{Summary::Scope::MAPPING};
+	summary.pid      = this->process->getPID();
+	summary.name     = this->process->getName();
+	summary.from     = this->fromVMA->name;
+	summary.to       = this->toVMA.name;
+	summary.symbols  = (this->toLoader) ? this->toLoader->elffile->getSymbolCount() : 0;
+	summary.counters = std::move(counters);
+	return summary;
 }
 
 std::unordered_map<uint64_t, std::pair<uint64_t, uint64_t>> showPtrs() {
 	//std::cout << "Found " << count << " pointers:" << std::endl;
+	ScopedTimer timer{Metrics::CLASSIFICATION};
+	Metrics::count(Metrics::USER_POINTERS, this->ptrs.size());
 	uint64_t callAddr = 0;
 	bool printKnown = false;
 	std::unordered_map<uint64_t, std::pair<uint64_t, uint64_t>> ptr_class;
@@ -305,8 +308,8 @@ std::unordered_map<uint64_t, std::pair<uint64_t, uint64_t>> showPtrs() {
 		if(!toSec) {
 			SETFLAGS(flags, PTR_NO_SECTION);
 			if (printKnown) {
-				std::cout << COLOR_MARGENTA << "Pointer to no section"
-				          << std::endl << COLOR_NORM;
+				report() << COLOR_MARGENTA << "Pointer to no section"
+				         << std::endl << COLOR_NORM;
 			}
 			ptr_class[ptr.first].second = flags;
 			continue;
@@ -315,8 +318,8 @@ std::unordered_map<uint64_t, std::pair<uint64_t, uint64_t>> showPtrs() {
 		if(!this->toLoader && !toVMA.name.empty()){
 			SETFLAGS(flags, PTR_PLAIN_FILE);
 			if (printKnown) {
-				std::cout << COLOR_GREEN << "Pointer to Plain File:"
-				          << "\t" << toVMA.name << std::endl << COLOR_NORM;
+				report() << COLOR_GREEN << "Pointer to Plain File:"
+				         << "\t" << toVMA.name << std::endl << COLOR_NORM;
 			}
 			ptr_class[ptr.first].second = flags;
 			continue;
@@ -325,8 +328,8 @@ std::unordered_map<uint64_t, std::pair<uint64_t, uint64_t>> showPtrs() {
 		if ((ptr.first - toVMA.start - toSec->offset) == 0) {
 			SETFLAGS(flags, PTR_SECTION_START);
 			if (printKnown) {
-				std::cout << COLOR_GREEN << "Pointer to start of Section:"
-				          << "\t" << toSec->name << std::endl << COLOR_NORM;
+				report() << COLOR_GREEN << "Pointer to start of Section:"
+				         << "\t" << toSec->name << std::endl << COLOR_NORM;
 			}
 			ptr_class[ptr.first].second = flags;
 			continue;
@@ -337,8 +340,8 @@ std::unordered_map<uint64_t, std::pair<uint64_t, uint64_t>> showPtrs() {
 			SETFLAGS(flags, PTR_DYNSTR);
 			if (printKnown) {
 				std::string str = std::string((char*) toSec->index + (ptr.first - toVMA.start) - toSec->memindex);
-				std::cout << COLOR_GREEN << "Pointer to String:"
-				          << "\t" << str << std::endl << COLOR_NORM;
+				report() << COLOR_GREEN << "Pointer to String:"
+				         << "\t" << str << std::endl << COLOR_NORM;
 			}
 		}
 
@@ -346,8 +349,8 @@ std::unordered_map<uint64_t, std::pair<uint64_t, uint64_t>> showPtrs() {
 			SETFLAGS(flags, PTR_DYNSYM);
 			if (printKnown) {
 				std::string str = this->toLoader->elffile->dynSymbolName(ptr.first - toVMA.start - toSec->offset);
-				std::cout << COLOR_GREEN << "Pointer to Symbol:"
-				          << "\t" << str << std::endl << COLOR_NORM;
+				report() << COLOR_GREEN << "Pointer to Symbol:"
+				         << "\t" << str << std::endl << COLOR_NORM;
 			}
 		}
 
@@ -382,8 +385,8 @@ std::unordered_map<uint64_t, std::pair<uint64_t, uint64_t>> showPtrs() {
 		if(allowedSections.find(toSec->name) != allowedSections.end()) {
 			SETFLAGS(flags, PTR_SEC_NOT_TEXT);
 			if (printKnown) {
-				std::cout << COLOR_MARGENTA << "Pointer to Section:"
-				          << "\t" << toSec->name << std::endl << COLOR_NORM;
+				report() << COLOR_MARGENTA << "Pointer to Section:"
+				         << "\t" << toSec->name << std::endl << COLOR_NORM;
 			}
 			ptr_class[ptr.first].second = flags;
 			continue;
@@ -393,8 +396,8 @@ std::unordered_map<uint64_t, std::pair<uint64_t, uint64_t>> showPtrs() {
 		if (symname != "") {
 			SETFLAGS(flags, PTR_SYMBOL);
 			if (printKnown) {
-				std::cout << COLOR_GREEN << "Pointer to Symbol:"
-				          << "\t" << symname << std::endl << COLOR_NORM;
+				report() << COLOR_GREEN << "Pointer to Symbol:"
+				         << "\t" << symname << std::endl << COLOR_NORM;
 			}
 			ptr_class[ptr.first].second = flags;
 			continue;
@@ -403,8 +406,8 @@ std::unordered_map<uint64_t, std::pair<uint64_t, uint64_t>> showPtrs() {
 		if (toLoader->elffile->entryPoint() == (ptr.first - toVMA.start)){
 			SETFLAGS(flags, PTR_ENTRY);
 			if (printKnown) {
-				std::cout << COLOR_GREEN << "Pointer to Entry Point:"
-				          << std::endl << COLOR_NORM;
+				report() << COLOR_GREEN << "Pointer to Entry Point:"
+				         << std::endl << COLOR_NORM;
 			}
 			ptr_class[ptr.first].second = flags;
 			continue;
@@ -422,12 +425,12 @@ std::unordered_map<uint64_t, std::pair<uint64_t, uint64_t>> showPtrs() {
 		                       toVMA.start)) {
 			SETFLAGS(flags, PTR_UNKNOWN);
 			SETFLAGS(flags, PTR_INVALID_INSTR);
-			std::cout << COLOR_RED << COLOR_BOLD
-			          << "Pointer to invalid instruction! "
-			          << COLOR_BOLD_OFF
-			          << "Pointer to 0x" << std::setfill('0') << std::setw(8)
-			          << std::hex << ptr.first - toVMA.start << " ( 0x"
-			          << ptr.first << " ) " << std::dec << COLOR_RESET << std::endl;
+			report() << COLOR_RED << COLOR_BOLD
+			         << "Pointer to invalid instruction! "
+			         << COLOR_BOLD_OFF
+			         << "Pointer to 0x" << std::setfill('0') << std::setw(8)
+			         << std::hex << ptr.first - toVMA.start << " ( 0x"
+			         << ptr.first << " ) " << std::dec << COLOR_RESET << std::endl;
 			ptr_class[ptr.first].second = flags;
 			continue;
 		}
@@ -440,12 +443,12 @@ std::unordered_map<uint64_t, std::pair<uint64_t, uint64_t>> showPtrs() {
 		                                  func)) {
 			SETFLAGS(flags, PTR_UNKNOWN);
 			SETFLAGS(flags, PTR_UNINT_INSTR);
-			std::cout << COLOR_RED << COLOR_BOLD
-			          << "Pointer to 0x" << std::setfill('0') << std::setw(8)
-			          << std::hex << ptr.first - toVMA.start << " ( 0x"
-			          << ptr.first << " ) " << std::dec
-			          << "\tPointer to unintended instruction!"
-			          << COLOR_RESET << std::endl;
+			report() << COLOR_RED << COLOR_BOLD
+			         << "Pointer to 0x" << std::setfill('0') << std::setw(8)
+			         << std::hex << ptr.first - toVMA.start << " ( 0x"
+			         << ptr.first << " ) " << std::dec
+			         << "\tPointer to unintended instruction!"
+			         << COLOR_RESET << std::endl;
 		}
 
 		if((callAddr = isReturnAddress(this->data,
@@ -455,19 +458,19 @@ std::unordered_map<uint64_t, std::pair<uint64_t, uint64_t>> showPtrs() {
 
 			if (printKnown | CHECKFLAGS(flags, (PTR_UNINT_INSTR))) {
 				if (CHECKFLAGS(flags, PTR_UNINT_INSTR)) {
-					std::cout << COLOR_RED << COLOR_BOLD
+					report() << COLOR_RED << COLOR_BOLD
 				          << "\tPointer to unintended return addres!"
 					          << COLOR_RESET << std::endl;
 				}
 				uint64_t retFunc = this->process->symbols.getContainingSymbol(ptr.first);
 				std::string retFuncName = this->process->symbols.getElfSymbolName(retFunc);
 
-				std::cout << COLOR_GREEN << "Return Address to: "
-				          << "\t" << retFuncName << std::endl << COLOR_NORM;
+				report() << COLOR_GREEN << "Return Address to: "
+				         << "\t" << retFuncName << std::endl << COLOR_NORM;
 				if((callAddr) > 1) {
 					std::string callFuncName = this->process->symbols.getElfSymbolName(callAddr);
-					std::cout << COLOR_GREEN << "\tPreceeding call: "
-					          << "\t" << callFuncName << std::endl << COLOR_NORM;
+					report() << COLOR_GREEN << "\tPreceeding call: "
+					         << "\t" << callFuncName << std::endl << COLOR_NORM;
 				}
 			}
 
@@ -498,24 +501,24 @@ std::unordered_map<uint64_t, std::pair<uint64_t, uint64_t>> showPtrs() {
 			}
 			if(endsPrintable) {
 				SETFLAGS(flags, PTR_END_PRINTABLE);
-				std::cout << "Printable pointer: 0x" << std::hex << ptr.first << std::dec << std:: endl;
+				report() << "Printable pointer: 0x" << std::hex << ptr.first << std::dec << std:: endl;
 			}else{
-				std::cout << "Not printable pointer: 0x" << std::hex << ptr.first << std::dec << std:: endl;
+				report() << "Not printable pointer: 0x" << std::hex << ptr.first << std::dec << std:: endl;
 			}
 		}
 
-		std::cout << COLOR_RED
-		          << "Pointer to 0x" << std::setfill('0') << std::setw(8)
-		          << std::hex << ptr.first - toVMA.start << " ( 0x"
-		          << ptr.first << " ) " << std::dec;
+		report() << COLOR_RED
+		         << "Pointer to 0x" << std::setfill('0') << std::setw(8)
+		         << std::hex << ptr.first - toVMA.start << " ( 0x"
+		         << ptr.first << " ) " << std::dec;
 		if (toSec) {
-			std::cout << "\tSection: " << toSec->name;
+			report() << "\tSection: " << toSec->name;
 		}
-		std::cout << std::endl;
-		std::cout << "\tinto function: " << funcName << std::hex
-		          << " (" << "offset: " << ptr.first - func << ")"
-		          << std::dec << " From " << ptr.second.size() << " Locations"
-		          << std::endl << COLOR_NORM;
+		report() << std::endl;
+		report() << "\tinto function: " << funcName << std::hex
+		         << " (" << "offset: " << ptr.first - func << ")"
+		         << std::dec << " From " << ptr.second.size() << " Locations"
+		         << std::endl << COLOR_NORM;
 
 		size_t offset = ptr.first - toVMA.start;
 		uint64_t len = this->toLoader->getTextSegment().size() - offset;
@@ -523,15 +526,15 @@ std::unordered_map<uint64_t, std::pair<uint64_t, uint64_t>> showPtrs() {
 		size_t nr_instr = std::get<0>(ret);
 		bool end_valid = std::get<1>(ret);
 		std::string instr = std::get<2>(ret);
-		std::cout << COLOR_RED << COLOR_BOLD
-		          << "\tPointing to gadget of " << nr_instr
-		          << " instructions" << std::endl;
+		report() << COLOR_RED << COLOR_BOLD
+		         << "\tPointing to gadget of " << nr_instr
+		         << " instructions" << std::endl;
 		if(end_valid) {
 			std:: cout << "\tEnding in an invalid instruction!" << std::endl;
 		}else{
 			SETFLAGS(flags, PTR_GADGET);
 		}
-		std::cout << COLOR_RESET;
+		report() << COLOR_RESET;
 		ptr_class[ptr.first].second = flags;
 
 	}
@@ -558,10 +561,10 @@ ProcessValidator::ProcessValidator(ElfKernelLoader *kl,
 	kl{kl},
 	process{process} {
 
-	std::cout << "ProcessValidator got: " << this->process->getName() << std::endl;
+	report() << "ProcessValidator got: " << this->process->getName() << std::endl;
 
 	this->pid = process->getPID();
-	std::cout << "[PID] " << this->pid << std::endl;
+	report() << "[PID] " << this->pid << std::endl;
 }
 
 ProcessValidator::~ProcessValidator() {}
@@ -600,12 +603,12 @@ void printHeaders(){
 
 	ss2 << "C1;C2;C3;C4;C5;C6;C7;C8;C9;C10;C11;C12;C13;C14;C15;C16;C17;C18;C19;C20";
 
-	std::cout << "Process summary;PID;Name;" << ss1.str() << std::endl;
-	std::cout << "Process summary;PID;Name;" << ss2.str() << std::endl;
-	std::cout << "Section summary;PID;Name;SectionName;Symcount" << ss1.str() << std::endl;
-	std::cout << "Section summary;PID;Name;SectionName;Symcount" << ss2.str() << std::endl;
-	std::cout << "Mapping summary;PID;Name;FromMapping;ToMapping;Symcount" << ss1.str() << std::endl;
-	std::cout << "Mapping summary;PID;Name;FromMapping;ToMapping;Symcount" << ss2.str() << std::endl;
+	report() << "Process summary;PID;Name;" << ss1.str() << std::endl;
+	report() << "Process summary;PID;Name;" << ss2.str() << std::endl;
+	report() << "Section summary;PID;Name;SectionName;Symcount" << ss1.str() << std::endl;
+	report() << "Section summary;PID;Name;SectionName;Symcount" << ss2.str() << std::endl;
+	report() << "Mapping summary;PID;Name;FromMapping;ToMapping;Symcount" << ss1.str() << std::endl;
+	report() << "Mapping summary;PID;Name;FromMapping;ToMapping;Symcount" << ss2.str() << std::endl;
 }
 
 int ProcessValidator::validateProcess() {
@@ -614,25 +617,32 @@ int ProcessValidator::validateProcess() {
 	static uint64_t dataSize = 0;
 	static uint64_t dataPageCount = 0;
 
+	ScopedTimer timer{Metrics::VALIDATION};
+
 	// check if all mapped pages are known
-	std::cout << COLOR_GREEN
-	          << "Starting page validation ..."
-	          << COLOR_RESET << std::endl;
+	report() << COLOR_GREEN
+	         << "Starting page validation ..."
+	         << COLOR_RESET << std::endl;
 
 	printHeaders();
 
-	PageMap executablePageMap = this->vmi->getPages(this->pid);
+	PageMap executablePageMap = VMITrace::get().getPages(this->vmi, this->pid);
 	for (auto &page : executablePageMap) {
 		// check if page is contained in VMAs
 		if (!(page.second->vaddr & 0xffff800000000000) &&
 		    !this->process->findVMAByAddress(page.second->vaddr)) {
-			std::cout << COLOR_RED << COLOR_BOLD
-			          << "Found page that has no corresponding VMA: "
-			          << std::hex << page.second->vaddr << std::dec
-			          << COLOR_RESET << std::endl;
+			std::stringstream msg;
+			msg << "Found page that has no corresponding VMA: "
+			    << std::hex << page.second->vaddr;
+			Finding finding{Finding::Kind::UNMAPPED_PAGE,
+			                Finding::Severity::ALERT};
+			finding.pid     = this->pid;
+			finding.address = page.second->vaddr;
+			finding.message = msg.str();
+			emit(finding);
 		}
 	}
-	this->vmi->destroyMap(executablePageMap);
+	VMITrace::get().destroyMap(this->vmi, executablePageMap);
 
 	std::unordered_map<uint64_t, std::pair<uint64_t, uint64_t>> glob_stats;
 	// Check if all mapped VMAs are valid
@@ -664,18 +674,18 @@ int ProcessValidator::validateProcess() {
 	}
 
 	if(glob_stats.size()) {
-		std::cout << "Process summary"
-		          << ";" << this->process->getPID()
-		          << ";" << this->process->getName();
-		std::cout << PagePtrInfo::printStat2(glob_stats);
-		std::cout << std::endl;
+		Summary summary{Summary::Scope::PROCESS};
+		summary.pid      = this->process->getPID();
+		summary.name     = this->process->getName();
+		summary.counters = PagePtrInfo::getStat2(glob_stats);
+		emit(summary);
 	}
 
 	// TODO count errors or change return value
-	std::cout << "Validated " << execPageCount << " executable sections"
-	          << " (" << (execSize / 0x1000) << " pages)"<< std::endl;
-	std::cout << "Checked " << dataPageCount << " data sections"
-	          << " (" << (dataSize / 0x1000) << " pages)"<< std::endl;
+	report() << "Validated " << execPageCount << " executable sections"
+	         << " (" << (execSize / 0x1000) << " pages)"<< std::endl;
+	report() << "Checked " << dataPageCount << " data sections"
+	         << " (" << (dataSize / 0x1000) << " pages)"<< std::endl;
 	return 0;
 }
 
@@ -696,9 +706,14 @@ void ProcessValidator::validateCodePage(const VMAInfo *vma) const {
 		if (!lib) {
 			// occurs when it's library is mapped but is not a dependency
 			// TODO find out why libnss* is always mapped to the process space
-			std::cout << COLOR_RED << "Warning: Found library in process "
-			                          "that was not a dependency "
-			          << vma->name << COLOR_RESET << std::endl;
+			Finding finding{Finding::Kind::UNKNOWN_LIBRARY,
+			                Finding::Severity::WARNING};
+			finding.pid     = this->pid;
+			finding.address = vma->start;
+			finding.module  = vma->name;
+			finding.message = "Warning: Found library in process "
+			                  "that was not a dependency " + vma->name;
+			emit(finding);
 			return;
 		}
 		binary = lib;
@@ -717,22 +732,30 @@ void ProcessValidator::validateCodePage(const VMAInfo *vma) const {
 	while (bytesChecked < textsize) {
 		// read vma from memory
 
-		codevma = vmi->readVectorFromVA(vma->start + bytesChecked,
-		                                vma->end - vma->start - bytesChecked,
-		                                pid);
+		codevma = VMITrace::get().readVectorFromVA(
+			vmi, vma->start + bytesChecked,
+			vma->end - vma->start - bytesChecked, pid);
 		memContent = codevma.data();
+		Metrics::count(Metrics::VMI_READS);
+		Metrics::count(Metrics::VMI_BYTES, codevma.size());
 
 		for (size_t j = 0;
 		     j < std::min(textsize - bytesChecked, codevma.size());
 		     j++) {
 
 			if (memContent[j] != fileContent[bytesChecked + j]) {
-				std::cout << COLOR_RED << COLOR_BOLD
-				          << "MISMATCH in code segment! " << vma->name
-				          << COLOR_RESET
-				          << std::endl;
-
-				displayChange(memContent, fileContent + bytesChecked, j, textsize);
+				std::stringstream detail;
+				displayChange(memContent, fileContent + bytesChecked, j,
+				              textsize, detail);
+
+				Finding finding{Finding::Kind::CODE_CHANGE,
+				                Finding::Severity::ALERT};
+				finding.pid     = this->pid;
+				finding.address = vma->start + bytesChecked + j;
+				finding.module  = vma->name;
+				finding.message = "MISMATCH in code segment! " + vma->name;
+				finding.detail  = detail.str();
+				emit(finding);
 				return;
 			}
 		}
@@ -772,9 +795,11 @@ ProcessValidator::validateDataPage(const VMAInfo *vma) const {
 		}
 	}
 
-	auto content = vmi->readVectorFromVA(vma->start,
-	                                     vma->end - vma->start,
-	                                     this->pid, true);
+	auto content = VMITrace::get().readVectorFromVA(vmi, vma->start,
+	                                                vma->end - vma->start,
+	                                                this->pid, true);
+	Metrics::count(Metrics::VMI_READS);
+	Metrics::count(Metrics::VMI_BYTES, content.size());
 	if (content.size() <= sizeof(uint64_t)) {
 		// This page is currently not mapped
 		return glob_stats;
@@ -820,9 +845,7 @@ ProcessValidator::validateDataPage(const VMAInfo *vma) const {
 
 		if(stats.size() == 0) continue;
 
-		std::cout << mapping.second.printMappingInfo();
-		std::cout << PagePtrInfo::printStat(stats);
-		std::cout << std::endl;
+		emit(mapping.second.getMappingSummary(PagePtrInfo::getStat(stats)));
 
 		size_t unknown = 0;
 		for (auto ptr : stats){
@@ -836,8 +859,8 @@ ProcessValidator::validateDataPage(const VMAInfo *vma) const {
 		}
 
 		if(unknown) {
-			std::cout << "Pointers from " << ((vma->name[0] == '[') ? process->getName() + " " + vma->name :vma->name)
-			          << " to " << mapping.first.name << std::endl;
+			report() << "Pointers from " << ((vma->name[0] == '[') ? process->getName() + " " + vma->name :vma->name)
+			         << " to " << mapping.first.name << std::endl;
 		}
 
 		// TODO mapping.second.printSummary();
@@ -848,7 +871,7 @@ ProcessValidator::validateDataPage(const VMAInfo *vma) const {
 	}
 
 	if(unknown) {
-		std::cout << "Found " << COLOR_RED << COLOR_BOLD
+		report() << "Found " << COLOR_RED << COLOR_BOLD
 		      << std::setfill(' ') << std::setw(5)
 		      << unknown << COLOR_RESET << " unknown ("
 		      << COLOR_GREEN << std::setw(5) << glob_stats.size() << COLOR_RESET << ")"
@@ -864,13 +887,13 @@ ProcessValidator::validateDataPage(const VMAInfo *vma) const {
 			fromLoader = this->process->getExecLoader();
 		}
 
-		std::cout << "Segment summary"
-		          << ";" << this->process->getPID()
-		          << ";" << this->process->getName()
-		          << ";" << vma->name
-		          << ";" << ((fromLoader)? fromLoader->elffile->getSymbolCount() :0);
-		std::cout << PagePtrInfo::printStat(glob_stats);
-		std::cout << std::endl;
+		Summary summary{Summary::Scope::SEGMENT};
+		summary.pid      = this->process->getPID();
+		summary.name     = this->process->getName();
+		summary.from     = vma->name;
+		summary.symbols  = (fromLoader) ? fromLoader->elffile->getSymbolCount() : 0;
+		summary.counters = PagePtrInfo::getStat(glob_stats);
+		emit(summary);
 	}
 
 	return glob_stats;
@@ -882,7 +905,8 @@ std::vector<uint8_t> ProcessValidator::getStackContent(
     size_t readAmount) const {
 	const VMAInfo *stack = process->findVMAByName("[stack]");
 
-	return vmi->readVectorFromVA(stack->end - readAmount, readAmount, this->pid, true);
+	return VMITrace::get().readVectorFromVA(vmi, stack->end - readAmount,
+	                                       readAmount, this->pid, true);
 }
 
 int ProcessValidator::checkEnvironment(const std::map<std::string, std::string> &inputMap) {
@@ -898,12 +922,12 @@ int ProcessValidator::checkEnvironment(const std::map<std::string, std::string>
 			} else {
 				// setting is wrong
 				errors++;
-				std::cout << COLOR_RED
-				          << "Found mismatch in environment variables on entry "
-				          << inputPair.first << ". Expected: '"
-				          << inputPair.second << "', found: '"
-				          << envMap[inputPair.first] << "'." << COLOR_NORM
-				          << std::endl;
+				report() << COLOR_RED
+				         << "Found mismatch in environment variables on entry "
+				         << inputPair.first << ". Expected: '"
+				         << inputPair.second << "', found: '"
+				         << envMap[inputPair.first] << "'." << COLOR_NORM
+				         << std::endl;
 			}
 		}
 	}
@@ -0,0 +1,94 @@
+#include "ptrscanner.h"
+
+#include "simd.h"
+
+namespace kernint {
+
+PointerScanner::PointerScanner(uint64_t mask, Mode mode)
+	:
+	mask{mask},
+	mode{mode},
+	byteMask{mask != 0} {
+
+	for (uint8_t byte = 0; byte < 8; byte++) {
+		uint8_t maskByte = (mask >> (byte * 8)) & 0xff;
+		if (maskByte == 0xff) {
+			this->fullBytes.push_back(byte);
+		} else if (maskByte != 0) {
+			this->byteMask = false;
+		}
+	}
+}
+
+void PointerScanner::scan(const uint8_t *data,
+                          size_t start,
+                          size_t end,
+                          std::vector<uint32_t> *result) const {
+	if (end < start + 8) {
+		return;
+	}
+	if (!this->byteMask) {
+		this->scanScalar(data, start, end, result);
+		return;
+	}
+
+	// Build a bitmap of all 0xff bytes, a candidate starts at offset i
+	// if the bits of all required bytes i + fullBytes[k] are set.
+	size_t words = (end + 63) / 64;
+	static thread_local std::vector<uint64_t> ffBytes;
+	ffBytes.assign(words + 1, 0);
+	findByteMatches(data, end, 0xff, ffBytes.data());
+
+	// Offsets relative to the start of data, aligned ones only
+	const uint64_t alignedMask = 0x0101010101010101ULL;
+
+	for (size_t word = start / 64; word < words; word++) {
+		uint64_t candidates = ~0ULL;
+		for (uint8_t byte : this->fullBytes) {
+			uint64_t shifted = ffBytes[word] >> byte;
+			if (byte > 0) {
+				shifted |= ffBytes[word + 1] << (64 - byte);
+			}
+			candidates &= shifted;
+		}
+		if (this->mode == ALIGNED) {
+			candidates &= alignedMask;
+		}
+
+		while (candidates) {
+			size_t offset = word * 64 + __builtin_ctzll(candidates);
+			candidates &= candidates - 1;
+
+			if (offset < start) {
+				continue;
+			}
+			if (offset + 8 > end) {
+				return;
+			}
+			if (read(data, offset) == ~0ULL) {
+				continue;
+			}
+			result->push_back(offset);
+		}
+	}
+}
+
+void PointerScanner::scanScalar(const uint8_t *data,
+                                size_t start,
+                                size_t end,
+                                std::vector<uint32_t> *result) const {
+	size_t step = (this->mode == ALIGNED) ? 8 : 1;
+	size_t offset = start;
+	if (this->mode == ALIGNED && offset % 8) {
+		offset += 8 - offset % 8;
+	}
+
+	for (; offset + 8 <= end; offset += step) {
+		uint64_t value = read(data, offset);
+		if ((value & this->mask) == this->mask && value != ~0ULL) {
+			result->push_back(offset);
+		}
+	}
+}
+
+} // namespace kernint
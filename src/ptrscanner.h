@@ -0,0 +1,66 @@
+#ifndef KERNINT_PTRSCANNER_H_
+#define KERNINT_PTRSCANNER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace kernint {
+
+/**
+ * Finds 64 bit values in a memory block that look like kernel pointers,
+ * i.e. all bits of the configured mask are set. Values with all bits set
+ * are never reported.
+ *
+ * The scanner only produces candidate offsets, the classification of the
+ * pointers is up to the caller.
+ */
+class PointerScanner {
+public:
+	enum Mode {
+		ALIGNED,    // only 8 byte aligned offsets
+		EVERY_BYTE, // values at every byte offset
+	};
+
+	/** The upper half of a pointer into the kernel image */
+	static const uint64_t kernelImageMask = 0xffffffff00000000;
+	/** The upper 16 bits of any kernel space address */
+	static const uint64_t kernelSpaceMask = 0xffff000000000000;
+
+	PointerScanner(uint64_t mask=kernelImageMask, Mode mode=EVERY_BYTE);
+
+	/**
+	 * Append the offsets of all candidates that are completely
+	 * contained in data[start, end) to result, in ascending order.
+	 */
+	void scan(const uint8_t *data,
+	          size_t start,
+	          size_t end,
+	          std::vector<uint32_t> *result) const;
+
+	/** Read the (unaligned) value at the given offset */
+	static inline uint64_t read(const uint8_t *data, uint32_t offset) {
+		uint64_t value;
+		memcpy(&value, data + offset, sizeof(value));
+		return value;
+	}
+
+private:
+	void scanScalar(const uint8_t *data,
+	                size_t start,
+	                size_t end,
+	                std::vector<uint32_t> *result) const;
+
+	uint64_t mask;
+	Mode mode;
+
+	/** Byte positions within a value that must be 0xff, see scan() */
+	std::vector<uint8_t> fullBytes;
+	/** The mask only consists of full 0xff bytes */
+	bool byteMask;
+};
+
+} // namespace kernint
+
+#endif
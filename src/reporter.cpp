@@ -0,0 +1,204 @@
+#include "reporter.h"
+
+#include <chrono>
+#include <iostream>
+
+namespace kernint {
+
+/** Polling interval of the writer while the queue is empty */
+static const std::chrono::milliseconds pollInterval{10};
+/** Buffered output is written after this many empty polls */
+static const uint32_t idlePolls = 10;
+
+Reporter &Reporter::get() {
+	static Reporter reporter;
+	return reporter;
+}
+
+Reporter::Reporter()
+	:
+	head{&stub},
+	tail{&stub},
+	stub{},
+	out{&std::cout},
+	strip{false},
+	textOutput{true},
+	block{},
+	flushRequests{0},
+	flushesDone{0},
+	stopping{false} {
+
+	this->stub.next.store(nullptr);
+	this->block.reserve(blockSize);
+	this->writer = std::thread(&Reporter::run, this);
+}
+
+Reporter::~Reporter() {
+	{
+		std::lock_guard<std::mutex> lock(this->controlMutex);
+		this->stopping = true;
+	}
+	this->wakeup.notify_one();
+	this->writer.join();
+}
+
+void Reporter::setOutput(std::ostream *out) {
+	this->flush();
+	this->out = out;
+}
+
+void Reporter::setStripColors(bool strip) {
+	this->strip = strip;
+}
+
+void Reporter::setTextOutput(bool enabled) {
+	this->textOutput = enabled;
+}
+
+void Reporter::writeDiagnostic(const std::string &text) {
+	std::cerr << text;
+}
+
+void Reporter::write(std::string &&text) {
+	Node *node = new Node();
+	node->next.store(nullptr, std::memory_order_relaxed);
+	node->text = std::move(text);
+
+	Node *prev = this->head.exchange(node, std::memory_order_acq_rel);
+	prev->next.store(node, std::memory_order_release);
+}
+
+Reporter::Node *Reporter::pop() {
+	Node *tail = this->tail;
+	Node *next = tail->next.load(std::memory_order_acquire);
+
+	if (tail == &this->stub) {
+		if (!next) {
+			return nullptr;
+		}
+		this->tail = next;
+		tail = next;
+		next = next->next.load(std::memory_order_acquire);
+	}
+	if (next) {
+		this->tail = next;
+		return tail;
+	}
+
+	// tail is the last node, unless a producer is just appending
+	if (tail != this->head.load(std::memory_order_acquire)) {
+		return nullptr;
+	}
+	// Put the stub behind it, so that the last node can be taken
+	this->stub.next.store(nullptr, std::memory_order_relaxed);
+	Node *prev = this->head.exchange(&this->stub, std::memory_order_acq_rel);
+	prev->next.store(&this->stub, std::memory_order_release);
+
+	next = tail->next.load(std::memory_order_acquire);
+	if (next) {
+		this->tail = next;
+		return tail;
+	}
+	return nullptr;
+}
+
+void Reporter::drain() {
+	while (true) {
+		Node *node = this->pop();
+		if (node) {
+			this->append(node);
+			continue;
+		}
+		// pop() also fails while a producer is linking in a node
+		if (this->tail == &this->stub &&
+		    this->head.load(std::memory_order_acquire) == &this->stub) {
+			return;
+		}
+		std::this_thread::yield();
+	}
+}
+
+void Reporter::flush() {
+	std::unique_lock<std::mutex> lock(this->controlMutex);
+	uint64_t request = ++this->flushRequests;
+	this->wakeup.notify_one();
+	this->flushed.wait(lock, [&]() {
+		return this->flushesDone >= request;
+	});
+}
+
+void Reporter::append(Node *node) {
+	if (this->strip) {
+		this->block.append(stripColors(node->text));
+	} else {
+		this->block.append(node->text);
+	}
+	delete node;
+}
+
+void Reporter::writeBlock() {
+	if (!this->block.empty()) {
+		this->out.load()->write(this->block.data(), this->block.size());
+		this->block.clear();
+	}
+}
+
+void Reporter::run() {
+	uint32_t idle = 0;
+
+	while (true) {
+		Node *node = this->pop();
+		if (node) {
+			this->append(node);
+			if (this->block.size() >= blockSize) {
+				this->writeBlock();
+			}
+			idle = 0;
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(this->controlMutex);
+		if (this->flushesDone != this->flushRequests || this->stopping) {
+			// Take what producers appended meanwhile before writing
+			lock.unlock();
+			this->drain();
+			lock.lock();
+
+			this->writeBlock();
+			this->out.load()->flush();
+			this->flushesDone = this->flushRequests;
+			this->flushed.notify_all();
+			if (this->stopping) {
+				return;
+			}
+			continue;
+		}
+
+		// Do not keep output back forever while nothing happens
+		if (++idle == idlePolls && !this->block.empty()) {
+			this->writeBlock();
+			this->out.load()->flush();
+		}
+		this->wakeup.wait_for(lock, pollInterval);
+	}
+}
+
+std::string Reporter::stripColors(const std::string &text) {
+	std::string result;
+	result.reserve(text.size());
+
+	for (size_t i = 0; i < text.size(); i++) {
+		// Skip "\033[<parameters>m"
+		if (text[i] == '\033' && i + 1 < text.size() && text[i + 1] == '[') {
+			size_t end = text.find('m', i + 2);
+			if (end != std::string::npos) {
+				i = end;
+				continue;
+			}
+		}
+		result.push_back(text[i]);
+	}
+	return result;
+}
+
+} // namespace kernint
@@ -0,0 +1,155 @@
+#ifndef KERNINT_REPORTER_H_
+#define KERNINT_REPORTER_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <thread>
+
+namespace kernint {
+
+/**
+ * Asynchronous output of findings and progress messages.
+ *
+ * Messages are put into a lock-free queue and written by a background
+ * thread in large blocks, so producers never wait for the terminal or
+ * a pipe. Output only reaches the stream when the block buffer is full,
+ * when the queue has been idle for a while, or on flush().
+ */
+class Reporter {
+public:
+	/** Size of the output block buffer */
+	static const size_t blockSize = 0x10000;
+
+	/** The reporter used by all validators */
+	static Reporter &get();
+
+	~Reporter();
+
+	Reporter(const Reporter &) = delete;
+	Reporter &operator=(const Reporter &) = delete;
+
+	/**
+	 * Write to the given stream from now on. The stream must stay
+	 * valid until the next setOutput() or the end of the program.
+	 */
+	void setOutput(std::ostream *out);
+
+	/** Remove the terminal color sequences, e.g. for files */
+	void setStripColors(bool strip);
+
+	/**
+	 * Whether messages of report() are written to the output.
+	 * Structured output formats only consist of the records written
+	 * directly, the messages go to stderr then.
+	 */
+	void setTextOutput(bool enabled);
+	bool isTextOutput() const { return this->textOutput; }
+
+	/** Queue a message, never blocks */
+	void write(std::string &&text);
+
+	/** Write a message to stderr right away */
+	void writeDiagnostic(const std::string &text);
+
+	/** Wait until all queued messages are written and flushed */
+	void flush();
+
+private:
+	/** Node of the multi-producer single-consumer queue */
+	struct Node {
+		std::atomic<Node *> next;
+		std::string text;
+	};
+
+	Reporter();
+
+	/** Pop the oldest message, nullptr if the queue is empty */
+	Node *pop();
+	/** Append all complete messages to the block buffer */
+	void drain();
+	void run();
+	/** Add a message to the block buffer and free it */
+	void append(Node *node);
+	void writeBlock();
+
+	static std::string stripColors(const std::string &text);
+
+	// Producers swap themselves in at the head, the writer
+	// takes from the tail. stub is the initial dummy node.
+	std::atomic<Node *> head;
+	Node *tail;
+	Node stub;
+
+	std::atomic<std::ostream *> out;
+	std::atomic<bool> strip;
+	std::atomic<bool> textOutput;
+	std::string block;
+
+	// Only used to wake up the writer and to wait for flushes,
+	// never taken by write().
+	std::mutex controlMutex;
+	std::condition_variable wakeup;
+	std::condition_variable flushed;
+	uint64_t flushRequests;
+	uint64_t flushesDone;
+	bool stopping;
+
+	std::thread writer;
+};
+
+/**
+ * Collects one message and queues it when destroyed, use like std::cout:
+ *
+ *     report() << "Found something" << std::endl;
+ *
+ * std::endl only ends the line, it does not flush anything.
+ */
+class ReportStream {
+public:
+	ReportStream(Reporter &reporter) : reporter(&reporter) {}
+	ReportStream(ReportStream &&other)
+		:
+		reporter{other.reporter},
+		stream{std::move(other.stream)} {
+		other.reporter = nullptr;
+	}
+	~ReportStream() {
+		if (!this->reporter || this->stream.tellp() <= 0) {
+			return;
+		}
+		if (this->reporter->isTextOutput()) {
+			this->reporter->write(this->stream.str());
+		} else {
+			this->reporter->writeDiagnostic(this->stream.str());
+		}
+	}
+
+	template <typename T>
+	ReportStream &operator<<(const T &value) {
+		this->stream << value;
+		return *this;
+	}
+
+	ReportStream &operator<<(std::ostream &(*manip)(std::ostream &)) {
+		manip(this->stream);
+		return *this;
+	}
+
+private:
+	Reporter *reporter;
+	std::ostringstream stream;
+};
+
+/** Start a message for the global reporter */
+inline ReportStream report() {
+	return ReportStream{Reporter::get()};
+}
+
+} // namespace kernint
+
+#endif
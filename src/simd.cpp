@@ -0,0 +1,169 @@
+#include "simd.h"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace kernint {
+namespace simd {
+
+size_t findFirstDifferenceScalar(const uint8_t *a, const uint8_t *b,
+                                 size_t start, size_t len) {
+	for (size_t i = start; i < len; i++) {
+		if (a[i] != b[i]) {
+			return i;
+		}
+	}
+	return len;
+}
+
+void findByteMatchesScalar(const uint8_t *data, size_t len,
+                          uint8_t value, uint64_t *bitmap) {
+	for (size_t word = 0; word * 64 < len; word++) {
+		uint64_t bits = 0;
+		for (size_t i = word * 64; i < len && i < word * 64 + 64; i++) {
+			bits |= (uint64_t)(data[i] == value) << (i % 64);
+		}
+		bitmap[word] = bits;
+	}
+}
+
+#if defined(__x86_64__)
+
+size_t findFirstDifferenceSSE2(const uint8_t *a, const uint8_t *b,
+                               size_t start, size_t len) {
+	size_t i = start;
+
+	// 32 bytes per step, the movemask is inverted to get set bits for
+	// differing bytes.
+	for (; i + 32 <= len; i += 32) {
+		__m128i a0 = _mm_loadu_si128((const __m128i *)(a + i));
+		__m128i b0 = _mm_loadu_si128((const __m128i *)(b + i));
+		__m128i a1 = _mm_loadu_si128((const __m128i *)(a + i + 16));
+		__m128i b1 = _mm_loadu_si128((const __m128i *)(b + i + 16));
+
+		uint32_t mask0 = _mm_movemask_epi8(_mm_cmpeq_epi8(a0, b0));
+		uint32_t mask1 = _mm_movemask_epi8(_mm_cmpeq_epi8(a1, b1));
+		uint32_t diff  = ~(mask0 | (mask1 << 16));
+		if (diff) {
+			return i + __builtin_ctz(diff);
+		}
+	}
+	return findFirstDifferenceScalar(a, b, i, len);
+}
+
+__attribute__((target("avx2")))
+size_t findFirstDifferenceAVX2(const uint8_t *a, const uint8_t *b,
+                               size_t start, size_t len) {
+	size_t i = start;
+
+	// 64 bytes per step
+	for (; i + 64 <= len; i += 64) {
+		__m256i a0 = _mm256_loadu_si256((const __m256i *)(a + i));
+		__m256i b0 = _mm256_loadu_si256((const __m256i *)(b + i));
+		__m256i a1 = _mm256_loadu_si256((const __m256i *)(a + i + 32));
+		__m256i b1 = _mm256_loadu_si256((const __m256i *)(b + i + 32));
+
+		uint64_t mask0 = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(a0, b0));
+		uint64_t mask1 = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(a1, b1));
+		uint64_t diff  = ~(mask0 | (mask1 << 32));
+		if (diff) {
+			return i + __builtin_ctzll(diff);
+		}
+	}
+	return findFirstDifferenceSSE2(a, b, i, len);
+}
+
+void findByteMatchesSSE2(const uint8_t *data, size_t len,
+                         uint8_t value, uint64_t *bitmap) {
+	const __m128i needle = _mm_set1_epi8((char)value);
+	size_t word = 0;
+
+	for (; word * 64 + 64 <= len; word++) {
+		const uint8_t *block = data + word * 64;
+		uint64_t bits = 0;
+		for (int part = 0; part < 4; part++) {
+			__m128i chunk = _mm_loadu_si128((const __m128i *)(block + part * 16));
+			uint64_t mask = (uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle));
+			bits |= mask << (part * 16);
+		}
+		bitmap[word] = bits;
+	}
+	if (word * 64 < len) {
+		findByteMatchesScalar(data + word * 64, len - word * 64,
+		                      value, bitmap + word);
+	}
+}
+
+__attribute__((target("avx2")))
+void findByteMatchesAVX2(const uint8_t *data, size_t len,
+                         uint8_t value, uint64_t *bitmap) {
+	const __m256i needle = _mm256_set1_epi8((char)value);
+	size_t word = 0;
+
+	for (; word * 64 + 64 <= len; word++) {
+		const uint8_t *block = data + word * 64;
+		__m256i lo = _mm256_loadu_si256((const __m256i *)block);
+		__m256i hi = _mm256_loadu_si256((const __m256i *)(block + 32));
+		uint64_t maskLo = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, needle));
+		uint64_t maskHi = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, needle));
+		bitmap[word] = maskLo | (maskHi << 32);
+	}
+	if (word * 64 < len) {
+		findByteMatchesScalar(data + word * 64, len - word * 64,
+		                      value, bitmap + word);
+	}
+}
+
+#endif
+
+typedef size_t (*diff_func_t)(const uint8_t *, const uint8_t *,
+                              size_t, size_t);
+typedef void (*match_func_t)(const uint8_t *, size_t, uint8_t, uint64_t *);
+
+struct Implementation {
+	diff_func_t diff;
+	match_func_t match;
+	const char *name;
+};
+
+static const Implementation &selectImplementation() {
+	static const Implementation impl = []() -> Implementation {
+#if defined(__x86_64__)
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx2")) {
+			return {findFirstDifferenceAVX2, findByteMatchesAVX2, "avx2"};
+		}
+		// SSE2 is part of the x86_64 baseline
+		return {findFirstDifferenceSSE2, findByteMatchesSSE2, "sse2"};
+#else
+		return {findFirstDifferenceScalar, findByteMatchesScalar, "scalar"};
+#endif
+	}();
+	return impl;
+}
+
+const char *diffImplementation() {
+	return selectImplementation().name;
+}
+
+} // namespace simd
+
+size_t findFirstDifference(const uint8_t *a,
+                           const uint8_t *b,
+                           size_t start,
+                           size_t len) {
+	if (start >= len) {
+		return len;
+	}
+	return simd::selectImplementation().diff(a, b, start, len);
+}
+
+void findByteMatches(const uint8_t *data,
+                     size_t len,
+                     uint8_t value,
+                     uint64_t *bitmap) {
+	simd::selectImplementation().match(data, len, value, bitmap);
+}
+
+} // namespace kernint
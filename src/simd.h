@@ -0,0 +1,53 @@
+#ifndef KERNINT_SIMD_H_
+#define KERNINT_SIMD_H_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace kernint {
+
+/**
+ * Find the first offset in [start, len) where the two buffers differ.
+ * Returns len if the remaining bytes are identical.
+ *
+ * The implementation is selected once at runtime, depending on the
+ * vector extensions of the CPU.
+ */
+size_t findFirstDifference(const uint8_t *a,
+                           const uint8_t *b,
+                           size_t start,
+                           size_t len);
+
+/**
+ * Set bit i of bitmap for every byte data[i] that equals value.
+ * bitmap must hold (len + 63) / 64 words, the trailing bits are cleared.
+ */
+void findByteMatches(const uint8_t *data,
+                     size_t len,
+                     uint8_t value,
+                     uint64_t *bitmap);
+
+namespace simd {
+
+/** Name of the implementation used by findFirstDifference() */
+const char *diffImplementation();
+
+size_t findFirstDifferenceScalar(const uint8_t *a, const uint8_t *b,
+                                 size_t start, size_t len);
+void findByteMatchesScalar(const uint8_t *data, size_t len,
+                          uint8_t value, uint64_t *bitmap);
+#if defined(__x86_64__)
+size_t findFirstDifferenceSSE2(const uint8_t *a, const uint8_t *b,
+                               size_t start, size_t len);
+size_t findFirstDifferenceAVX2(const uint8_t *a, const uint8_t *b,
+                               size_t start, size_t len);
+void findByteMatchesSSE2(const uint8_t *data, size_t len,
+                         uint8_t value, uint64_t *bitmap);
+void findByteMatchesAVX2(const uint8_t *data, size_t len,
+                         uint8_t value, uint64_t *bitmap);
+#endif
+
+} // namespace simd
+} // namespace kernint
+
+#endif
@@ -5,6 +5,7 @@
 #include "elfuserspaceloader.h"
 #include "kernel.h"
 #include "error.h"
+#include "vmitrace.h"
 
 
 namespace kernint {
@@ -123,7 +124,7 @@ std::vector<VMAInfo> TaskManager::getVMAInfo(pid_t pid) {
 	Instance context = mm.memberByName("context", true);
 	uint64_t vdsoPtr = context.memberByName("vdso").getAddress();
 	// Required to dereference void pointer
-	uint64_t vdsoPage = this->kernel->vmi->read64FromVA(vdsoPtr);
+	uint64_t vdsoPage = VMITrace::get().read64FromVA(this->kernel->vmi, vdsoPtr);
 
 	// Not available in kernel 3.16
 	// uint64_t vvar_start = context.memberByName("vdso_image", true).memberByName("sym_vvar_start").getAddress();
@@ -306,7 +307,7 @@ std::vector<std::string> TaskManager::getArgForTask(pid_t pid) const {
 
 	uint64_t i = start;
 	while (i < end) {
-		std::string str = this->kernel->vmi->readStrFromVA(i, pid);
+		std::string str = VMITrace::get().readStrFromVA(this->kernel->vmi, i, pid);
 		arguments.push_back(str);
 		i += str.size() + 1;
 	}
@@ -323,7 +324,7 @@ std::unordered_map<std::string, std::string> TaskManager::getEnvForTask(pid_t pi
 
 	uint64_t i = start;
 	while (i < end) {
-		std::string str = this->kernel->vmi->readStrFromVA(i, pid);
+		std::string str = VMITrace::get().readStrFromVA(this->kernel->vmi, i, pid);
 		size_t off = str.find("=");
 		environment[str.substr(0, off)] = str.substr(off + 1);
 		i += str.size() + 1;
@@ -497,7 +498,8 @@ ElfUserspaceLoader *TaskManager::loadVDSO(Process *process) {
 
 	auto vdsoImage = vdsoVar->getInstance();
 
-	this->vdsoData = this->kernel->vmi->readVectorFromVA(
+	this->vdsoData = VMITrace::get().readVectorFromVA(
+		this->kernel->vmi,
 		vdsoImage.memberByName("data").getRawValue<uint64_t>(false),
 		vdsoImage.memberByName("size").getValue<uint64_t>());
 
@@ -0,0 +1,390 @@
+#include "vmitrace.h"
+
+#include <algorithm>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <iterator>
+#include <type_traits>
+
+#include "exceptions.h"
+#include "helpers.h"
+
+namespace kernint {
+
+static_assert(std::is_integral<PageMap::key_type>::value,
+              "page map keys are stored as integers");
+
+template <typename T>
+static void appendValue(T value, std::string *out) {
+	out->append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+template <typename T>
+static bool readValue(const uint8_t *&pos, const uint8_t *end, T *value) {
+	if ((size_t)(end - pos) < sizeof(T)) {
+		return false;
+	}
+	memcpy(value, pos, sizeof(T));
+	pos += sizeof(T);
+	return true;
+}
+
+VMITrace &VMITrace::get() {
+	static VMITrace instance;
+	return instance;
+}
+
+VMITrace::VMITrace() {}
+
+VMITrace::~VMITrace() {
+	if (this->out) {
+		fclose(this->out);
+	}
+	if (this->direct) {
+		vmi_destroy(this->direct);
+	}
+	for (auto &page : this->executable) {
+		delete page.first;
+	}
+}
+
+bool VMITrace::record(const std::string &fileName) {
+	std::lock_guard<std::mutex> lock(this->mutex);
+	this->out = fopen(fileName.c_str(), "wb");
+	if (!this->out) {
+		return false;
+	}
+	std::string header{"KIVMITRC"};
+	appendValue<uint32_t>(version, &header);
+	fwrite(header.data(), 1, header.size(), this->out);
+	this->mode = Mode::RECORD;
+	return true;
+}
+
+bool VMITrace::replay(const std::string &fileName) {
+	std::lock_guard<std::mutex> lock(this->mutex);
+	std::ifstream in(fileName, std::ios::binary);
+	if (!in.is_open()) {
+		return false;
+	}
+	std::vector<uint8_t> content{std::istreambuf_iterator<char>(in),
+	                             std::istreambuf_iterator<char>()};
+
+	const uint8_t *pos = content.data();
+	const uint8_t *end = pos + content.size();
+	uint32_t fileVersion;
+	if (content.size() < 8 || memcmp(pos, "KIVMITRC", 8) != 0) {
+		return false;
+	}
+	pos += 8;
+	if (!readValue(pos, end, &fileVersion) || fileVersion != version) {
+		return false;
+	}
+
+	// A record cut off at the end is dropped, e.g. after a crash
+	uint32_t length;
+	uint8_t type;
+	while (readValue(pos, end, &length) && (size_t)(end - pos) >= length &&
+	       length >= 1) {
+		const uint8_t *recordEnd = pos + length;
+		readValue(pos, recordEnd, &type);
+		if (type == BLOB) {
+			uint32_t id;
+			if (!readValue(pos, recordEnd, &id) || id != this->blobs.size()) {
+				return false;
+			}
+			this->blobs.emplace_back(pos, recordEnd);
+		} else if (type == READ) {
+			Key key;
+			uint8_t ok;
+			uint32_t blob;
+			if (!readValue(pos, recordEnd, &key.op) ||
+			    !readValue(pos, recordEnd, &ok) ||
+			    !readValue(pos, recordEnd, &key.pid) ||
+			    !readValue(pos, recordEnd, &key.address) ||
+			    !readValue(pos, recordEnd, &key.length) ||
+			    !readValue(pos, recordEnd, &blob) ||
+			    (ok && blob >= this->blobs.size())) {
+				return false;
+			}
+			this->results[key].blobs.push_back(ok ? blob : UINT32_MAX);
+		}
+		// Unknown records are skipped
+		pos = recordEnd;
+	}
+
+	this->mode = Mode::REPLAY;
+	return true;
+}
+
+void VMITrace::flush() {
+	std::lock_guard<std::mutex> lock(this->mutex);
+	if (this->out) {
+		fflush(this->out);
+	}
+}
+
+bool VMITrace::openDirect(const std::string &name, uint32_t flags) {
+	std::lock_guard<std::mutex> lock(this->mutex);
+	if (this->direct) {
+		return true;
+	}
+	if (vmi_init(&this->direct, flags,
+	             const_cast<char *>(name.c_str())) != VMI_SUCCESS) {
+		this->direct = nullptr;
+		return false;
+	}
+	return true;
+}
+
+void VMITrace::writeRecord(RecordType type, const std::string &payload) {
+	uint32_t length = payload.size() + 1;
+	fwrite(&length, sizeof(length), 1, this->out);
+	fwrite(&type, sizeof(type), 1, this->out);
+	fwrite(payload.data(), 1, payload.size(), this->out);
+}
+
+uint32_t VMITrace::addBlob(const std::vector<uint8_t> &content) {
+	uint64_t hash = hashPage(content.data(), content.size());
+	auto &candidates = this->blobsByHash[hash];
+	for (uint32_t id : candidates) {
+		if (this->blobs[id] == content) {
+			return id;
+		}
+	}
+
+	uint32_t id = this->blobs.size();
+	this->blobs.push_back(content);
+	candidates.push_back(id);
+
+	std::string payload;
+	appendValue<uint32_t>(id, &payload);
+	payload.append(content.begin(), content.end());
+	this->writeRecord(BLOB, payload);
+	return id;
+}
+
+const std::vector<uint8_t> *VMITrace::replayed(const Key &key) {
+	auto it = this->results.find(key);
+	if (it == this->results.end()) {
+		return nullptr;
+	}
+	// Repeated reads get the recorded results in turn, the last
+	// one is kept once they are used up
+	Results &entry = it->second;
+	uint32_t blob = entry.blobs[std::min(entry.next, entry.blobs.size() - 1)];
+	entry.next++;
+	if (blob == UINT32_MAX) {
+		return nullptr;
+	}
+	return &this->blobs[blob];
+}
+
+template <typename F>
+bool VMITrace::traced(const Key &key, F &&read, std::vector<uint8_t> *result) {
+	if (this->mode == Mode::REPLAY) {
+		std::lock_guard<std::mutex> lock(this->mutex);
+		const std::vector<uint8_t> *content = this->replayed(key);
+		if (!content) {
+			return false;
+		}
+		*result = *content;
+		return true;
+	}
+
+	bool ok = true;
+	std::exception_ptr error;
+	try {
+		*result = read();
+	} catch (...) {
+		if (this->mode != Mode::RECORD) {
+			throw;
+		}
+		ok    = false;
+		error = std::current_exception();
+	}
+
+	if (this->mode == Mode::RECORD) {
+		std::lock_guard<std::mutex> lock(this->mutex);
+		uint32_t blob = ok ? this->addBlob(*result) : UINT32_MAX;
+		std::string payload;
+		appendValue<uint8_t>((uint8_t)key.op, &payload);
+		appendValue<uint8_t>(ok, &payload);
+		appendValue<uint32_t>(key.pid, &payload);
+		appendValue<uint64_t>(key.address, &payload);
+		appendValue<uint64_t>(key.length, &payload);
+		appendValue<uint32_t>(blob, &payload);
+		this->writeRecord(READ, payload);
+	}
+	if (error) {
+		std::rethrow_exception(error);
+	}
+	return ok;
+}
+
+std::vector<uint8_t> VMITrace::readVectorFromVA(VMIInstance *vmi,
+                                                uint64_t address,
+                                                uint64_t len, uint32_t pid,
+                                                bool noException) {
+	std::vector<uint8_t> result;
+	bool ok = this->traced(Key{Op::READ_VA, pid, address, len}, [&]() {
+		return vmi->readVectorFromVA(address, len, pid, noException);
+	}, &result);
+	if (!ok && !noException) {
+		throw VMIException{"Could not read from guest virtual address"};
+	}
+	return result;
+}
+
+size_t VMITrace::readVA(VMIInstance *vmi, uint64_t address, uint64_t len,
+                        uint8_t *buffer, uint32_t pid) {
+	if (this->mode == Mode::OFF && this->direct) {
+		return vmi_read_va(this->direct, address, pid, buffer, len);
+	}
+
+	Key key{Op::READ_VA, pid, address, len};
+	if (this->mode == Mode::REPLAY) {
+		std::lock_guard<std::mutex> lock(this->mutex);
+		const std::vector<uint8_t> *content = this->replayed(key);
+		if (!content) {
+			return 0;
+		}
+		size_t size = std::min<size_t>(content->size(), len);
+		memcpy(buffer, content->data(), size);
+		return size;
+	}
+
+	std::vector<uint8_t> content;
+	if (!this->traced(key, [&]() {
+		return vmi->readVectorFromVA(address, len, pid, true);
+	}, &content)) {
+		return 0;
+	}
+	size_t size = std::min<size_t>(content.size(), len);
+	memcpy(buffer, content.data(), size);
+	return size;
+}
+
+std::vector<uint8_t> VMITrace::readVectorFromPA(VMIInstance *vmi,
+                                                uint64_t address,
+                                                uint64_t len) {
+	std::vector<uint8_t> result;
+	if (!this->traced(Key{Op::READ_PA, 0, address, len}, [&]() {
+		return vmi->readVectorFromPA(address, len);
+	}, &result)) {
+		throw VMIException{"Could not read from guest physical address"};
+	}
+	return result;
+}
+
+uint64_t VMITrace::read64FromVA(VMIInstance *vmi, uint64_t address) {
+	std::vector<uint8_t> result;
+	if (!this->traced(Key{Op::READ_64, 0, address, 8}, [&]() {
+		uint64_t value = vmi->read64FromVA(address);
+		return std::vector<uint8_t>((uint8_t *)&value,
+		                            (uint8_t *)&value + sizeof(value));
+	}, &result) || result.size() != sizeof(uint64_t)) {
+		throw VMIException{"Could not read from guest virtual address"};
+	}
+	uint64_t value;
+	memcpy(&value, result.data(), sizeof(value));
+	return value;
+}
+
+std::string VMITrace::readStrFromVA(VMIInstance *vmi, uint64_t address,
+                                    uint32_t pid) {
+	std::vector<uint8_t> result;
+	if (!this->traced(Key{Op::READ_STR, pid, address, 0}, [&]() {
+		std::string value = vmi->readStrFromVA(address, pid);
+		return std::vector<uint8_t>(value.begin(), value.end());
+	}, &result)) {
+		throw VMIException{"Could not read string from guest"};
+	}
+	return std::string(result.begin(), result.end());
+}
+
+uint64_t VMITrace::translateV2P(VMIInstance *vmi, uint64_t address,
+                                uint32_t pid) {
+	std::vector<uint8_t> result;
+	if (!this->traced(Key{Op::TRANSLATE, pid, address, 0}, [&]() {
+		uint64_t value = vmi->translateV2P(address, pid);
+		return std::vector<uint8_t>((uint8_t *)&value,
+		                            (uint8_t *)&value + sizeof(value));
+	}, &result) || result.size() != sizeof(uint64_t)) {
+		throw VMIException{"Could not translate guest address"};
+	}
+	uint64_t value;
+	memcpy(&value, result.data(), sizeof(value));
+	return value;
+}
+
+PageMap VMITrace::getPages(VMIInstance *vmi, uint32_t pid) {
+	if (this->mode == Mode::OFF) {
+		if (this->direct) {
+			// A new iteration, the guest may have changed its mappings
+			vmi_v2pcache_flush(this->direct);
+		}
+		return vmi->getPages(pid);
+	}
+
+	PageMap map;
+	std::vector<uint8_t> result;
+	const size_t entrySize = sizeof(uint64_t) + 1 + sizeof(page_info_t);
+	if (!this->traced(Key{Op::GET_PAGES, pid, 0, 0}, [&]() {
+		map = vmi->getPages(pid);
+		std::vector<uint8_t> pages;
+		pages.reserve(map.size() * entrySize);
+		for (auto &page : map) {
+			uint64_t key = page.first;
+			uint8_t exec = vmi->isPageExecutable(page.second);
+			pages.insert(pages.end(), (uint8_t *)&key,
+			             (uint8_t *)&key + sizeof(key));
+			pages.push_back(exec);
+			pages.insert(pages.end(), (uint8_t *)page.second,
+			             (uint8_t *)page.second + sizeof(page_info_t));
+		}
+		return pages;
+	}, &result)) {
+		throw VMIException{"Could not get the page map of the guest"};
+	}
+
+	if (this->mode == Mode::RECORD) {
+		return map;
+	}
+
+	std::lock_guard<std::mutex> lock(this->mutex);
+	for (size_t pos = 0; pos + entrySize <= result.size(); pos += entrySize) {
+		uint64_t key;
+		memcpy(&key, &result[pos], sizeof(key));
+		page_info_t *page = new page_info_t;
+		memcpy(page, &result[pos + sizeof(key) + 1], sizeof(page_info_t));
+		this->executable[page] = result[pos + sizeof(key)];
+		map[(PageMap::key_type)key] = page;
+	}
+	return map;
+}
+
+bool VMITrace::isPageExecutable(VMIInstance *vmi, page_info_t *page) {
+	if (this->mode != Mode::REPLAY) {
+		return vmi->isPageExecutable(page);
+	}
+	std::lock_guard<std::mutex> lock(this->mutex);
+	auto it = this->executable.find(page);
+	return it != this->executable.end() && it->second;
+}
+
+void VMITrace::destroyMap(VMIInstance *vmi, PageMap &map) {
+	if (this->mode != Mode::REPLAY) {
+		vmi->destroyMap(map);
+		return;
+	}
+	std::lock_guard<std::mutex> lock(this->mutex);
+	for (auto &page : map) {
+		this->executable.erase(page.second);
+		delete page.second;
+	}
+	map.clear();
+}
+
+} // namespace kernint
@@ -0,0 +1,177 @@
+#ifndef KERNINT_VMITRACE_H_
+#define KERNINT_VMITRACE_H_
+
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <libvmi/libvmi.h>
+
+#include "libvmiwrapper/libvmiwrapper.h"
+
+namespace kernint {
+
+/**
+ * Records the guest reads of kernint and serves them again later.
+ *
+ * All reads kernint does itself go through this class: page maps,
+ * page contents, process code and stacks, strings and translations.
+ * When recording, every read is appended to a trace file. When
+ * replaying, the reads are answered from the trace in the order they
+ * were recorded, so a validation run sees exactly the same memory.
+ *
+ * The walks of kernel structures done by libdwarfparser (task list,
+ * VMAs, modules) are not part of the trace, they still need a guest.
+ * A static one like a kernint-fixture image keeps them reproducible.
+ *
+ * The trace starts with the magic "KIVMITRC" and a uint32_t version.
+ * It is followed by length prefixed records like the findings of
+ * BinaryWriter, a uint32_t length and a uint8_t type:
+ *
+ *     blob: id:u32 bytes
+ *     read: op:u8 ok:u8 pid:u32 address:u64 length:u64 blob:u32
+ *
+ * Equal contents are only stored once as blob. Page maps are stored
+ * as blob of count * (key:u64 executable:u8 page_info_t).
+ */
+class VMITrace {
+public:
+	static const uint32_t version = 1;
+
+	enum class Mode {
+		OFF,
+		RECORD,
+		REPLAY,
+	};
+
+	/** The trace used for all reads */
+	static VMITrace &get();
+
+	~VMITrace();
+
+	VMITrace(const VMITrace &) = delete;
+	VMITrace &operator=(const VMITrace &) = delete;
+
+	/** Append all following reads to fileName */
+	bool record(const std::string &fileName);
+	/** Answer all following reads from fileName */
+	bool replay(const std::string &fileName);
+	Mode getMode() const { return this->mode; }
+
+	/** Write the recorded reads, e.g. after each iteration */
+	void flush();
+
+	/**
+	 * Open a second libvmi handle on the guest for readVA(), as
+	 * libvmiwrapper only returns newly allocated vectors.
+	 * Returns false if libvmi refuses, readVA() copies then.
+	 */
+	bool openDirect(const std::string &name, uint32_t flags);
+
+	/**
+	 * Read up to len bytes at address into buffer, returns the number
+	 * of bytes read. Does not allocate, except when recording or
+	 * without a direct handle. Callers serialize the reads.
+	 */
+	size_t readVA(VMIInstance *vmi, uint64_t address, uint64_t len,
+	              uint8_t *buffer, uint32_t pid=0);
+
+	std::vector<uint8_t> readVectorFromVA(VMIInstance *vmi, uint64_t address,
+	                                      uint64_t len, uint32_t pid=0,
+	                                      bool noException=false);
+	std::vector<uint8_t> readVectorFromPA(VMIInstance *vmi, uint64_t address,
+	                                      uint64_t len);
+	uint64_t read64FromVA(VMIInstance *vmi, uint64_t address);
+	std::string readStrFromVA(VMIInstance *vmi, uint64_t address,
+	                          uint32_t pid=0);
+	uint64_t translateV2P(VMIInstance *vmi, uint64_t address, uint32_t pid);
+
+	PageMap getPages(VMIInstance *vmi, uint32_t pid);
+	bool isPageExecutable(VMIInstance *vmi, page_info_t *page);
+	void destroyMap(VMIInstance *vmi, PageMap &map);
+
+private:
+	enum class Op : uint8_t {
+		READ_VA,
+		READ_PA,
+		READ_64,
+		READ_STR,
+		TRANSLATE,
+		GET_PAGES,
+	};
+
+	enum RecordType : uint8_t {
+		BLOB = 1,
+		READ = 2,
+	};
+
+	struct Key {
+		Op op;
+		uint32_t pid;
+		uint64_t address;
+		uint64_t length;
+
+		bool operator==(const Key &other) const {
+			return this->op == other.op && this->pid == other.pid &&
+			       this->address == other.address &&
+			       this->length == other.length;
+		}
+	};
+
+	struct KeyHash {
+		size_t operator()(const Key &key) const {
+			return key.address * 31 + key.length * 17 + key.pid +
+			       (uint64_t)key.op;
+		}
+	};
+
+	/** Results of one read in the order they were recorded */
+	struct Results {
+		/** Blob id, UINT32_MAX if the read failed */
+		std::vector<uint32_t> blobs;
+		size_t next = 0;
+	};
+
+	VMITrace();
+
+	/**
+	 * Next recorded result of a read when replaying, nullptr if the
+	 * read failed or is not part of the trace. Requires the mutex.
+	 */
+	const std::vector<uint8_t> *replayed(const Key &key);
+
+	/**
+	 * Run read, depending on the mode with recording or replaced by
+	 * the recorded result. Returns false if the read failed.
+	 */
+	template <typename F>
+	bool traced(const Key &key, F &&read, std::vector<uint8_t> *result);
+
+	uint32_t addBlob(const std::vector<uint8_t> &content);
+	void writeRecord(RecordType type, const std::string &payload);
+
+	Mode mode = Mode::OFF;
+	std::mutex mutex;
+
+	/** See openDirect() */
+	vmi_instance_t direct = nullptr;
+
+	// Recording
+	FILE *out = nullptr;
+	std::unordered_map<uint64_t, std::vector<uint32_t>> blobsByHash;
+
+	// Both, the blob contents by id
+	std::vector<std::vector<uint8_t>> blobs;
+
+	// Replaying
+	std::unordered_map<Key, Results, KeyHash> results;
+	/** Executable flags of the pages handed out by getPages */
+	std::unordered_map<const page_info_t *, bool> executable;
+};
+
+} // namespace kernint
+
+#endif
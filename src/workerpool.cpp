@@ -0,0 +1,91 @@
+#include "workerpool.h"
+
+#include <algorithm>
+
+namespace kernint {
+
+WorkerPool::WorkerPool()
+	:
+	job{nullptr},
+	active{0},
+	pending{0},
+	generation{0},
+	stopping{false} {}
+
+WorkerPool::~WorkerPool() {
+	this->stop();
+}
+
+void WorkerPool::stop() {
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->stopping = true;
+	}
+	this->wakeup.notify_all();
+	for (auto &&thread : this->threads) {
+		thread.join();
+	}
+	this->threads.clear();
+	this->stopping = false;
+}
+
+void WorkerPool::resize(uint32_t count) {
+	count = std::max(count, 1U);
+	if (count == this->size()) {
+		return;
+	}
+	this->stop();
+	for (uint32_t id = 1; id < count; id++) {
+		this->threads.emplace_back(&WorkerPool::work, this, id,
+		                           this->generation);
+	}
+}
+
+void WorkerPool::run(const Job &job, uint32_t count) {
+	count = std::min(std::max(count, 1U), this->size());
+	if (count > 1) {
+		{
+			std::lock_guard<std::mutex> lock(this->mutex);
+			this->job     = &job;
+			this->active  = count;
+			this->pending = count - 1;
+			this->generation++;
+		}
+		this->wakeup.notify_all();
+	}
+
+	job(0);
+
+	if (count > 1) {
+		std::unique_lock<std::mutex> lock(this->mutex);
+		this->done.wait(lock, [this]() { return this->pending == 0; });
+		this->job = nullptr;
+	}
+}
+
+void WorkerPool::work(uint32_t id, uint64_t seen) {
+	std::unique_lock<std::mutex> lock(this->mutex);
+	while (true) {
+		this->wakeup.wait(lock, [&]() {
+			return this->stopping || this->generation != seen;
+		});
+		if (this->stopping) {
+			return;
+		}
+		seen = this->generation;
+		if (id >= this->active) {
+			continue;
+		}
+
+		const Job *job = this->job;
+		lock.unlock();
+		(*job)(id);
+		lock.lock();
+
+		if (--this->pending == 0) {
+			this->done.notify_one();
+		}
+	}
+}
+
+} // namespace kernint
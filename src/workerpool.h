@@ -0,0 +1,62 @@
+#ifndef KERNINT_WORKERPOOL_H_
+#define KERNINT_WORKERPOOL_H_
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace kernint {
+
+/**
+ * Threads that are kept across jobs, so running a job neither creates
+ * threads nor rebuilds their thread local state.
+ *
+ * The thread calling run() is worker 0, a pool of size n owns n - 1
+ * threads. Only one job runs at a time.
+ */
+class WorkerPool {
+public:
+	typedef std::function<void(uint32_t)> Job;
+
+	WorkerPool();
+	~WorkerPool();
+
+	WorkerPool(const WorkerPool &) = delete;
+	WorkerPool &operator=(const WorkerPool &) = delete;
+
+	/** Use count workers, including the calling thread */
+	void resize(uint32_t count);
+	uint32_t size() const { return this->threads.size() + 1; }
+
+	/**
+	 * Call job(id) for the ids 0 to count - 1, at most size(), and
+	 * wait until all calls returned.
+	 */
+	void run(const Job &job, uint32_t count);
+
+private:
+	/** Runs the jobs started after generation seen */
+	void work(uint32_t id, uint64_t seen);
+	void stop();
+
+	std::mutex mutex;
+	std::condition_variable wakeup;
+	std::condition_variable done;
+	std::vector<std::thread> threads;
+
+	const Job *job;
+	/** Workers taking part in the current job */
+	uint32_t active;
+	/** Threads that did not finish the current job yet */
+	uint32_t pending;
+	/** Incremented for every job */
+	uint64_t generation;
+	bool stopping;
+};
+
+} // namespace kernint
+
+#endif